@@ -0,0 +1,76 @@
+#include "utils/cmdline.hpp"
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "app/info.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+const auto info = ascpp::app_info{"mrbeardad", "ascpp", "awesome cpp framework", 0, 0, 1};
+
+// Build a cmdline with n options of mixed types and the arguments that set all of them
+auto make_cmdline(size_t n, std::vector<std::string>& args) -> ascpp::cmdline {
+  auto cmd = ascpp::cmdline(&info);
+  cmd.allow_nonoptions("files", false);
+  args = {"ascpp"};
+  for (auto i = 0UZ; i < n; ++i) {
+    auto name = std::format("option-{}", i);
+    switch (i % 4) {
+      case 0:
+        cmd.add_option<bool>(name, "bool option");
+        args.emplace_back("--" + name);
+        break;
+      case 1:
+        cmd.add_option<int>(name, "int option").with_default(0);
+        args.emplace_back(std::format("--{}={}", name, i));
+        break;
+      case 2:
+        cmd.add_option<std::string>(name, "string option").with_default("");
+        args.emplace_back("--" + name);
+        args.emplace_back("value");
+        break;
+      default:
+        cmd.add_option<std::vector<double>>(name, "list of double option").with_default({});
+        args.emplace_back(std::format("--{}=1.5,2.5,{}", name, i));
+        break;
+    }
+  }
+  args.emplace_back("--");
+  args.emplace_back("file.txt");
+  return cmd;
+}
+
+void bench_parse_args(benchmark::State& state) {
+  auto args = std::vector<std::string>();
+  auto cmd = make_cmdline(static_cast<size_t>(state.range(0)), args);
+  auto argv = std::vector<const char*>();
+  for (const auto& arg : args) {
+    argv.emplace_back(arg.c_str());
+  }
+  for (auto _ : state) {
+    cmd.parse_args(static_cast<int>(argv.size()), argv.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void bench_help_string(benchmark::State& state) {
+  auto args = std::vector<std::string>();
+  auto cmd = make_cmdline(static_cast<size_t>(state.range(0)), args);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cmd.help_string());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+}  // namespace
+
+BENCHMARK(bench_parse_args)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(bench_help_string)->Arg(10)->Arg(100)->Arg(1000);
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,88 @@
+#include "storage/config.hpp"
+
+#include <format>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+auto get_config() -> ascpp::config& {
+  static auto cfg = ascpp::config(nlohmann::json{{"server", {{"port", 8080}, {"threads", 64}}}});
+  return cfg;
+}
+
+// Load a snapshot and read a key from it, concurrently on several threads
+void bench_config_read(benchmark::State& state) {
+  auto& cfg = get_config();
+  for (auto _ : state) {
+    auto data = cfg.get();
+    benchmark::DoNotOptimize((*data)["server"]["port"].get<int>());
+  }
+}
+
+// Read a value through a bound key, which is resolved only once
+void bench_config_key(benchmark::State& state) {
+  auto port = get_config().bind<int>("/server/port");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(port.get().value());
+  }
+}
+
+// Publish a new snapshot while other threads keep reading
+void bench_config_read_write(benchmark::State& state) {
+  auto& cfg = get_config();
+  auto port = 0;
+  for (auto _ : state) {
+    if (state.thread_index() == 0) {
+      (void)cfg.update([&](nlohmann::json& data) { data["server"]["port"] = ++port; });
+    } else {
+      auto data = cfg.get();
+      benchmark::DoNotOptimize((*data)["server"]["port"].get<int>());
+    }
+  }
+}
+
+// Validate a whole config by a compiled schema, as done before each publication
+void bench_config_validate(benchmark::State& state) {
+  auto schema = ascpp::config_schema();
+  auto data = nlohmann::json::object();
+  for (auto i = 0; i < state.range(0); ++i) {
+    auto name = std::to_string(i);
+    schema.add<int>(std::format("/servers/{}/port", name)).required().with_range(1, 65535);
+    schema.add<std::string>(std::format("/servers/{}/host", name)).required();
+    data["servers"][name] = {{"port", 8000 + i}, {"host", "localhost"}};
+  }
+  auto validator = schema.compile();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(validator.validate(data));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) * 2);
+}
+
+// Patch one value of configs of growing sizes, the cost depends on the patch, not on the config
+void bench_config_patch(benchmark::State& state) {
+  auto data = nlohmann::json::object();
+  for (auto i = 0; i < state.range(0); ++i) {
+    data["servers"][std::format("s{:05}", i)] = {{"port", 8000}, {"host", "localhost"}};
+  }
+  auto cfg = ascpp::config(data);
+  auto port = 0;
+  for (auto _ : state) {
+    auto ops = nlohmann::json::array(
+        {{{"op", "replace"}, {"path", "/servers/s00000/port"}, {"value", ++port % 65536}}});
+    benchmark::DoNotOptimize(cfg.patch(ops));
+  }
+}
+
+}  // namespace
+
+BENCHMARK(bench_config_read)->ThreadRange(1, 8);
+BENCHMARK(bench_config_key)->ThreadRange(1, 8);
+BENCHMARK(bench_config_read_write)->ThreadRange(2, 8);
+BENCHMARK(bench_config_validate)->Range(8, 512);
+BENCHMARK(bench_config_patch)->Range(8, 8192);
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,95 @@
+#include "storage/config_file.hpp"
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+#include "benchmark/benchmark.h"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+// A generated config of about 3 MiB, routes as string-heavy part and tables as number-heavy part
+auto get_config_path() -> const std::filesystem::path& {
+  static auto path = [] {
+    auto dir = std::filesystem::temp_directory_path() / "ascpp_config_bench";
+    std::filesystem::create_directories(dir);
+    auto data = nlohmann::json::object();
+    for (auto i = 0; i < 5000; ++i) {
+      data["routes"][std::format("/api/v1/resource{}", i)] = {
+          {"upstream", std::format("10.0.{}.{}:8080", i / 256, i % 256)},
+          {"timeout_ms", 1000 + i},
+          {"retry", i % 3},
+      };
+    }
+    for (auto i = 0; i < 2000; ++i) {
+      auto& row = data["tables"][std::format("row{}", i)];
+      for (auto j = 0; j < 32; ++j) {
+        row.push_back(i * 0.731 + j * 1.37e-3);
+      }
+    }
+    std::ofstream(dir / "config.json") << data.dump(2);
+    return dir / "config.json";
+  }();
+  return path;
+}
+
+void bench_config_parse_text(benchmark::State& state) {
+  const auto& path = get_config_path();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::read_config_file(path).value());
+  }
+}
+
+void bench_config_load_cache(benchmark::State& state) {
+  const auto& path = get_config_path();
+  auto cache_path = path.parent_path() / "config.msgpack";
+  std::filesystem::remove(cache_path);
+  (void)ascpp::read_config_file(path, cache_path).value();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::read_config_file(path, cache_path).value());
+  }
+}
+
+// Open the config_view of the config, nothing is read until a lookup
+void bench_config_view_open(benchmark::State& state) {
+  const auto& path = get_config_path();
+  auto view_path = path.parent_path() / "config.view";
+  ascpp::write_config_view(view_path, ascpp::read_config_file(path).value()).value();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::open_config_view(view_path).value());
+  }
+}
+
+void bench_config_view_find(benchmark::State& state) {
+  const auto& path = get_config_path();
+  auto view_path = path.parent_path() / "config.view";
+  ascpp::write_config_view(view_path, ascpp::read_config_file(path).value()).value();
+  auto view = ascpp::open_config_view(view_path).value();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        view.find("/routes/~1api~1v1~1resource4242/timeout_ms").has_value()
+        || view.find("/tables/row1234/17").value().get<double>().value() > 0);
+  }
+}
+
+// The same lookups in the DOM
+void bench_config_json_find(benchmark::State& state) {
+  auto data = ascpp::read_config_file(get_config_path()).value();
+  auto route = nlohmann::json::json_pointer("/routes/~1api~1v1~1resource4242/timeout_ms");
+  auto row = nlohmann::json::json_pointer("/tables/row1234/17");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(data.contains(route) || data[row].get<double>() > 0);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(bench_config_parse_text)->Unit(benchmark::kMillisecond);
+BENCHMARK(bench_config_load_cache)->Unit(benchmark::kMillisecond);
+BENCHMARK(bench_config_view_open);
+BENCHMARK(bench_config_view_find);
+BENCHMARK(bench_config_json_find);
+
+// NOLINTEND(modernize-use-trailing-return-type)
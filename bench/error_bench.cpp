@@ -0,0 +1,133 @@
+#include "utils/error.hpp"
+
+#include <system_error>
+
+#include "benchmark/benchmark.h"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+constexpr auto chain_depth = 10;
+
+// The leaf is not inlined so that each chain measures the propagation of an opaque result
+template <typename R>
+[[gnu::noinline]] auto leaf(int x) -> R {
+  if (x < 0) [[unlikely]] {
+    return make_error_code(ascpp::error::INVALID_ARGUMENT);
+  }
+  return x;
+}
+
+[[gnu::noinline]] auto leaf_errc(int x, int* out) -> std::errc {
+  if (x < 0) [[unlikely]] {
+    return std::errc::invalid_argument;
+  }
+  *out = x;
+  return {};
+}
+
+template <int N>
+auto errc_chain(int x, int* out) -> std::errc {
+  if constexpr (N == 0) {
+    return leaf_errc(x, out);
+  } else {
+    auto val = 0;
+    if (auto ec = errc_chain<N - 1>(x, &val); ec != std::errc()) {
+      return ec;
+    }
+    *out = val + 1;
+    return {};
+  }
+}
+
+template <typename R, int N>
+auto try_assign_chain(int x) -> R {
+  if constexpr (N == 0) {
+    return leaf<R>(x);
+  } else {
+    TRY_ASSIGN(auto val, (try_assign_chain<R, N - 1>(x)));
+    return val + 1;
+  }
+}
+
+template <typename R, int N>
+auto map_chain(int x) -> R {
+  if constexpr (N == 0) {
+    return leaf<R>(x);
+  } else {
+    return map_chain<R, N - 1>(x).map([](int val) { return val + 1; });
+  }
+}
+
+template <typename R, int N>
+auto context_chain(int x) -> R {
+  if constexpr (N == 0) {
+    return leaf<R>(x);
+  } else {
+    return context_chain<R, N - 1>(x).context("depth {}", N);
+  }
+}
+
+// state.range(0) == 0 for the success path, otherwise the error path
+auto input(const benchmark::State& state) -> int {
+  return state.range(0) == 0 ? 1 : -1;
+}
+
+void bench_errc_chain(benchmark::State& state) {
+  auto x = input(state);
+  for (auto _ : state) {
+    auto out = 0;
+    benchmark::DoNotOptimize(x);
+    benchmark::DoNotOptimize(errc_chain<chain_depth>(x, &out));
+    benchmark::DoNotOptimize(out);
+  }
+}
+
+template <typename R>
+void bench_try_assign_chain(benchmark::State& state) {
+  auto x = input(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(x);
+    benchmark::DoNotOptimize(try_assign_chain<R, chain_depth>(x));
+  }
+}
+
+template <typename R>
+void bench_map_chain(benchmark::State& state) {
+  auto x = input(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(x);
+    benchmark::DoNotOptimize(map_chain<R, chain_depth>(x));
+  }
+}
+
+template <typename R>
+void bench_context_chain(benchmark::State& state) {
+  auto x = input(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(x);
+    benchmark::DoNotOptimize(context_chain<R, chain_depth>(x));
+  }
+  ascpp::clear_error_context();
+}
+
+void bench_result_error_what(benchmark::State& state) {
+  auto ec = make_error_code(ascpp::error::OUT_OF_RANGE);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::result_error(ec).what());
+  }
+}
+
+}  // namespace
+
+BENCHMARK(bench_errc_chain)->ArgName("error")->Arg(0)->Arg(1);
+BENCHMARK(bench_try_assign_chain<ascpp::result<int>>)->ArgName("error")->Arg(0)->Arg(1);
+BENCHMARK(bench_try_assign_chain<ascpp::compact_result<int>>)->ArgName("error")->Arg(0)->Arg(1);
+BENCHMARK(bench_map_chain<ascpp::result<int>>)->ArgName("error")->Arg(0)->Arg(1);
+BENCHMARK(bench_map_chain<ascpp::compact_result<int>>)->ArgName("error")->Arg(0)->Arg(1);
+BENCHMARK(bench_context_chain<ascpp::result<int>>)->ArgName("error")->Arg(0)->Arg(1);
+BENCHMARK(bench_context_chain<ascpp::compact_result<int>>)->ArgName("error")->Arg(0)->Arg(1);
+BENCHMARK(bench_result_error_what);
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,113 @@
+#include "utils/log.hpp"
+
+#include <memory>
+#include <span>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+#include "app/info.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+const auto info = ascpp::app_info{"mrbeardad", "ascpp", "awesome cpp framework", 0, 0, 1};
+
+class null_sink : public ascpp::log_sink {
+ public:
+  auto write(std::span<const ascpp::log_entry> entries) -> void override {
+    benchmark::DoNotOptimize(entries.data());
+  }
+};
+
+// Run as many iterations as the ring capacity, so that the cost of a log call is measured without
+// dropping records even if the background thread does not get scheduled
+constexpr auto ring_capacity = 1UZ << 16;
+
+auto get_logger() -> ascpp::logger& {
+  static auto log = [] {
+    auto ret = ascpp::logger(&info, {.ring_capacity = ring_capacity});
+    ret.set_sinks({std::make_shared<null_sink>()});
+    return ret;
+  }();
+  return log;
+}
+
+void bench_log_no_arg(benchmark::State& state) {
+  auto& log = get_logger();
+  for (auto _ : state) {
+    log.info("request handled");
+  }
+  log.flush();
+  state.counters["dropped"] = static_cast<double>(log.dropped());
+}
+
+void bench_log_int(benchmark::State& state) {
+  auto& log = get_logger();
+  auto i = 0;
+  for (auto _ : state) {
+    log.info("request {} handled in {} us", i++, 42);
+  }
+  log.flush();
+  state.counters["dropped"] = static_cast<double>(log.dropped());
+}
+
+void bench_log_string(benchmark::State& state) {
+  auto& log = get_logger();
+  auto path = std::string("/api/v1/users/12345/profile");
+  for (auto _ : state) {
+    log.info("GET {} -> {} ({:.3f} ms)", path, 200, 1.25);
+  }
+  log.flush();
+  state.counters["dropped"] = static_cast<double>(log.dropped());
+}
+
+// A DEBUG statement below the runtime level, as in production request handlers
+void bench_log_filtered(benchmark::State& state) {
+  auto& log = get_logger();
+  log.set_level(ascpp::logger::INFO);
+  auto path = std::string("/api/v1/users/12345/profile");
+  for (auto _ : state) {
+    ASCPP_LOG_DEBUG(log, "GET {} -> {}", path, 200);
+  }
+  log.set_level(ascpp::logger::TRACE);
+}
+
+// Cost of a statement suppressed by its call-site rate limit
+void bench_log_limited(benchmark::State& state) {
+  auto& log = get_logger();
+  auto path = std::string("/api/v1/users/12345/profile");
+  for (auto _ : state) {
+    ASCPP_LOG_EVERY(log, WARN, std::chrono::hours(1), "GET {} -> {}", path, 503);
+  }
+}
+
+// Cost of a call while a burst overflows a small ring, under each overflow policy
+void bench_log_overflow(benchmark::State& state) {
+  auto policy = static_cast<ascpp::log_overflow_policy>(state.range(0));
+  auto log = ascpp::logger(&info, {.ring_capacity = 1024, .overflow = policy});
+  log.set_sinks({std::make_shared<null_sink>()});
+  auto i = 0;
+  for (auto _ : state) {
+    log.info("request {} handled in {} us", i++, 42);
+  }
+  log.flush();
+  auto stats = log.get_stats();
+  state.counters["dropped"] = static_cast<double>(stats.dropped);
+  state.counters["high_water"] = static_cast<double>(stats.high_water);
+}
+
+}  // namespace
+
+BENCHMARK(bench_log_filtered);
+BENCHMARK(bench_log_limited);
+BENCHMARK(bench_log_no_arg)->Iterations(ring_capacity)->Repetitions(5);
+BENCHMARK(bench_log_int)->Iterations(ring_capacity)->Repetitions(5);
+BENCHMARK(bench_log_string)->Iterations(ring_capacity)->Repetitions(5);
+BENCHMARK(bench_log_overflow)
+    ->ArgName("policy")
+    ->DenseRange(static_cast<int>(ascpp::log_overflow_policy::block),
+                 static_cast<int>(ascpp::log_overflow_policy::sample));
+
+// NOLINTEND(modernize-use-trailing-return-type)
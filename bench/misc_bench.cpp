@@ -0,0 +1,75 @@
+#include "utils/misc.hpp"
+
+#include <string>
+#include <string_view>
+
+#include "benchmark/benchmark.h"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type,google-runtime-int)
+
+namespace {
+
+void bench_display_width(benchmark::State& state, std::string_view text) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::display_width(text));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+void bench_display_width_char(benchmark::State& state, char32_t ucs) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::display_width(ucs));
+  }
+}
+
+template <typename T>
+void bench_to_number(benchmark::State& state, std::string_view str) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::to_number<T>(str));
+  }
+}
+
+// BENCHMARK_CAPTURE does not accept template names
+void bench_to_int(benchmark::State& state, std::string_view str) {
+  bench_to_number<int>(state, str);
+}
+
+void bench_to_long_long(benchmark::State& state, std::string_view str) {
+  bench_to_number<long long>(state, str);
+}
+
+void bench_to_unsigned_long(benchmark::State& state, std::string_view str) {
+  bench_to_number<unsigned long>(state, str);
+}
+
+void bench_to_float(benchmark::State& state, std::string_view str) {
+  bench_to_number<float>(state, str);
+}
+
+void bench_to_double(benchmark::State& state, std::string_view str) {
+  bench_to_number<double>(state, str);
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(bench_display_width, ascii, "  -o, --output=<string>"sv);
+BENCHMARK_CAPTURE(bench_display_width, cjk, "你tnd真是个人才"sv);
+BENCHMARK_CAPTURE(bench_display_width, emoji, "🤡🦊🐶🤸"sv);
+BENCHMARK_CAPTURE(bench_display_width_char, ascii, U'a');
+BENCHMARK_CAPTURE(bench_display_width_char, combining, U'\u0300');
+BENCHMARK_CAPTURE(bench_display_width_char, cjk, U'你');
+
+BENCHMARK_CAPTURE(bench_to_int, bin, "0b1011"sv);
+BENCHMARK_CAPTURE(bench_to_int, oct, "0o777"sv);
+BENCHMARK_CAPTURE(bench_to_int, dec, "-123456"sv);
+BENCHMARK_CAPTURE(bench_to_int, hex, "0x7fffffff"sv);
+BENCHMARK_CAPTURE(bench_to_int, invalid, "12ab"sv);
+BENCHMARK_CAPTURE(bench_to_int, out_of_range, "+2147483648"sv);
+BENCHMARK_CAPTURE(bench_to_long_long, dec, "-9223372036854775807"sv);
+BENCHMARK_CAPTURE(bench_to_unsigned_long, hex, "0xffffffff"sv);
+BENCHMARK_CAPTURE(bench_to_float, dec, "3.1415926"sv);
+BENCHMARK_CAPTURE(bench_to_float, hex, "0x1.8p1"sv);
+BENCHMARK_CAPTURE(bench_to_double, dec, "2.718281828459045"sv);
+BENCHMARK_CAPTURE(bench_to_double, exp, "6.02214076e23"sv);
+
+// NOLINTEND(modernize-use-trailing-return-type,google-runtime-int)
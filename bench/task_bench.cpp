@@ -0,0 +1,42 @@
+#include "async/task.hpp"
+
+#include <utility>
+
+#include "benchmark/benchmark.h"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+constexpr auto batch = 10000;
+
+auto leaf(int n) -> ascpp::task<int> {
+  co_return n + 1;
+}
+
+auto parent(int n) -> ascpp::task<int> {
+  co_return co_await leaf(n) + co_await leaf(n);
+}
+
+// Create and complete batch tasks each awaiting a parent awaiting two children, i.e. four frames,
+// taken from the frame pool or from the global heap
+void bench_task_spawn(benchmark::State& state) {
+  ascpp::frame_pool::set_enabled(state.range(0) != 0);
+  for (auto _ : state) {
+    auto sum = 0;
+    for (auto i = 0; i < batch; ++i) {
+      auto t = parent(i);
+      auto run = [&]() -> ascpp::task<> { sum += co_await std::move(t); };
+      std::move(run()).detach();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  ascpp::frame_pool::set_enabled(true);
+  state.SetItemsProcessed(state.iterations() * batch * 4);
+}
+
+}  // namespace
+
+BENCHMARK(bench_task_spawn)->Arg(0)->Arg(1);
+
+// NOLINTEND(modernize-use-trailing-return-type)
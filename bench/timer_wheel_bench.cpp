@@ -0,0 +1,55 @@
+#include "async/timer_wheel.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "asio/io_context.hpp"
+#include "asio/steady_timer.hpp"
+#include "benchmark/benchmark.h"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// Schedule and cancel one timer among range(0) pending ones, the usual life of a request timeout
+void bench_wheel_schedule_cancel(benchmark::State& state) {
+  auto ctx = asio::io_context();
+  auto wheel = ascpp::timer_wheel(ctx);
+  auto pending = std::vector<std::unique_ptr<ascpp::wheel_timer>>();
+  for (auto i = 0; i < state.range(0); ++i) {
+    pending.push_back(std::make_unique<ascpp::wheel_timer>(wheel));
+    pending.back()->start_after(10s + i * 1ms, [] {});
+  }
+  auto timer = ascpp::wheel_timer(wheel);
+  for (auto _ : state) {
+    timer.start_after(5s, [] {});
+    timer.cancel();
+  }
+}
+
+void bench_asio_schedule_cancel(benchmark::State& state) {
+  auto ctx = asio::io_context();
+  auto pending = std::vector<std::unique_ptr<asio::steady_timer>>();
+  for (auto i = 0; i < state.range(0); ++i) {
+    pending.push_back(std::make_unique<asio::steady_timer>(ctx, 10s + i * 1ms));
+    pending.back()->async_wait([](const asio::error_code& /*ec*/) {});
+  }
+  auto timer = asio::steady_timer(ctx);
+  for (auto _ : state) {
+    timer.expires_after(5s);
+    timer.async_wait([](const asio::error_code& /*ec*/) {});
+    timer.cancel();
+    ctx.poll();
+  }
+}
+
+}  // namespace
+
+BENCHMARK(bench_wheel_schedule_cancel)->RangeMultiplier(100)->Range(1, 1000000);
+BENCHMARK(bench_asio_schedule_cancel)->RangeMultiplier(100)->Range(1, 1000000);
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,58 @@
+#include "utils/utf.hpp"
+
+#include <string>
+#include <string_view>
+
+#include "benchmark/benchmark.h"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+auto repeat(std::string_view unit, size_t times) -> std::string {
+  auto ret = std::string();
+  for (auto i = 0UZ; i < times; ++i) {
+    ret += unit;
+  }
+  return ret;
+}
+
+const auto ascii_text = repeat("the quick brown fox jumps over the lazy dog ", 32);
+const auto cjk_text = repeat("敏捷的棕色狐狸跳过了懒狗", 32);
+const auto emoji_text = repeat("fox🦊 dog🐶 jump🤸 ", 32);
+
+void bench_utf8_to_utf32(benchmark::State& state, const std::string& text) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::utf_conv<char32_t>(std::string_view(text)));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+void bench_utf32_to_utf8(benchmark::State& state, const std::string& text) {
+  auto utf32 = ascpp::utf_conv<char32_t>(std::string_view(text)).value();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::utf_conv<char>(std::u32string_view(utf32)));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+void bench_utf8_to_wide(benchmark::State& state, const std::string& text) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ascpp::utf_conv<wchar_t>(std::string_view(text)));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(bench_utf8_to_utf32, ascii, ascii_text);
+BENCHMARK_CAPTURE(bench_utf8_to_utf32, cjk, cjk_text);
+BENCHMARK_CAPTURE(bench_utf8_to_utf32, emoji, emoji_text);
+BENCHMARK_CAPTURE(bench_utf32_to_utf8, ascii, ascii_text);
+BENCHMARK_CAPTURE(bench_utf32_to_utf8, cjk, cjk_text);
+BENCHMARK_CAPTURE(bench_utf32_to_utf8, emoji, emoji_text);
+BENCHMARK_CAPTURE(bench_utf8_to_wide, ascii, ascii_text);
+BENCHMARK_CAPTURE(bench_utf8_to_wide, cjk, cjk_text);
+BENCHMARK_CAPTURE(bench_utf8_to_wide, emoji, emoji_text);
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,93 @@
+#include "async/worker.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <latch>
+
+#include "benchmark/benchmark.h"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+constexpr auto batch = 10000;
+
+auto fib(ascpp::thread_pool& pool, int n) -> long {
+  if (n < 12) {
+    return n < 2 ? n : fib(pool, n - 1) + fib(pool, n - 2);
+  }
+  auto [a, b] = pool.when_all([&] { return fib(pool, n - 1); }, [&] { return fib(pool, n - 2); });
+  return a + b;
+}
+
+// Submit jobs from outside the pool, through the injection queue
+void bench_pool_submit(benchmark::State& state) {
+  auto pool = ascpp::thread_pool(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto done = std::latch(batch);
+    for (auto i = 0; i < batch; ++i) {
+      pool.submit([&] { done.count_down(); });
+    }
+    done.wait();
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+
+// Jobs submitted by the workers themselves, pushed to their own deques and stolen by the others
+void bench_pool_spawn(benchmark::State& state) {
+  auto pool = ascpp::thread_pool(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto done = std::latch(batch);
+    pool.submit([&] {
+      for (auto i = 0; i < batch; ++i) {
+        pool.submit([&] { done.count_down(); });
+      }
+    });
+    done.wait();
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+
+void bench_pool_bulk_submit(benchmark::State& state) {
+  auto pool = ascpp::thread_pool(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto done = std::latch(batch);
+    pool.bulk_submit(batch, [&](std::size_t /*index*/) { done.count_down(); });
+    done.wait();
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+
+// Recursive fork-join, each when_all() waits by running other jobs
+void bench_pool_when_all(benchmark::State& state) {
+  auto pool = ascpp::thread_pool(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto [n] = pool.when_all([&] { return fib(pool, 25); });
+    benchmark::DoNotOptimize(n);
+  }
+}
+
+// Jobs sent from one core to the others through the SPSC queues, compare with bench_pool_spawn
+void bench_cores_post(benchmark::State& state) {
+  auto cores = ascpp::thread_per_core(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto done = std::latch(batch);
+    cores.post(0, [&] {
+      for (auto i = 0; i < batch; ++i) {
+        cores.post(static_cast<std::size_t>(i) % cores.size(), [&] { done.count_down(); });
+      }
+    });
+    done.wait();
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+
+}  // namespace
+
+BENCHMARK(bench_pool_submit)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+BENCHMARK(bench_pool_spawn)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+BENCHMARK(bench_pool_bulk_submit)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+BENCHMARK(bench_pool_when_all)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+BENCHMARK(bench_cores_post)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+// NOLINTEND(modernize-use-trailing-return-type)
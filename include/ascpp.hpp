@@ -1,16 +1,29 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <stdexcept>
 #include <string>
 
 #include "app/info.hpp"
+#include "async/worker.hpp"
 #include "utils/cmdline.hpp"
 #include "utils/error.hpp"
 
 // TODO: detect single app
 namespace ascpp {
 
+/**
+ * @brief Runtime the app runs its work on.
+ */
+enum class runtime_mode {
+  work_stealing,    ///< A thread_pool shared by all the work, App::pool()
+  thread_per_core,  ///< A thread_per_core for shared-nothing services, App::cores()
+};
+
 struct AppConfig {
   std::string org_name;
   std::string app_name;
@@ -18,6 +31,8 @@ struct AppConfig {
   int major_ver;
   int minor_ver;
   int patch_ver;
+  std::size_t worker_threads = 0;  ///< Threads of the runtime, 0 for one per core
+  runtime_mode runtime = runtime_mode::work_stealing;
 };
 
 class App : public app_info, public cmdline {
@@ -29,13 +44,60 @@ class App : public app_info, public cmdline {
                  config.major_ver,
                  config.minor_ver,
                  config.patch_ver),
-        cmdline{static_cast<app_info*>(this)} {}
+        cmdline{static_cast<app_info*>(this)},
+        _runtime(std::make_shared<runtime_state>(config.runtime, config.worker_threads)) {}
 
   App(App&&) = default;
   App(const App&) = default;
   auto operator=(App&&) -> App& = default;
   auto operator=(const App&) -> App& = default;
   ~App() = default;
+
+  auto runtime() const -> runtime_mode { return _runtime->mode; }
+
+  /**
+   * @brief Get the work-stealing thread pool of the app, started on the first call and shared by
+   * the copies of the app.
+   *
+   * @throw std::logic_error if the runtime of the app is not runtime_mode::work_stealing
+   */
+  auto pool() -> thread_pool& {
+    if (_runtime->mode != runtime_mode::work_stealing) {
+      throw std::logic_error("the app runs thread per core");
+    }
+    std::call_once(_runtime->once,
+                   [&] { _runtime->pool = std::make_unique<thread_pool>(_runtime->threads); });
+    return *_runtime->pool;
+  }
+
+  /**
+   * @brief Get the thread-per-core runtime of the app, started on the first call and shared by
+   * the copies of the app.
+   *
+   * @throw std::logic_error if the runtime of the app is not runtime_mode::thread_per_core
+   */
+  auto cores() -> thread_per_core& {
+    if (_runtime->mode != runtime_mode::thread_per_core) {
+      throw std::logic_error("the app runs a work-stealing pool");
+    }
+    std::call_once(_runtime->once, [&] {
+      _runtime->cores = std::make_unique<thread_per_core>(_runtime->threads);
+    });
+    return *_runtime->cores;
+  }
+
+ private:
+  struct runtime_state {
+    runtime_state(runtime_mode mode, std::size_t threads) : mode(mode), threads(threads) {}
+
+    runtime_mode mode;
+    std::size_t threads;
+    std::once_flag once;
+    std::unique_ptr<thread_pool> pool;
+    std::unique_ptr<thread_per_core> cores;
+  };
+
+  std::shared_ptr<runtime_state> _runtime;
 };
 
 }  // namespace ascpp
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace ascpp {
+
+/**
+ * @brief Statistics of the frame pool of the current thread.
+ */
+struct frame_pool_stats {
+  std::uint64_t allocated = 0;  ///< Frames allocated
+  std::uint64_t reused = 0;     ///< Frames allocated from the free lists
+  std::uint64_t oversized = 0;  ///< Frames too large for the size classes, from the global heap
+  std::size_t cached = 0;       ///< Frames in the free lists now
+};
+
+/**
+ * @brief Per-thread pool of coroutine frames.
+ *
+ * Frames are rounded up to size classes of granularity bytes, each with a free list of the frames
+ * freed on the thread, so allocating and freeing a frame costs a few loads and stores without
+ * locking or calling malloc. A frame may be freed on another thread than the one allocating it,
+ * it goes to the free list of the freeing thread, since all the frames come from the global heap
+ * in the first place. Frames larger than the largest class, and the frames beyond max_cached in a
+ * free list, go to and from the global heap. The free lists are released when the thread exits.
+ */
+class frame_pool {
+ public:
+  static constexpr auto granularity = 64UZ;
+  static constexpr auto class_count = 16UZ;  ///< Up to frames of 1 KiB
+  static constexpr auto max_cached = 1024UZ;  ///< Frames kept per class and thread
+
+  static auto allocate(std::size_t size) -> void* {
+    auto& state = _state;
+    ++state.stats.allocated;
+    auto index = _class_of(size);
+    if (index >= class_count) [[unlikely]] {
+      ++state.stats.oversized;
+      return ::operator new(size);
+    }
+    auto& list = state.lists[index];
+    if (list.head != nullptr && state.enabled) {
+      auto* block = list.head;
+      list.head = block->next;
+      --list.count;
+      --state.stats.cached;
+      ++state.stats.reused;
+      return block;
+    }
+    return ::operator new((index + 1) * granularity);
+  }
+
+  static auto deallocate(void* frame, std::size_t size) noexcept -> void {
+    auto& state = _state;
+    auto index = _class_of(size);
+    if (index >= class_count || !state.enabled || state.lists[index].count >= max_cached)
+        [[unlikely]] {
+      ::operator delete(frame);
+      return;
+    }
+    if (!state.reaper_registered) [[unlikely]] {
+      state.reaper_registered = true;
+      _register_reaper();
+    }
+    auto& list = state.lists[index];
+    list.head = new (frame) block{list.head};
+    ++list.count;
+    ++state.stats.cached;
+  }
+
+  static auto stats() -> frame_pool_stats { return _state.stats; }
+
+  /**
+   * @brief Enable or disable the pool on the current thread, e.g. to compare with the global heap.
+   * It is enabled by default.
+   */
+  static auto set_enabled(bool enabled) -> void {
+    if (!enabled) {
+      _release();
+    }
+    _state.enabled = enabled;
+  }
+
+ private:
+  struct block {
+    block* next;
+  };
+
+  struct free_list {
+    block* head;
+    std::size_t count;
+  };
+
+  // Trivial, so that it is never destroyed and a frame freed while the thread exits finds it
+  struct state {
+    std::array<free_list, class_count> lists;
+    frame_pool_stats stats;
+    bool enabled = true;
+    bool reaper_registered = false;
+  };
+
+  static auto _class_of(std::size_t size) -> std::size_t { return (size - 1) / granularity; }
+
+  static auto _release() noexcept -> void {
+    for (auto& list : _state.lists) {
+      while (list.head != nullptr) {
+        ::operator delete(std::exchange(list.head, list.head->next));
+      }
+      list.count = 0;
+    }
+    _state.stats.cached = 0;
+  }
+
+  static auto _register_reaper() -> void {
+    struct reaper {
+      reaper() = default;
+      reaper(reaper&&) = delete;
+      reaper(const reaper&) = delete;
+      auto operator=(reaper&&) -> reaper& = delete;
+      auto operator=(const reaper&) -> reaper& = delete;
+
+      ~reaper() {
+        _release();
+        _state.enabled = false;
+      }
+    };
+    thread_local auto instance = reaper();
+    (void)instance;
+  }
+
+  static thread_local state _state;
+};
+
+inline constinit thread_local frame_pool::state frame_pool::_state = {};
+
+}  // namespace ascpp
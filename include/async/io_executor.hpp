@@ -0,0 +1,276 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "asio/error.hpp"
+#include "asio/io_context.hpp"
+#include "asio/post.hpp"
+#include "asio/read.hpp"
+#include "asio/steady_timer.hpp"
+#include "asio/write.hpp"
+
+#include "async/task.hpp"
+#include "utils/error.hpp"
+
+namespace ascpp {
+
+namespace detail {
+
+/**
+ * @brief Awaiter of an asio asynchronous operation, started by initiate with a completion handler
+ * that stores the outcome and resumes the coroutine, giving a result<Value>. A task returning a
+ * result is completed with the error instead of being resumed, see task.
+ *
+ * The awaiter lives in the frame of the awaiting coroutine, so awaiting needs no allocation of its
+ * own, the operation state is allocated by asio, which recycles it per thread.
+ */
+template <typename Value, typename Initiate>
+class asio_awaiter {
+ public:
+  explicit asio_awaiter(Initiate initiate) : _initiate(std::move(initiate)) {}
+
+  auto await_ready() const noexcept -> bool { return false; }
+
+  auto await_suspend(std::coroutine_handle<> handle) -> void {
+    _next = continuation(handle, _hook);
+    if constexpr (std::is_void_v<Value>) {
+      _initiate([this](const asio::error_code& ec) {
+        _ec = ec;
+        _next.next(_ec).resume();
+      });
+    } else {
+      _initiate([this](const asio::error_code& ec, Value value) {
+        _ec = ec;
+        if (!ec) {
+          _value.emplace(std::move(value));
+        }
+        _next.next(_ec).resume();
+      });
+    }
+  }
+
+  auto set_error_hook(error_hook hook) -> void { _hook = hook; }
+
+  auto await_resume() -> result<Value> {
+    if (_ec) {
+      return _ec;
+    }
+    if constexpr (!std::is_void_v<Value>) {
+      return std::move(*_value);
+    } else {
+      return {};
+    }
+  }
+
+ private:
+  Initiate _initiate;
+  error_hook _hook = nullptr;
+  continuation _next;
+  std::error_code _ec;
+  std::optional<std::conditional_t<std::is_void_v<Value>, std::monostate, Value>> _value;
+};
+
+template <typename Value, typename Initiate>
+auto make_asio_awaiter(Initiate&& initiate) -> asio_awaiter<Value, std::decay_t<Initiate>> {
+  return asio_awaiter<Value, std::decay_t<Initiate>>(std::forward<Initiate>(initiate));
+}
+
+/**
+ * @brief Awaiter of a timer owned by itself, for io_executor::sleep_for() and sleep_until().
+ */
+class sleep_awaiter {
+ public:
+  sleep_awaiter(asio::io_context& ctx, std::chrono::steady_clock::time_point deadline)
+      : _timer(ctx, deadline) {}
+
+  auto await_ready() const noexcept -> bool { return false; }
+
+  auto await_suspend(std::coroutine_handle<> handle) -> void {
+    _next = continuation(handle, _hook);
+    _timer.async_wait([this](const asio::error_code& ec) {
+      _ec = ec;
+      _next.next(_ec).resume();
+    });
+  }
+
+  auto set_error_hook(error_hook hook) -> void { _hook = hook; }
+
+  auto await_resume() const -> result<void> {
+    if (_ec) {
+      return _ec;
+    }
+    return {};
+  }
+
+ private:
+  asio::steady_timer _timer;
+  error_hook _hook = nullptr;
+  continuation _next;
+  std::error_code _ec;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Runs tasks on an asio::io_context.
+ *
+ * On Linux the vendored asio is built with ASIO_HAS_IO_URING when liburing is found, so the file
+ * operations below go through io_uring, the sockets and timers through the default reactor of the
+ * io_context. Without liburing asio has no file support (ASIO_HAS_FILE is not defined). The
+ * coroutines are resumed by the completion handlers, i.e. on the threads running the io_context.
+ */
+class io_executor {
+ public:
+  explicit io_executor(asio::io_context& ctx) : _ctx(&ctx) {}
+
+  auto context() const -> asio::io_context& { return *_ctx; }
+
+  /**
+   * @brief Start the task on a thread running the io_context, it is destroyed when it is done.
+   */
+  template <typename T>
+  auto spawn(task<T> t) const -> void {
+    auto handle = std::exchange(t._handle, nullptr);
+    handle.promise().set_detached();
+    asio::post(*_ctx, [handle] { handle.resume(); });
+  }
+
+  /**
+   * @brief Run the io_context on the calling thread until the task is done, return its value.
+   *
+   * For main() and tests, while no other thread runs the io_context.
+   *
+   * @throw std::logic_error if the task waits while the io_context has nothing left to run
+   */
+  template <typename T>
+  auto block_on(task<T> t) const -> T {
+    auto handle = t._handle;
+    asio::post(*_ctx, [handle] { handle.resume(); });
+    _ctx->restart();
+    while (!handle.promise().completed()) {
+      if (_ctx->run_one() == 0) {
+        throw std::logic_error("the task waits for nothing to complete");
+      }
+    }
+    return handle.promise().value();
+  }
+
+  /**
+   * @brief Resume the awaiting coroutine on a thread running the io_context, after the handlers
+   * queued before.
+   */
+  auto schedule() const {
+    struct awaiter {
+      asio::io_context* ctx;
+
+      auto await_ready() const noexcept -> bool { return false; }
+
+      auto await_suspend(std::coroutine_handle<> handle) const -> void {
+        asio::post(*ctx, [handle] { handle.resume(); });
+      }
+
+      auto await_resume() const noexcept -> void {}
+    };
+    return awaiter{_ctx};
+  }
+
+  template <typename Rep, typename Period>
+  auto sleep_for(std::chrono::duration<Rep, Period> duration) const -> detail::sleep_awaiter {
+    return {*_ctx, std::chrono::steady_clock::now() +
+                       std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration)};
+  }
+
+  auto sleep_until(std::chrono::steady_clock::time_point deadline) const -> detail::sleep_awaiter {
+    return {*_ctx, deadline};
+  }
+
+ private:
+  asio::io_context* _ctx;
+};
+
+/**
+ * @brief Read some bytes from a stream, e.g. a socket or an asio::stream_file, give their count.
+ */
+template <typename Stream, typename Buffers>
+auto async_read_some(Stream& stream, const Buffers& buffers) {
+  return detail::make_asio_awaiter<std::size_t>([&stream, buffers](auto handler) {
+    stream.async_read_some(buffers, std::move(handler));
+  });
+}
+
+template <typename Stream, typename Buffers>
+auto async_write_some(Stream& stream, const Buffers& buffers) {
+  return detail::make_asio_awaiter<std::size_t>([&stream, buffers](auto handler) {
+    stream.async_write_some(buffers, std::move(handler));
+  });
+}
+
+/**
+ * @brief Fill the buffers from a stream, the count read before an error such as eof is lost.
+ */
+template <typename Stream, typename Buffers>
+auto async_read(Stream& stream, const Buffers& buffers) {
+  return detail::make_asio_awaiter<std::size_t>([&stream, buffers](auto handler) {
+    asio::async_read(stream, buffers, std::move(handler));
+  });
+}
+
+template <typename Stream, typename Buffers>
+auto async_write(Stream& stream, const Buffers& buffers) {
+  return detail::make_asio_awaiter<std::size_t>([&stream, buffers](auto handler) {
+    asio::async_write(stream, buffers, std::move(handler));
+  });
+}
+
+/**
+ * @brief Read some bytes at offset of an asio::random_access_file.
+ */
+template <typename File, typename Buffers>
+auto async_read_some_at(File& file, std::uint64_t offset, const Buffers& buffers) {
+  return detail::make_asio_awaiter<std::size_t>([&file, offset, buffers](auto handler) {
+    file.async_read_some_at(offset, buffers, std::move(handler));
+  });
+}
+
+template <typename File, typename Buffers>
+auto async_write_some_at(File& file, std::uint64_t offset, const Buffers& buffers) {
+  return detail::make_asio_awaiter<std::size_t>([&file, offset, buffers](auto handler) {
+    file.async_write_some_at(offset, buffers, std::move(handler));
+  });
+}
+
+/**
+ * @brief Accept a connection, give the socket connected.
+ */
+template <typename Acceptor>
+auto async_accept(Acceptor& acceptor) {
+  return detail::make_asio_awaiter<typename Acceptor::protocol_type::socket>(
+      [&acceptor](auto handler) { acceptor.async_accept(std::move(handler)); });
+}
+
+template <typename Socket>
+auto async_connect(Socket& socket, const typename Socket::endpoint_type& endpoint) {
+  return detail::make_asio_awaiter<void>([&socket, endpoint](auto handler) {
+    socket.async_connect(endpoint, std::move(handler));
+  });
+}
+
+/**
+ * @brief Wait for a timer owned by the caller, e.g. to cancel it from elsewhere.
+ */
+template <typename Timer>
+auto async_wait(Timer& timer) {
+  return detail::make_asio_awaiter<void>(
+      [&timer](auto handler) { timer.async_wait(std::move(handler)); });
+}
+
+}  // namespace ascpp
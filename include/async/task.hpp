@@ -0,0 +1,389 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "async/frame_pool.hpp"
+#include "utils/error.hpp"
+
+namespace ascpp {
+
+template <typename T = void>
+class task;
+
+class io_executor;
+
+namespace detail {
+
+/// Complete the coroutine of handle with the error ec, return the coroutine to run next
+using error_hook = std::coroutine_handle<> (*)(std::coroutine_handle<> handle,
+                                               const std::error_code& ec);
+
+/**
+ * @brief The coroutine awaiting an operation, to run once the outcome of the operation is known.
+ *
+ * A task returning a result sets an error hook when it awaits an operation giving a result, then
+ * an error completes the task with the error instead of resuming it, like TRY_ASSIGN.
+ */
+class continuation {
+ public:
+  continuation() = default;
+
+  explicit continuation(std::coroutine_handle<> handle, error_hook hook = nullptr)
+      : _handle(handle), _hook(hook) {}
+
+  /**
+   * @brief Get the coroutine to run when the operation completes with ec.
+   */
+  auto next(const std::error_code& ec) const -> std::coroutine_handle<> {
+    if (ec && _hook != nullptr) {
+      return _hook(_handle, ec);
+    }
+    return _handle ? _handle : std::noop_coroutine();
+  }
+
+ private:
+  std::coroutine_handle<> _handle;
+  error_hook _hook = nullptr;
+};
+
+class task_promise_base {
+ public:
+  struct final_awaiter {
+    auto await_ready() const noexcept -> bool { return false; }
+
+    template <typename P>
+    auto await_suspend(std::coroutine_handle<P> handle) noexcept -> std::coroutine_handle<> {
+      return handle.promise().complete(handle, handle.promise().error());
+    }
+
+    auto await_resume() const noexcept -> void {}
+  };
+
+  // The frames come from the frame pool of the thread
+  static auto operator new(std::size_t size) -> void* { return frame_pool::allocate(size); }
+
+  static auto operator delete(void* frame, std::size_t size) noexcept -> void {
+    frame_pool::deallocate(frame, size);
+  }
+
+  auto initial_suspend() const noexcept -> std::suspend_always { return {}; }
+
+  auto final_suspend() const noexcept -> final_awaiter { return {}; }
+
+  auto unhandled_exception() noexcept -> void { _exception = std::current_exception(); }
+
+  /**
+   * @brief Called when the coroutine is done, at its final suspend point or where it has returned
+   * an error, return the coroutine to run next: the awaiting one, or none for a detached one,
+   * which is destroyed here.
+   */
+  auto complete(std::coroutine_handle<> self, const std::error_code& ec) noexcept
+      -> std::coroutine_handle<> {
+    _completed = true;
+    if (_detached) {
+      // nobody is left to report an exception to, it terminates like std::thread
+      auto exception = _exception;
+      self.destroy();
+      if (exception) {
+        std::rethrow_exception(exception);
+      }
+      return std::noop_coroutine();
+    }
+    return _continuation.next(_exception ? std::error_code() : ec);
+  }
+
+  auto completed() const noexcept -> bool { return _completed; }
+
+  auto set_continuation(continuation next) noexcept -> void { _continuation = next; }
+
+  auto set_detached() noexcept -> void { _detached = true; }
+
+ protected:
+  auto rethrow_if_exception() const -> void {
+    if (_exception) {
+      std::rethrow_exception(_exception);
+    }
+  }
+
+ private:
+  continuation _continuation;
+  std::exception_ptr _exception;
+  bool _detached = false;
+  bool _completed = false;
+};
+
+template <typename T>
+class task_promise;
+
+template <typename T>
+auto complete_with_error(std::coroutine_handle<> handle, const std::error_code& ec)
+    -> std::coroutine_handle<> {
+  auto typed = std::coroutine_handle<task_promise<T>>::from_address(handle.address());
+  typed.promise().return_value(T(ec));
+  return typed.promise().complete(typed, ec);
+}
+
+template <typename A>
+auto get_awaiter(A&& awaitable) -> decltype(auto) {
+  if constexpr (requires { std::forward<A>(awaitable).operator co_await(); }) {
+    return std::forward<A>(awaitable).operator co_await();
+  } else {
+    return std::forward<A>(awaitable);
+  }
+}
+
+template <typename A>
+using awaiter_t = std::remove_cvref_t<decltype(get_awaiter(std::declval<A>()))>;
+
+/// Awaiters that give a result and let a task returning a result propagate its error
+template <typename A>
+concept error_propagating_awaiter = requires(A& awaiter) {
+  awaiter.set_error_hook(error_hook());
+  requires is_result_v<decltype(awaiter.await_resume())>;
+};
+
+/**
+ * @brief Awaiter of a result in a task returning a result: the value if there is one, otherwise
+ * the task returns the error without resuming.
+ */
+template <typename T, typename R>
+class result_awaiter {
+ public:
+  explicit result_awaiter(R res) : _res(std::move(res)) {}
+
+  auto await_ready() const noexcept -> bool { return _res.has_value(); }
+
+  auto await_suspend(std::coroutine_handle<> handle) noexcept -> std::coroutine_handle<> {
+    return complete_with_error<T>(handle, _res.error());
+  }
+
+  auto await_resume() -> typename R::value_type {
+    if constexpr (!std::is_void_v<typename R::value_type>) {
+      return std::move(*_res);
+    }
+  }
+
+ private:
+  R _res;
+};
+
+/**
+ * @brief Awaiter of an operation giving a result in a task returning a result, which is resumed
+ * with the value only.
+ */
+template <typename T, typename A>
+class unwrap_awaiter {
+ public:
+  explicit unwrap_awaiter(A inner) : _inner(std::move(inner)) {}
+
+  auto await_ready() -> bool { return _inner.await_ready(); }
+
+  auto await_suspend(std::coroutine_handle<> handle) -> decltype(auto) {
+    _inner.set_error_hook(&complete_with_error<T>);
+    return _inner.await_suspend(handle);
+  }
+
+  auto await_resume() -> auto {
+    auto res = _inner.await_resume();
+    if constexpr (!std::is_void_v<typename decltype(res)::value_type>) {
+      return std::move(*res);
+    }
+  }
+
+ private:
+  A _inner;
+};
+
+/**
+ * @brief Awaiter giving the result of an operation as is, see as_result().
+ */
+template <typename A>
+class as_result_awaiter {
+ public:
+  explicit as_result_awaiter(A inner) : _inner(std::move(inner)) {}
+
+  auto await_ready() -> bool { return _inner.await_ready(); }
+
+  auto await_suspend(std::coroutine_handle<> handle) -> decltype(auto) {
+    return _inner.await_suspend(handle);
+  }
+
+  auto await_resume() -> decltype(auto) { return _inner.await_resume(); }
+
+ private:
+  A _inner;
+};
+
+template <typename T>
+class task_promise : public task_promise_base {
+ public:
+  auto get_return_object() noexcept -> task<T>;
+
+  template <typename U>
+    requires std::constructible_from<T, U>
+  auto return_value(U&& value) -> void {
+    _value.emplace(std::forward<U>(value));
+  }
+
+  template <typename A>
+  auto await_transform(A&& awaitable) -> decltype(auto) {
+    if constexpr (!is_result_v<T>) {
+      return std::forward<A>(awaitable);
+    } else if constexpr (is_result_v<std::remove_cvref_t<A>>) {
+      return result_awaiter<T, std::remove_cvref_t<A>>(std::forward<A>(awaitable));
+    } else if constexpr (error_propagating_awaiter<awaiter_t<A>>) {
+      return unwrap_awaiter<T, awaiter_t<A>>(get_awaiter(std::forward<A>(awaitable)));
+    } else {
+      return std::forward<A>(awaitable);
+    }
+  }
+
+  /**
+   * @brief Error returned by the task, to propagate to the awaiting task.
+   */
+  auto error() const noexcept -> std::error_code {
+    if constexpr (is_result_v<T>) {
+      if (_value && !_value->has_value()) {
+        return _value->error();
+      }
+    }
+    return {};
+  }
+
+  auto value() -> T {
+    rethrow_if_exception();
+    return std::move(*_value);
+  }
+
+ private:
+  std::optional<T> _value;
+};
+
+template <>
+class task_promise<void> : public task_promise_base {
+ public:
+  auto get_return_object() noexcept -> task<void>;
+
+  auto return_void() noexcept -> void {}
+
+  auto error() const noexcept -> std::error_code { return {}; }
+
+  auto value() -> void { rethrow_if_exception(); }
+};
+
+}  // namespace detail
+
+/**
+ * @brief Await an operation giving a result in a task returning a result without returning its
+ * error, e.g. `auto size = co_await as_result(async_read_some(socket, buf));` to handle eof.
+ */
+template <typename A>
+auto as_result(A&& awaitable) -> detail::as_result_awaiter<detail::awaiter_t<A>> {
+  return detail::as_result_awaiter<detail::awaiter_t<A>>(
+      detail::get_awaiter(std::forward<A>(awaitable)));
+}
+
+/**
+ * @brief Lazily started coroutine returning T.
+ *
+ * A task starts when it is awaited and resumes the awaiting coroutine by symmetric transfer when it
+ * is done, so a chain of tasks neither grows the stack nor goes through a scheduler. Its frame is
+ * the only allocation, taken from the frame_pool of the thread. Run a top-level task with
+ * io_executor::spawn() or io_executor::block_on().
+ *
+ * In a task returning a result, `co_await` on a result, on an operation giving a result or on a
+ * task returning a result gives the value, or returns the error from the task at once, e.g.
+ * `auto size = co_await async_read_some(socket, buf);`. The task is not resumed on an error, so
+ * this costs no branch in its body. Wrap the operation by as_result() to get the result instead.
+ */
+template <typename T>
+class [[nodiscard]] task {
+ public:
+  using promise_type = detail::task_promise<T>;
+  using value_type = T;
+
+  task() = default;
+
+  task(task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+
+  task(const task&) = delete;
+
+  auto operator=(task&& other) noexcept -> task& {
+    std::swap(_handle, other._handle);
+    return *this;
+  }
+
+  auto operator=(const task&) -> task& = delete;
+
+  ~task() {
+    if (_handle) {
+      _handle.destroy();
+    }
+  }
+
+  auto done() const -> bool { return !_handle || _handle.promise().completed(); }
+
+  /**
+   * @brief Start the task and wait for its return value, rethrow its exception if it has thrown.
+   */
+  auto operator co_await() && noexcept {
+    class awaiter {
+     public:
+      explicit awaiter(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+      auto await_ready() const noexcept -> bool { return false; }
+
+      auto await_suspend(std::coroutine_handle<> handle) noexcept -> std::coroutine_handle<> {
+        _handle.promise().set_continuation(detail::continuation(handle, _hook));
+        return _handle;
+      }
+
+      auto await_resume() -> T { return _handle.promise().value(); }
+
+      auto set_error_hook(detail::error_hook hook) -> void { _hook = hook; }
+
+     private:
+      std::coroutine_handle<promise_type> _handle;
+      detail::error_hook _hook = nullptr;
+    };
+    return awaiter(_handle);
+  }
+
+  /**
+   * @brief Start the task on the current thread, it destroys itself when it is done.
+   */
+  auto detach() && -> void {
+    auto handle = std::exchange(_handle, nullptr);
+    handle.promise().set_detached();
+    handle.resume();
+  }
+
+ private:
+  friend class detail::task_promise<T>;
+  friend class io_executor;
+
+  explicit task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+  std::coroutine_handle<promise_type> _handle;
+};
+
+namespace detail {
+
+template <typename T>
+auto task_promise<T>::get_return_object() noexcept -> task<T> {
+  return task<T>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+inline auto task_promise<void>::get_return_object() noexcept -> task<void> {
+  return task<void>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+}  // namespace detail
+
+}  // namespace ascpp
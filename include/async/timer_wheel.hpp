@@ -0,0 +1,469 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "asio/io_context.hpp"
+#include "asio/steady_timer.hpp"
+
+#include "async/task.hpp"
+#include "utils/error.hpp"
+
+namespace ascpp {
+
+class timer_wheel;
+
+namespace detail {
+
+struct wheel_link {
+  wheel_link* prev = nullptr;
+  wheel_link* next = nullptr;
+};
+
+/**
+ * @brief Timer linked into a slot of a timer_wheel, embedded in its owner so that scheduling
+ * allocates nothing.
+ */
+struct wheel_entry : wheel_link {
+  static constexpr auto no_slot = ~std::uint32_t();
+
+  std::uint64_t expiry = 0;       ///< Tick to fire at
+  std::uint32_t slot = no_slot;   ///< Level * slot count + index, no_slot while being fired
+  void (*fire)(wheel_entry* self) = nullptr;
+
+  auto pending() const -> bool { return next != nullptr; }
+};
+
+template <typename T>
+struct timeout_value {
+  using type = T;
+};
+
+template <typename T>
+  requires is_result_v<T>
+struct timeout_value<T> {
+  using type = typename T::value_type;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Hierarchical timing wheel for large numbers of timeouts, driven by an io_context.
+ *
+ * Time is counted in ticks. The wheel has levels of 256 slots, a slot of level l spanning 256^l
+ * ticks, so 4 levels cover 2^32 ticks, about 49 days of 1 ms ticks, the timers further away wait
+ * in the last level until they get within reach. A timer is linked into the slot of its expiry at
+ * the lowest level that reaches it, and moved down a level each time the level below wraps around,
+ * so scheduling and cancelling are O(1) whatever the number of timers, where asio::steady_timer
+ * keeps a heap.
+ *
+ * A single steady_timer wakes the wheel at the next occupied slot of the lowest level, or at the
+ * next wrap-around when it is empty, and not at all when no timer is pending. The timers fire on
+ * the thread running the io_context, never earlier than their deadline and within about a tick
+ * after it. The wheel is not thread-safe, use it from the thread running the io_context, e.g. one
+ * wheel per core of a thread_per_core.
+ */
+class timer_wheel {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr auto slot_bits = 8U;
+  static constexpr auto slot_count = 1UZ << slot_bits;
+  static constexpr auto level_count = 4UZ;
+
+  explicit timer_wheel(asio::io_context& ctx, clock::duration tick = std::chrono::milliseconds(1))
+      : _timer(ctx), _tick(tick), _start(clock::now()) {
+    for (auto& level : _levels) {
+      for (auto& head : level.slots) {
+        head.prev = head.next = &head;
+      }
+    }
+  }
+
+  timer_wheel(timer_wheel&&) = delete;
+  timer_wheel(const timer_wheel&) = delete;
+  auto operator=(timer_wheel&&) -> timer_wheel& = delete;
+  auto operator=(const timer_wheel&) -> timer_wheel& = delete;
+
+  /**
+   * @brief Drop the timers pending, destroy the wheel after the tasks sleeping on it.
+   */
+  ~timer_wheel() {
+    for (auto& level : _levels) {
+      for (auto& head : level.slots) {
+        while (head.next != &head) {
+          _unlink(static_cast<detail::wheel_entry*>(head.next));
+        }
+      }
+    }
+  }
+
+  auto tick() const -> clock::duration { return _tick; }
+
+  /**
+   * @brief Number of timers pending.
+   */
+  auto size() const -> std::size_t { return _size; }
+
+  /**
+   * @brief Suspend the awaiting coroutine until the deadline.
+   */
+  auto sleep_until(clock::time_point deadline) {
+    class awaiter : detail::wheel_entry {
+     public:
+      awaiter(timer_wheel* wheel, clock::time_point deadline)
+          : _wheel(wheel), _deadline(deadline) {}
+
+      // only moved before it is awaited, while it is not linked into the wheel
+      awaiter(awaiter&& other) noexcept : _wheel(other._wheel), _deadline(other._deadline) {}
+
+      awaiter(const awaiter&) = delete;
+      auto operator=(awaiter&&) -> awaiter& = delete;
+      auto operator=(const awaiter&) -> awaiter& = delete;
+
+      // a task destroyed while sleeping leaves the wheel
+      ~awaiter() {
+        if (pending()) {
+          _wheel->_cancel(this);
+        }
+      }
+
+      auto await_ready() const -> bool { return _deadline <= clock::now(); }
+
+      auto await_suspend(std::coroutine_handle<> handle) -> void {
+        _handle = handle;
+        fire = [](detail::wheel_entry* self) { static_cast<awaiter*>(self)->_handle.resume(); };
+        _wheel->_schedule(this, _deadline);
+      }
+
+      auto await_resume() const noexcept -> void {}
+
+     private:
+      timer_wheel* _wheel;
+      clock::time_point _deadline;
+      std::coroutine_handle<> _handle;
+    };
+    return awaiter(this, deadline);
+  }
+
+  template <typename Rep, typename Period>
+  auto sleep_for(std::chrono::duration<Rep, Period> duration) {
+    return sleep_until(clock::now() + std::chrono::duration_cast<clock::duration>(duration));
+  }
+
+  /**
+   * @brief Await t for at most timeout, give its value, or std::errc::timed_out if the time runs
+   * out first. A result returned by t is given as is.
+   *
+   * On a timeout t goes on as a detached task, e.g. until the caller closes the socket it reads:
+   * `if (auto req = co_await wheel.with_timeout(5s, read_request(socket)); !req) socket.close();`
+   */
+  template <typename Rep, typename Period, typename T>
+  auto with_timeout(std::chrono::duration<Rep, Period> timeout, task<T> t)
+      -> task<result<typename detail::timeout_value<T>::type>>;
+
+ private:
+  friend class wheel_timer;
+
+  struct level {
+    std::array<detail::wheel_link, slot_count> slots;
+    std::array<std::uint64_t, slot_count / 64> occupied{};  ///< Bit per non-empty slot
+  };
+
+  static constexpr auto slot_mask = slot_count - 1;
+  static constexpr auto max_delay = (std::uint64_t(1) << (slot_bits * level_count)) - 1;
+
+  // Ticks elapsed at time, rounded down, or up for a deadline so that no timer fires early
+  auto _tick_of(clock::time_point time, bool round_up = false) const -> std::uint64_t {
+    auto elapsed = time - _start;
+    if (elapsed <= clock::duration::zero()) {
+      return 0;
+    }
+    return static_cast<std::uint64_t>((round_up ? elapsed + _tick - clock::duration(1) : elapsed)
+                                      / _tick);
+  }
+
+  auto _schedule(detail::wheel_entry* entry, clock::time_point deadline) -> void {
+    if (_size == 0) {
+      // nothing to fire in between, catch up with the time at once
+      _current = std::max(_current, _tick_of(clock::now()));
+    }
+    entry->expiry = std::max(_tick_of(deadline, true), _current + 1);
+    _insert(entry);
+    ++_size;
+    if (!_armed || entry->expiry < _wakeup) {
+      _arm();
+    }
+  }
+
+  auto _cancel(detail::wheel_entry* entry) -> bool {
+    if (!entry->pending()) {
+      return false;
+    }
+    _unlink(entry);
+    if (_size == 0 && _armed) {
+      // nothing left to wait for, let the io_context run out of work
+      _timer.cancel();
+      _armed = false;
+    }
+    return true;
+  }
+
+  auto _insert(detail::wheel_entry* entry) -> void {
+    auto delay = std::min(entry->expiry - _current, max_delay);
+    // a timer cascaded at its own tick goes to the current slot, which fires next
+    auto level = static_cast<std::size_t>(std::bit_width(delay | 1) - 1) / slot_bits;
+    auto index = static_cast<std::size_t>((_current + delay) >> (slot_bits * level)) & slot_mask;
+    auto& head = _levels[level].slots[index];
+    entry->prev = head.prev;
+    entry->next = &head;
+    head.prev->next = entry;
+    head.prev = entry;
+    entry->slot = static_cast<std::uint32_t>(level * slot_count + index);
+    _levels[level].occupied[index / 64] |= std::uint64_t(1) << (index % 64);
+  }
+
+  auto _unlink(detail::wheel_entry* entry) -> void {
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->prev = entry->next = nullptr;
+    --_size;
+    if (entry->slot != detail::wheel_entry::no_slot) {
+      auto& level = _levels[entry->slot / slot_count];
+      auto index = entry->slot % slot_count;
+      if (level.slots[index].next == &level.slots[index]) {
+        level.occupied[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+      }
+    }
+  }
+
+  // Move the entries of a slot to the list of head, detached from the wheel
+  auto _take(std::size_t level, std::size_t index, detail::wheel_link& head) -> void {
+    auto& slot = _levels[level].slots[index];
+    head.prev = head.next = &head;
+    if (slot.next != &slot) {
+      head.next = slot.next;
+      head.prev = slot.prev;
+      head.next->prev = head.prev->next = &head;
+      slot.prev = slot.next = &slot;
+    }
+    _levels[level].occupied[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+    for (auto* link = head.next; link != &head; link = link->next) {
+      static_cast<detail::wheel_entry*>(link)->slot = detail::wheel_entry::no_slot;
+    }
+  }
+
+  // The lowest level has wrapped around, move the timers of the current slot of level down
+  auto _cascade(std::size_t level) -> void {
+    auto index = static_cast<std::size_t>(_current >> (slot_bits * level)) & slot_mask;
+    if (index == 0 && level + 1 < level_count) {
+      _cascade(level + 1);
+    }
+    auto head = detail::wheel_link();
+    _take(level, index, head);
+    while (head.next != &head) {
+      auto* entry = static_cast<detail::wheel_entry*>(head.next);
+      head.next = entry->next;
+      entry->next->prev = &head;
+      _insert(entry);
+    }
+  }
+
+  // Ticks from the current one to the next occupied slot of the lowest level, or to its wrap-around
+  auto _ticks_to_next() const -> std::uint64_t {
+    const auto& occupied = _levels[0].occupied;
+    auto index = static_cast<std::size_t>(_current & slot_mask);
+    for (auto word = (index + 1) / 64; word < occupied.size(); ++word) {
+      auto bits = occupied[word];
+      if (word == (index + 1) / 64) {
+        bits &= ~std::uint64_t() << ((index + 1) % 64);
+      }
+      if (bits != 0) {
+        return word * 64 + static_cast<std::size_t>(std::countr_zero(bits)) - index;
+      }
+    }
+    return slot_count - index;
+  }
+
+  auto _advance(std::uint64_t target) -> void {
+    while (_current < target && _size != 0) {
+      _current += std::min(_ticks_to_next(), target - _current);
+      auto index = static_cast<std::size_t>(_current & slot_mask);
+      if (index == 0) {
+        _cascade(1);
+      }
+      auto head = detail::wheel_link();
+      _take(0, index, head);
+      // a timer fired may cancel the others of the slot, which leave the list of head
+      while (head.next != &head) {
+        auto* entry = static_cast<detail::wheel_entry*>(head.next);
+        _unlink(entry);
+        entry->fire(entry);
+      }
+    }
+    if (_size == 0) {
+      _current = std::max(_current, target);
+    }
+  }
+
+  auto _arm() -> void {
+    _armed = true;
+    _wakeup = _current + _ticks_to_next();
+    _timer.expires_at(_start + _tick * static_cast<clock::rep>(_wakeup));
+    _timer.async_wait([this](const asio::error_code& ec) {
+      if (ec) {
+        return;  // re-armed, or the wheel is destroyed
+      }
+      _armed = false;
+      _advance(_tick_of(clock::now()));
+      if (_size != 0 && !_armed) {
+        _arm();
+      }
+    });
+  }
+
+  asio::steady_timer _timer;
+  clock::duration _tick;
+  clock::time_point _start;
+  std::uint64_t _current = 0;  ///< Last tick processed
+  std::uint64_t _wakeup = 0;   ///< Tick the steady_timer is armed for
+  bool _armed = false;
+  std::size_t _size = 0;
+  std::array<level, level_count> _levels;
+};
+
+/**
+ * @brief Timer calling a callback from a timer_wheel, cancelled when it is destroyed.
+ */
+class wheel_timer : detail::wheel_entry {
+ public:
+  using clock = timer_wheel::clock;
+
+  explicit wheel_timer(timer_wheel& wheel) : _wheel(&wheel) {}
+
+  wheel_timer(wheel_timer&&) = delete;
+  wheel_timer(const wheel_timer&) = delete;
+  auto operator=(wheel_timer&&) -> wheel_timer& = delete;
+  auto operator=(const wheel_timer&) -> wheel_timer& = delete;
+
+  ~wheel_timer() { cancel(); }
+
+  /**
+   * @brief Call callback at the deadline, instead of the callback pending if any.
+   */
+  auto start(clock::time_point deadline, std::function<void()> callback) -> void {
+    cancel();
+    _callback = std::move(callback);
+    fire = [](detail::wheel_entry* self) { static_cast<wheel_timer*>(self)->_callback(); };
+    _wheel->_schedule(this, deadline);
+  }
+
+  template <typename Rep, typename Period>
+  auto start_after(std::chrono::duration<Rep, Period> delay, std::function<void()> callback)
+      -> void {
+    start(clock::now() + std::chrono::duration_cast<clock::duration>(delay), std::move(callback));
+  }
+
+  /**
+   * @brief Cancel the callback, return false if none is pending.
+   */
+  auto cancel() -> bool { return _wheel->_cancel(this); }
+
+  auto pending() const -> bool { return wheel_entry::pending(); }
+
+ private:
+  timer_wheel* _wheel;
+  std::function<void()> _callback;
+};
+
+template <typename Rep, typename Period, typename T>
+auto timer_wheel::with_timeout(std::chrono::duration<Rep, Period> timeout, task<T> t)
+    -> task<result<typename detail::timeout_value<T>::type>> {
+  using value_type = typename detail::timeout_value<T>::type;
+  // shared with the task running t, which may outlive this one
+  struct state {
+    explicit state(timer_wheel& wheel) : timer(wheel) {}
+
+    auto finish() -> void {
+      if (waiter) {
+        std::exchange(waiter, nullptr).resume();
+      }
+    }
+
+    wheel_timer timer;
+    std::coroutine_handle<> waiter;
+    bool done = false;
+    std::optional<result<value_type>> outcome;
+    std::exception_ptr exception;
+  };
+  auto shared = std::make_shared<state>(*this);
+  shared->timer.start_after(timeout, [st = shared.get()] {
+    st->done = true;
+    st->outcome.emplace(std::make_error_code(std::errc::timed_out));
+    st->finish();
+  });
+
+  auto run = [](std::shared_ptr<state> st, task<T> t) -> task<> {
+    try {
+      if constexpr (std::is_void_v<T>) {
+        co_await std::move(t);
+        if (!st->done) {
+          st->outcome.emplace();
+        }
+      } else {
+        auto value = co_await std::move(t);
+        if (!st->done) {
+          st->outcome.emplace(std::move(value));
+        }
+      }
+    } catch (...) {
+      if (!st->done) {
+        st->exception = std::current_exception();
+      }
+    }
+    if (!st->done) {
+      st->done = true;
+      st->timer.cancel();
+      st->finish();
+    }
+  };
+  run(shared, std::move(t)).detach();
+
+  struct awaiter {
+    state* st;
+
+    // this task destroyed while waiting must not be resumed by the timer or by t finishing
+    ~awaiter() {
+      if (st->waiter) {
+        st->waiter = nullptr;
+        st->timer.cancel();
+      }
+    }
+
+    auto await_ready() const noexcept -> bool { return st->done; }
+
+    auto await_suspend(std::coroutine_handle<> handle) const noexcept -> void {
+      st->waiter = handle;
+    }
+
+    auto await_resume() const noexcept -> void {}
+  };
+  co_await awaiter{shared.get()};
+  if (shared->exception) {
+    std::rethrow_exception(shared->exception);
+  }
+  co_return std::move(*shared->outcome);
+}
+
+}  // namespace ascpp
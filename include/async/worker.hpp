@@ -1 +1,792 @@
 #pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(_WIN32) || defined(_WIN64)
+// std::max below, and logger::level::ERROR in the users of ascpp.hpp, must not meet the macros
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef NOGDI
+#define NOGDI
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "asio/executor_work_guard.hpp"
+#include "asio/io_context.hpp"
+#include "asio/post.hpp"
+
+#include "async/io_executor.hpp"
+
+namespace ascpp {
+
+class thread_pool;
+
+namespace detail {
+
+/**
+ * @brief Type-erased job of a thread_pool, run once and deleted by itself.
+ */
+class pool_job {
+ public:
+  pool_job() = default;
+  pool_job(pool_job&&) = delete;
+  pool_job(const pool_job&) = delete;
+  auto operator=(pool_job&&) -> pool_job& = delete;
+  auto operator=(const pool_job&) -> pool_job& = delete;
+  virtual ~pool_job() = default;
+
+  virtual auto run() noexcept -> void = 0;
+};
+
+template <typename F>
+class pool_job_impl final : public pool_job {
+ public:
+  explicit pool_job_impl(F fn) : _fn(std::move(fn)) {}
+
+  // A job submitted alone has nobody to report an exception to, it terminates like std::thread
+  auto run() noexcept -> void override {
+    auto self = std::unique_ptr<pool_job_impl>(this);
+    std::invoke(_fn);
+  }
+
+ private:
+  F _fn;
+};
+
+template <typename F>
+auto make_pool_job(F&& fn) -> pool_job* {
+  return new pool_job_impl<std::decay_t<F>>(std::forward<F>(fn));
+}
+
+/**
+ * @brief Chase-Lev work-stealing deque of jobs.
+ *
+ * The owner thread pushes and pops at the bottom like a stack, so it runs the jobs it has just
+ * spawned while their data is still in its cache. Thieves take the oldest jobs from the top, which
+ * are usually the largest pieces of a divided work. Only a pop racing for the last job and the
+ * thieves with each other synchronize by CAS. The ring grows when it is full, the old rings are
+ * kept until the deque is destroyed since a thief may still be reading one.
+ */
+class work_deque {
+ public:
+  explicit work_deque(std::size_t capacity = 256) {
+    _rings.push_back(std::make_unique<ring>(std::bit_ceil(capacity)));
+    _ring.store(_rings.back().get(), std::memory_order_relaxed);
+  }
+
+  /// Owner: push a job at the bottom
+  auto push(pool_job* job) -> void {
+    auto bottom = _bottom.load(std::memory_order_relaxed);
+    auto top = _top.load(std::memory_order_acquire);
+    auto* buf = _ring.load(std::memory_order_relaxed);
+    if (bottom - top >= static_cast<std::int64_t>(buf->size())) [[unlikely]] {
+      buf = _grow(buf, top, bottom);
+    }
+    buf->store(bottom, job);
+    _bottom.store(bottom + 1, std::memory_order_release);
+  }
+
+  /// Owner: pop the job pushed last, nullptr if there is none
+  auto pop() -> pool_job* {
+    auto bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    auto* buf = _ring.load(std::memory_order_relaxed);
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top = _top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    auto* job = buf->load(bottom);
+    if (top == bottom) {
+      // the last job, race with the thieves for it
+      if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        job = nullptr;
+      }
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+  }
+
+  /// Thief: take the oldest job, nullptr if there is none or another thread has taken it
+  auto steal() -> pool_job* {
+    auto top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto bottom = _bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return nullptr;
+    }
+    auto* job = _ring.load(std::memory_order_acquire)->load(top);
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return job;
+  }
+
+  /// Approximate number of jobs, exact for the owner
+  auto size() const -> std::size_t {
+    auto bottom = _bottom.load(std::memory_order_relaxed);
+    auto top = _top.load(std::memory_order_relaxed);
+    return bottom > top ? static_cast<std::size_t>(bottom - top) : 0;
+  }
+
+ private:
+  class ring {
+   public:
+    explicit ring(std::size_t size)
+        : _mask(size - 1), _slots(std::make_unique<std::atomic<pool_job*>[]>(size)) {}
+
+    auto size() const -> std::size_t { return _mask + 1; }
+
+    auto load(std::int64_t index) const -> pool_job* {
+      return _slots[static_cast<std::size_t>(index) & _mask].load(std::memory_order_relaxed);
+    }
+
+    auto store(std::int64_t index, pool_job* job) -> void {
+      _slots[static_cast<std::size_t>(index) & _mask].store(job, std::memory_order_relaxed);
+    }
+
+   private:
+    std::size_t _mask;
+    std::unique_ptr<std::atomic<pool_job*>[]> _slots;
+  };
+
+  auto _grow(ring* old, std::int64_t top, std::int64_t bottom) -> ring* {
+    _rings.push_back(std::make_unique<ring>(old->size() * 2));
+    auto* buf = _rings.back().get();
+    for (auto i = top; i < bottom; ++i) {
+      buf->store(i, old->load(i));
+    }
+    _ring.store(buf, std::memory_order_release);
+    return buf;
+  }
+
+  static constexpr auto cache_line = 64UZ;
+
+  alignas(cache_line) std::atomic<std::int64_t> _top = 0;
+  alignas(cache_line) std::atomic<std::int64_t> _bottom = 0;
+  std::atomic<ring*> _ring;
+  std::vector<std::unique_ptr<ring>> _rings;  ///< Owned by the owner thread, the last is current
+};
+
+struct pool_worker {
+  thread_pool* pool;
+  std::size_t index;
+  work_deque deque;
+  std::uint64_t rand_state;  ///< For choosing the victims to steal from
+};
+
+// Worker of the current thread, trivial so that accessing it needs no guard
+inline constinit thread_local pool_worker* current_pool_worker = nullptr;
+
+/**
+ * @brief Bounded single-producer single-consumer queue.
+ *
+ * The producer and the consumer each own an index on its own cache line and keep a cached copy of
+ * the other's, so they touch each other's line only when the queue looks full or empty.
+ */
+template <typename T>
+class spsc_queue {
+ public:
+  explicit spsc_queue(std::size_t capacity)
+      : _mask(std::bit_ceil(capacity) - 1), _slots(std::make_unique<T[]>(_mask + 1)) {}
+
+  auto capacity() const -> std::size_t { return _mask + 1; }
+
+  /// Producer: push value, false if the queue is full
+  auto try_push(T value) -> bool {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head_cache > _mask) {
+      _head_cache = _head.load(std::memory_order_acquire);
+      if (tail - _head_cache > _mask) {
+        return false;
+      }
+    }
+    _slots[tail & _mask] = std::move(value);
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Consumer: pop the oldest value, std::nullopt if the queue is empty
+  auto try_pop() -> std::optional<T> {
+    auto head = _head.load(std::memory_order_relaxed);
+    if (head == _tail_cache) {
+      _tail_cache = _tail.load(std::memory_order_acquire);
+      if (head == _tail_cache) {
+        return std::nullopt;
+      }
+    }
+    auto value = std::move(_slots[head & _mask]);
+    _head.store(head + 1, std::memory_order_release);
+    return value;
+  }
+
+ private:
+  static constexpr auto cache_line = 64UZ;
+
+  std::size_t _mask;
+  std::unique_ptr<T[]> _slots;
+  alignas(cache_line) std::atomic<std::size_t> _head = 0;
+  std::size_t _tail_cache = 0;  ///< Of the consumer
+  alignas(cache_line) std::atomic<std::size_t> _tail = 0;
+  std::size_t _head_cache = 0;  ///< Of the producer
+};
+
+/**
+ * @brief Get the CPUs the process may run on, empty if they are unknown.
+ */
+inline auto allowed_cpus() -> std::vector<int> {
+  auto cpus = std::vector<int>();
+#if defined(_WIN32) || defined(_WIN64)
+  auto process = DWORD_PTR();
+  auto system = DWORD_PTR();
+  if (::GetProcessAffinityMask(::GetCurrentProcess(), &process, &system) != 0) {
+    for (auto cpu = 0; cpu < static_cast<int>(sizeof(process) * 8); ++cpu) {
+      if ((process >> cpu & 1) != 0) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#elif defined(__linux__)
+  auto set = cpu_set_t();
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (auto cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+/**
+ * @brief Pin the current thread to cpu, return false if it is not supported or fails.
+ */
+inline auto pin_current_thread(int cpu) -> bool {
+#if defined(_WIN32) || defined(_WIN64)
+  return ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+  auto set = cpu_set_t();
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+class core_state;
+
+// Core of the current thread, see current_pool_worker
+inline constinit thread_local core_state* current_core = nullptr;
+
+/// Value of a when_all() branch, std::monostate for the branches returning void
+template <typename F>
+using when_all_value_t = std::conditional_t<std::is_void_v<std::invoke_result_t<F&>>,
+                                            std::monostate,
+                                            std::invoke_result_t<F&>>;
+
+}  // namespace detail
+
+/**
+ * @brief Work-stealing thread pool.
+ *
+ * Each worker has its own deque: the jobs submitted by a worker are pushed to its deque without
+ * contention, and an idle worker steals from the others. Jobs submitted by other threads go to a
+ * global injection queue. Idle workers park on an atomic wait, i.e. a futex on Linux, and are woken
+ * only when there are sleepers, so submitting to a busy pool costs no system call.
+ */
+class thread_pool {
+ public:
+  /**
+   * @brief Start threads workers, or one per hardware thread if it is 0.
+   */
+  explicit thread_pool(std::size_t threads = 0) {
+    if (threads == 0) {
+      threads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    _workers.reserve(threads);
+    for (auto i = 0UZ; i < threads; ++i) {
+      _workers.emplace_back(new detail::pool_worker{
+          this, i, detail::work_deque(), 0x9e3779b97f4a7c15ULL * (i + 1)});
+    }
+    _threads.reserve(threads);
+    for (auto i = 0UZ; i < threads; ++i) {
+      _threads.emplace_back([this, i] { _run(*_workers[i]); });
+    }
+  }
+
+  thread_pool(thread_pool&&) = delete;
+  thread_pool(const thread_pool&) = delete;
+  auto operator=(thread_pool&&) -> thread_pool& = delete;
+  auto operator=(const thread_pool&) -> thread_pool& = delete;
+
+  /**
+   * @brief Run the jobs left, including the ones they submit, and join the workers.
+   */
+  ~thread_pool() {
+    _stopping.store(true, std::memory_order_seq_cst);
+    _wake.fetch_add(1, std::memory_order_seq_cst);
+    _wake.notify_all();
+    _threads.clear();
+  }
+
+  auto size() const -> std::size_t { return _workers.size(); }
+
+  /**
+   * @brief Test if the current thread is a worker of this pool.
+   */
+  auto in_pool() const -> bool {
+    return detail::current_pool_worker != nullptr && detail::current_pool_worker->pool == this;
+  }
+
+  /**
+   * @brief Run fn on a worker. The program terminates if fn throws, use when_all() to get the
+   * exceptions.
+   */
+  template <typename F>
+    requires std::invocable<std::decay_t<F>&>
+  auto submit(F&& fn) -> void {
+    _push(detail::make_pool_job(std::forward<F>(fn)));
+    _notify(1);
+  }
+
+  /**
+   * @brief Run fn(i) for each i in [0, count) on the workers.
+   *
+   * A single job is submitted for the whole range, a worker running it splits off the upper half
+   * into its deque for the others to steal, recursively, so the range spreads over the idle
+   * workers in a logarithmic number of steps without the submitter pushing count jobs.
+   */
+  template <typename F>
+    requires std::invocable<F&, std::size_t>
+  auto bulk_submit(std::size_t count, F fn) -> void {
+    if (count == 0) {
+      return;
+    }
+    _push(_make_range_job(std::make_shared<F>(std::move(fn)), 0, count));
+    _notify(1);
+  }
+
+  /**
+   * @brief Run the callables in parallel and return their results when all are done, the ones
+   * returning void yield std::monostate.
+   *
+   * The first one runs on the calling thread. A worker calling when_all() runs other jobs while
+   * waiting, so the branches may themselves call when_all() to divide the work further. If any
+   * branch throws, the first exception is rethrown after all the branches are done.
+   */
+  template <typename... F>
+    requires(std::invocable<F&> && ...)
+  auto when_all(F&&... fns) -> std::tuple<detail::when_all_value_t<F>...> {
+    auto values = std::tuple<std::optional<detail::when_all_value_t<F>>...>();
+    auto pending = std::atomic<std::size_t>(sizeof...(F));
+    auto error = std::exception_ptr();
+    auto error_flag = std::atomic_flag();
+    auto branches = std::forward_as_tuple(std::forward<F>(fns)...);
+
+    auto run_branch = [&]<std::size_t I>(std::integral_constant<std::size_t, I>) {
+      try {
+        auto& fn = std::get<I>(branches);
+        if constexpr (std::is_void_v<std::invoke_result_t<decltype(fn)>>) {
+          std::invoke(fn);
+          std::get<I>(values).emplace();
+        } else {
+          std::get<I>(values).emplace(std::invoke(fn));
+        }
+      } catch (...) {
+        if (!error_flag.test_and_set()) {
+          error = std::current_exception();
+        }
+      }
+      if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pending.notify_all();
+      }
+    };
+
+    // the queued branches refer to the locals above, so every job is allocated before any is
+    // queued, and if queuing one throws the others already queued are waited for before unwinding
+    auto jobs = std::array<std::unique_ptr<detail::pool_job>, sizeof...(F) - 1>();
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      ((jobs[I].reset(detail::make_pool_job([&run_branch] {
+         run_branch(std::integral_constant<std::size_t, I + 1>());
+       }))),
+       ...);
+    }(std::make_index_sequence<sizeof...(F) - 1>());
+    for (auto i = 0UZ; i < jobs.size(); ++i) {
+      try {
+        _push(jobs[i].get());
+      } catch (...) {
+        // neither the first branch nor the ones left in jobs will run
+        pending.fetch_sub(jobs.size() - i + 1, std::memory_order_acq_rel);
+        _notify(i);
+        _wait(pending);
+        throw;
+      }
+      (void)jobs[i].release();
+    }
+    _notify(jobs.size());
+    run_branch(std::integral_constant<std::size_t, 0>());
+
+    _wait(pending);
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return std::apply([](auto&... value) { return std::tuple(std::move(*value)...); }, values);
+  }
+
+ private:
+  template <typename F>
+  auto _make_range_job(std::shared_ptr<F> fn, std::size_t begin, std::size_t end)
+      -> detail::pool_job* {
+    return detail::make_pool_job([this, fn = std::move(fn), begin, end] {
+      auto last = end;
+      while (last - begin > 1) {
+        auto mid = begin + (last - begin) / 2;
+        _push(_make_range_job(fn, mid, last));
+        _notify(1);
+        last = mid;
+      }
+      std::invoke(*fn, begin);
+    });
+  }
+
+  auto _push(detail::pool_job* job) -> void {
+    if (in_pool()) {
+      detail::current_pool_worker->deque.push(job);
+      return;
+    }
+    auto lock = std::lock_guard(_inject_mutex);
+    _injected.push_back(job);
+    _injected_size.store(_injected.size(), std::memory_order_release);
+  }
+
+  auto _notify(std::size_t count) -> void {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (count == 0 || _sleepers.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+    _wake.fetch_add(1, std::memory_order_release);
+    if (count == 1) {
+      _wake.notify_one();
+    } else {
+      _wake.notify_all();
+    }
+  }
+
+  auto _pop_injected() -> detail::pool_job* {
+    if (_injected_size.load(std::memory_order_acquire) == 0) {
+      return nullptr;
+    }
+    auto lock = std::lock_guard(_inject_mutex);
+    if (_injected.empty()) {
+      return nullptr;
+    }
+    auto* job = _injected.front();
+    _injected.pop_front();
+    _injected_size.store(_injected.size(), std::memory_order_release);
+    return job;
+  }
+
+  // Find a job for worker: its own deque first, then the injection queue, then the others' deques
+  // starting from a random one
+  auto _find(detail::pool_worker& worker) -> detail::pool_job* {
+    if (auto* job = worker.deque.pop()) {
+      return job;
+    }
+    if (auto* job = _pop_injected()) {
+      return job;
+    }
+    // xorshift64
+    worker.rand_state ^= worker.rand_state << 13;
+    worker.rand_state ^= worker.rand_state >> 7;
+    worker.rand_state ^= worker.rand_state << 17;
+    auto count = _workers.size();
+    auto start = static_cast<std::size_t>(worker.rand_state % count);
+    for (auto i = 0UZ; i < count; ++i) {
+      auto& victim = *_workers[(start + i) % count];
+      if (&victim != &worker) {
+        if (auto* job = victim.deque.steal()) {
+          return job;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  auto _run(detail::pool_worker& worker) -> void {
+    detail::current_pool_worker = &worker;
+    constexpr auto spin_count = 64;
+    while (true) {
+      auto* job = static_cast<detail::pool_job*>(nullptr);
+      for (auto i = 0; i < spin_count && job == nullptr; ++i) {
+        job = _find(worker);
+      }
+      if (job == nullptr) {
+        if (_stopping.load(std::memory_order_acquire)) {
+          break;
+        }
+        auto epoch = _wake.load(std::memory_order_acquire);
+        _sleepers.fetch_add(1, std::memory_order_relaxed);
+        // pairs with the fence of _notify(): either the job is found here, or the sleeper is seen
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        job = _find(worker);
+        if (job == nullptr && !_stopping.load(std::memory_order_relaxed)) {
+          _wake.wait(epoch, std::memory_order_acquire);
+        }
+        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+        if (job == nullptr) {
+          continue;
+        }
+      }
+      job->run();
+    }
+    detail::current_pool_worker = nullptr;
+  }
+
+  // Wait until pending is 0, running other jobs meanwhile on a worker
+  auto _wait(std::atomic<std::size_t>& pending) -> void {
+    while (true) {
+      auto value = pending.load(std::memory_order_acquire);
+      if (value == 0) {
+        return;
+      }
+      if (in_pool()) {
+        if (auto* job = _find(*detail::current_pool_worker)) {
+          job->run();
+          continue;
+        }
+      }
+      // the jobs left are running on other threads
+      pending.wait(value, std::memory_order_acquire);
+    }
+  }
+
+  std::vector<std::unique_ptr<detail::pool_worker>> _workers;
+  std::mutex _inject_mutex;
+  std::deque<detail::pool_job*> _injected;
+  std::atomic<std::size_t> _injected_size = 0;
+  alignas(64) std::atomic<std::uint32_t> _wake = 0;  ///< Bumped to wake the parked workers
+  std::atomic<std::uint32_t> _sleepers = 0;
+  std::atomic<bool> _stopping = false;
+  std::vector<std::jthread> _threads;  ///< Declared last, joined first
+};
+
+class thread_per_core;
+
+namespace detail {
+
+/**
+ * @brief State of a core of a thread_per_core, allocated by the thread of the core after it is
+ * pinned, so that it sits in the memory of the NUMA node of the core under the first-touch policy.
+ */
+class core_state {
+ public:
+  core_state(thread_per_core* owner, std::size_t index, int cpu, std::size_t cores,
+             std::size_t queue_capacity)
+      : owner(owner), index(index), cpu(cpu) {
+    inbound.reserve(cores);
+    for (auto i = 0UZ; i < cores; ++i) {
+      inbound.push_back(std::make_unique<spsc_queue<pool_job*>>(queue_capacity));
+    }
+  }
+
+  thread_per_core* owner;
+  std::size_t index;
+  int cpu;  ///< -1 if the thread is not pinned
+  asio::io_context ctx{1};
+  asio::executor_work_guard<asio::io_context::executor_type> guard = asio::make_work_guard(ctx);
+  std::vector<std::unique_ptr<spsc_queue<pool_job*>>> inbound;  ///< Indexed by the sender
+  std::atomic<bool> drain_posted = false;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Thread-per-core runtime: one asio::io_context per core, run by a thread pinned to it.
+ *
+ * Unlike thread_pool nothing is shared or stolen, a service keeps the state of a key on the core
+ * that core_of() gives for the key and routes the work on the key there, so the state is only ever
+ * touched by one thread and stays in the cache and the NUMA node of its core. A core sends to
+ * another through a SPSC queue of its own for that core, so the cores never contend on a lock;
+ * other threads post to the io_context of the core. The jobs run in the order they are sent from
+ * a thread to a core, except for the ones sent while the queue is full, which go through the
+ * io_context as well.
+ */
+class thread_per_core {
+ public:
+  /**
+   * @brief Start cores threads, or one per CPU the process may run on if it is 0, each pinned to
+   * one of these CPUs in turn, with SPSC queues of queue_capacity jobs between the cores.
+   */
+  explicit thread_per_core(std::size_t cores = 0, std::size_t queue_capacity = 256) {
+    auto cpus = detail::allowed_cpus();
+    if (cores == 0) {
+      cores = cpus.empty() ? std::max(std::thread::hardware_concurrency(), 1U) : cpus.size();
+    }
+    _cores.resize(cores);
+    _threads.reserve(cores);
+    for (auto i = 0UZ; i < cores; ++i) {
+      auto cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+      _threads.emplace_back([this, i, cpu, cores, queue_capacity] {
+        auto pinned = cpu >= 0 && detail::pin_current_thread(cpu);
+        _cores[i] = std::make_unique<detail::core_state>(this, i, pinned ? cpu : -1, cores,
+                                                         queue_capacity);
+        auto& core = *_cores[i];
+        detail::current_core = &core;
+        _started.fetch_add(1, std::memory_order_release);
+        _started.notify_one();
+        core.ctx.run();
+        detail::current_core = nullptr;
+      });
+    }
+    // the cores are only reached through the runtime once all of them are allocated
+    for (auto n = _started.load(std::memory_order_acquire); n < cores;
+         n = _started.load(std::memory_order_acquire)) {
+      _started.wait(n, std::memory_order_acquire);
+    }
+  }
+
+  thread_per_core(thread_per_core&&) = delete;
+  thread_per_core(const thread_per_core&) = delete;
+  auto operator=(thread_per_core&&) -> thread_per_core& = delete;
+  auto operator=(const thread_per_core&) -> thread_per_core& = delete;
+
+  /**
+   * @brief Stop the cores and join their threads, the jobs not run yet are dropped.
+   */
+  ~thread_per_core() {
+    for (auto& core : _cores) {
+      core->ctx.stop();
+    }
+    _threads.clear();
+    for (auto& core : _cores) {
+      for (auto& queue : core->inbound) {
+        while (auto job = queue->try_pop()) {
+          delete *job;
+        }
+      }
+    }
+  }
+
+  auto size() const -> std::size_t { return _cores.size(); }
+
+  auto context(std::size_t core) -> asio::io_context& { return _cores[core]->ctx; }
+
+  auto executor(std::size_t core) -> io_executor { return io_executor(_cores[core]->ctx); }
+
+  /**
+   * @brief Get the CPU the core is pinned to, -1 if it is not pinned.
+   */
+  auto cpu(std::size_t core) const -> int { return _cores[core]->cpu; }
+
+  /**
+   * @brief Get the core of the current thread, std::nullopt if it is not a core of this runtime.
+   */
+  auto current_core() const -> std::optional<std::size_t> {
+    if (detail::current_core == nullptr || detail::current_core->owner != this) {
+      return std::nullopt;
+    }
+    return detail::current_core->index;
+  }
+
+  /**
+   * @brief Get the core owning key, the same for a key during the lifetime of the runtime.
+   */
+  template <typename Key>
+  auto core_of(const Key& key) const -> std::size_t {
+    // std::hash of an integer is the identity, mix it so that strided keys spread over the cores
+    auto hash = static_cast<std::uint64_t>(std::hash<Key>()(key)) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<std::size_t>((hash ^ hash >> 32) % _cores.size());
+  }
+
+  /**
+   * @brief Run fn on the thread of core. The program terminates if fn throws.
+   */
+  template <typename F>
+    requires std::invocable<std::decay_t<F>&>
+  auto post(std::size_t core, F&& fn) -> void {
+    auto& target = *_cores[core];
+    auto* from = detail::current_core;
+    if (from == nullptr || from->owner != this || from == &target) {
+      asio::post(target.ctx, std::forward<F>(fn));
+      return;
+    }
+    auto* job = detail::make_pool_job(std::forward<F>(fn));
+    if (!target.inbound[from->index]->try_push(job)) [[unlikely]] {
+      asio::post(target.ctx, [job = std::unique_ptr<detail::pool_job>(job)]() mutable {
+        job.release()->run();
+      });
+      return;
+    }
+    // pairs with the exchange of _drain(): either the drain posted sees the job, or it is posted
+    if (!target.drain_posted.exchange(true, std::memory_order_acq_rel)) {
+      asio::post(target.ctx, [&target] { _drain(target); });
+    }
+  }
+
+  /**
+   * @brief Run fn on the core owning key.
+   */
+  template <typename Key, typename F>
+    requires std::invocable<std::decay_t<F>&>
+  auto route(const Key& key, F&& fn) -> void {
+    post(core_of(key), std::forward<F>(fn));
+  }
+
+ private:
+  // Run the jobs the other cores have sent, at most a queue full from each so that a busy sender
+  // does not starve the handlers of the io_context
+  static auto _drain(detail::core_state& core) -> void {
+    core.drain_posted.exchange(false, std::memory_order_acq_rel);
+    auto more = false;
+    for (auto& queue : core.inbound) {
+      for (auto n = queue->capacity(); n > 0; --n) {
+        auto job = queue->try_pop();
+        if (!job) {
+          break;
+        }
+        (*job)->run();
+        more = more || n == 1;
+      }
+    }
+    if (more && !core.drain_posted.exchange(true, std::memory_order_acq_rel)) {
+      asio::post(core.ctx, [&core] { _drain(core); });
+    }
+  }
+
+  std::vector<std::unique_ptr<detail::core_state>> _cores;
+  std::atomic<std::uint32_t> _started = 0;  ///< Cores allocated
+  std::vector<std::jthread> _threads;  ///< Declared last, joined first
+};
+
+}  // namespace ascpp
@@ -1,106 +1,416 @@
 #pragma once
 
-#include <chrono>
-#include <filesystem>
-#include <fstream>
-#include <ios>
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
-#include <ostream>
-#include <shared_mutex>
+#include <span>
+#include <stdexcept>
 #include <string>
-#include <system_error>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "nlohmann/json.hpp"
 
-#include "app/info.hpp"
-#include "nlohmann/json_fwd.hpp"
+#include "storage/config_schema.hpp"
+#include "storage/config_tree.hpp"
 #include "utils/error.hpp"
-#include "utils/misc.hpp"
-#include "utils/system.hpp"
 
 namespace ascpp {
 
-/*
-class Config {
-public:
-enum ConfigType { kUserConfig = 1, kMachineConfig };
+template <typename T>
+class config_key;
 
-// TODO: Notify confliction, modified obverser
-enum SyncOption { kForceRead = 1, kForceWrite };
+namespace detail {
 
-auto Init(const app_info& app_info, ConfigType cfg_type) -> result<void> {
-  auto config_dir = TRY_UNWRAP(get_config_dir()) / app_info.org_name();
-  auto config_file = app_info.app_name() + (cfg_type == kUserConfig ? "_user" : "_machine");
-  config_path_ = config_dir / config_file;
-  config_path_.replace_extension(".json");
-  TRY_UNWRAP(create_file_path(config_path_));
-  TRY_UNWRAP(ReadConfigFromSystem());
+/**
+ * @brief Paths changed by a JSON patch, an operation on a path changes the whole subtree of it.
+ */
+inline auto json_patch_paths(const nlohmann::json& patch)
+    -> std::vector<nlohmann::json::json_pointer> {
+  auto paths = std::vector<nlohmann::json::json_pointer>();
+  for (const auto& op : patch) {
+    const auto& name = op.at("op").get_ref<const std::string&>();
+    if (name == "test") {
+      continue;
+    }
+    if (name == "move") {
+      paths.emplace_back(op.at("from").get<std::string>());
+    }
+    paths.emplace_back(op.at("path").get<std::string>());
+  }
+  return paths;
+}
 
-  return {};
+/**
+ * @brief Append the paths changed by merging patch into target, in the order of RFC 7396, walking
+ * only the members of the patch. A member set to the value it has already is not changed.
+ */
+inline auto merge_patch_paths(const nlohmann::json& patch,
+                              const config_node& target,
+                              nlohmann::json::json_pointer& path,
+                              std::vector<nlohmann::json::json_pointer>& paths) -> void {
+  if (!patch.is_object()) {
+    if (!(target == patch)) {
+      paths.push_back(path);
+    }
+    return;
+  }
+  if (!target.is_object()) {
+    // the target is turned into an object and merged
+    paths.push_back(path);
+    return;
+  }
+  for (const auto& [key, value] : patch.items()) {
+    const auto* member = target.find(key);
+    if (value.is_null() && member == nullptr) {
+      continue;
+    }
+    path.push_back(key);
+    if (value.is_null() || member == nullptr) {
+      paths.push_back(path);
+    } else {
+      merge_patch_paths(value, *member, path, paths);
+    }
+    path.pop_back();
+  }
 }
 
-Config() = default;
+}  // namespace detail
+
+/**
+ * @brief Concurrent configuration store.
+ *
+ * Readers get an immutable snapshot of the whole configuration by an atomic load of a shared_ptr,
+ * RCU style: a read never waits for a writer, and a snapshot stays valid and unchanged however the
+ * store is modified afterwards. Writers are serialized with each other, each one builds a new
+ * snapshot and publishes it. A snapshot is a config_node tree: patch() and merge_patch() copy only
+ * the nodes on the paths they change and share the rest of the tree with the previous snapshot, so
+ * their cost is proportional to the size of the patch, not of the configuration.
+ *
+ * Load the snapshot once per unit of work (e.g. a request) and read from it, rather than loading
+ * it for every key.
+ *
+ * With a schema set, each snapshot is validated before it is published, an invalid one is rejected
+ * and the current snapshot stays. So the readers can rely on the schema without checking the values
+ * themselves, and validation costs once per publication, not per read. A patch is validated only
+ * by the rules on the paths it changes.
+ */
+class config {
+ public:
+  using snapshot = config_node::ptr;
+  using changes = std::span<const nlohmann::json::json_pointer>;
+  using observer = std::function<void(const snapshot&)>;
+  /// Called with the paths changed by the publication, the root path if it is replaced as a whole
+  using change_observer = std::function<void(const snapshot&, changes)>;
+  /// Called with the paths changed and the version of the publication as well
+  using version_observer = std::function<void(const snapshot&, changes, std::uint64_t)>;
+
+  config() : config(nlohmann::json::object()) {}
+
+  explicit config(const nlohmann::json& data) : _data(config_node::make(data)) {}
+
+  config(config&&) = delete;
+  config(const config&) = delete;
+  auto operator=(config&&) -> config& = delete;
+  auto operator=(const config&) -> config& = delete;
+  ~config() = default;
 
-~Config() = default;
+  /**
+   * @brief Get the current snapshot.
+   */
+  auto get() const -> snapshot { return _data.load(std::memory_order_acquire); }
 
-auto ReadConfigFromSystem() -> result<int> {
-  std::unique_lock lock{mutex_};
-  std::error_code errc{};
+  /**
+   * @brief Number of snapshots published since construction, increased after each publication.
+   */
+  auto version() const -> std::uint64_t { return _version.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Get a handle of the value at the JSON pointer, converted to T.
+   *
+   * @throw std::logic_error if pointer is not a valid JSON pointer, e.g. "/server/port"
+   */
+  template <typename T>
+  auto bind(std::string_view pointer) const -> config_key<T> {
+    try {
+      return config_key<T>(*this, nlohmann::json::json_pointer(std::string(pointer)));
+    } catch (const nlohmann::json::parse_error& e) {
+      throw std::logic_error(std::format("invalid config key '{}': {}", pointer, e.what()));
+    }
+  }
+
+  /**
+   * @brief Validate the configurations published from now on by the schema, fail without setting
+   * it if the current snapshot is invalid.
+   */
+  auto set_schema(const config_schema& schema) -> result<void> {
+    auto validator = schema.compile();
+    auto lock = std::lock_guard(_write_mutex);
+    TRY_CHECK(validator.validate(*_data.load(std::memory_order_relaxed)));
+    _validator = std::move(validator);
+    return {};
+  }
+
+  /**
+   * @brief Validate data by the schema, without publishing it.
+   */
+  auto validate(const nlohmann::json& data) const -> result<void> {
+    auto lock = std::lock_guard(_write_mutex);
+    return _validator.validate(data);
+  }
+
+  /**
+   * @brief Replace the whole configuration, return the new version, or the error of the schema
+   * validation.
+   */
+  auto publish(const nlohmann::json& data) -> result<std::uint64_t> {
+    auto lock = std::unique_lock(_write_mutex);
+    TRY_CHECK(_validator.validate(data));
+    return _publish(lock, config_node::make(data));
+  }
+
+  /**
+   * @brief Register fn to be called with each snapshot published from now on, return its id.
+   *
+   * Observers are called in the order of publication, by the publishing thread or by the thread
+   * still calling them for an earlier publication, and without any lock of the config held, so
+   * they may read, write, subscribe and unsubscribe. A publication made by an observer is delivered
+   * to all of them once the current one is. An exception thrown by an observer propagates out of
+   * the write calling it, the publications left are delivered by the next write.
+   */
+  auto subscribe(observer fn) -> std::uint64_t {
+    return subscribe(version_observer(
+        [fn = std::move(fn)](const snapshot& data, changes /*paths*/,
+                             std::uint64_t /*version*/) { fn(data); }));
+  }
+
+  auto subscribe(change_observer fn) -> std::uint64_t {
+    return subscribe(version_observer(
+        [fn = std::move(fn)](const snapshot& data, changes paths, std::uint64_t /*version*/) {
+          fn(data, paths);
+        }));
+  }
 
-  auto last_write_timestamp = std::filesystem::last_write_time(config_path_, errc);
-  if (errc) {
-    return errc;
+  auto subscribe(version_observer fn) -> std::uint64_t {
+    auto lock = std::lock_guard(_observer_mutex);
+    _observers.emplace_back(++_last_observer_id,
+                            std::make_shared<const version_observer>(std::move(fn)));
+    return _last_observer_id;
   }
-  if (last_write_timestamp > last_sync_timestamp_) {
-    std::ifstream in{config_path_};
-    std::cerr << __LINE__ << ":" << in.good();
-    if (in) {
-      last_sync_timestamp_ = last_write_timestamp;
+
+  /**
+   * @brief Stop calling the observer, wait for its call running on another thread if any.
+   */
+  auto unsubscribe(std::uint64_t id) -> void {
+    auto lock = std::unique_lock(_observer_mutex);
+    std::erase_if(_observers, [id](const auto& item) { return item.first == id; });
+    _observer_done.wait(
+        lock, [&] { return _calling != id || _deliverer == std::this_thread::get_id(); });
+  }
+
+  /**
+   * @brief Modify a copy of the current snapshot by fn and publish it, return the new version, or
+   * the error of the schema validation.
+   *
+   * Nothing is published if fn throws or the result is invalid. The snapshot is converted to a DOM
+   * for fn and back as a whole, use patch() or merge_patch() for small changes of a large config.
+   */
+  template <typename F>
+    requires std::invocable<F&, nlohmann::json&>
+  auto update(F&& fn) -> result<std::uint64_t> {
+    auto lock = std::unique_lock(_write_mutex);
+    auto data = _data.load(std::memory_order_relaxed)->to_json();
+    std::invoke(fn, data);
+    TRY_CHECK(_validator.validate(data));
+    return _publish(lock, config_node::make(data));
+  }
+
+  /**
+   * @brief Apply a JSON patch (RFC 6902) to a copy of the current snapshot and publish it, return
+   * the new version, or config_patch_failed or the error of the schema validation.
+   *
+   * The patch is applied atomically: if any operation fails, including a "test", nothing is
+   * published. Only the nodes on the paths named by the operations are copied and only the rules
+   * on these paths are checked, and the observers are told only these paths.
+   */
+  auto patch(const nlohmann::json& ops) -> result<std::uint64_t> {
+    auto lock = std::unique_lock(_write_mutex);
+    TRY_ASSIGN(auto data, config_node::patch(_data.load(std::memory_order_relaxed), ops));
+    // the operations are well-formed once applied
+    auto paths = detail::json_patch_paths(ops);
+    TRY_CHECK(_validator.validate(*data, paths));
+    return _publish(lock, std::move(data), paths);
+  }
+
+  /**
+   * @brief Merge a JSON merge patch (RFC 7396) into a copy of the current snapshot and publish it,
+   * return the new version, or the error of the schema validation.
+   *
+   * Nothing is published if the merge changes nothing. Otherwise only the nodes on the paths of
+   * the patch are copied, only the rules on the paths changed by the merge, i.e. the leaves of the
+   * patch differing from the current values, are checked, and the observers are told only these
+   * paths.
+   */
+  auto merge_patch(const nlohmann::json& patch) -> result<std::uint64_t> {
+    auto lock = std::unique_lock(_write_mutex);
+    auto current = _data.load(std::memory_order_relaxed);
+    auto paths = std::vector<nlohmann::json::json_pointer>();
+    auto root = nlohmann::json::json_pointer();
+    detail::merge_patch_paths(patch, *current, root, paths);
+    if (paths.empty()) {
+      return _version.load(std::memory_order_relaxed);
     }
-    try {
-      in >> config_data_;
-    } catch (...) {
+    auto data = config_node::merge_patch(current, patch);
+    TRY_CHECK(_validator.validate(*data, paths));
+    return _publish(lock, std::move(data), paths);
+  }
+
+ private:
+  struct publication {
+    snapshot data;
+    std::vector<nlohmann::json::json_pointer> paths;
+    std::uint64_t version;
+  };
+
+  // Publish data and release the writer lock before calling the observers
+  auto _publish(std::unique_lock<std::mutex>& lock, snapshot data, changes paths = root_changes())
+      -> std::uint64_t {
+    _data.store(data, std::memory_order_release);
+    auto version = _version.fetch_add(1, std::memory_order_release) + 1;
+    {
+      // queued under the writer lock, so in the order of publication
+      auto observer_lock = std::lock_guard(_observer_mutex);
+      if (!_observers.empty()) {
+        _undelivered.push_back({std::move(data), {paths.begin(), paths.end()}, version});
+      }
     }
-    std::cerr << __LINE__ << ":" << in.good();
+    lock.unlock();
+    _deliver();
+    return version;
   }
-  return 0;
-}
 
-auto WriteConfigToSystem() -> Result<void> {
-  std::shared_lock lock{mutex_};
+  // Call the observers with the queued publications unless another call of _deliver(), on another
+  // thread or up the stack of this one, is doing it
+  auto _deliver() -> void {
+    auto lock = std::unique_lock(_observer_mutex);
+    if (_deliverer != std::thread::id()) {
+      return;
+    }
+    _deliverer = std::this_thread::get_id();
+    while (!_undelivered.empty()) {
+      auto item = std::move(_undelivered.front());
+      _undelivered.pop_front();
+      // the observers are sorted by id, the ones subscribed meanwhile are called as well
+      auto last_id = std::uint64_t(0);
+      while (true) {
+        auto itr = std::ranges::upper_bound(_observers, last_id, {}, [](const auto& observer) {
+          return observer.first;
+        });
+        if (itr == _observers.end()) {
+          break;
+        }
+        last_id = itr->first;
+        auto fn = itr->second;
+        _calling = last_id;
+        lock.unlock();
+        try {
+          (*fn)(item.data, item.paths, item.version);
+        } catch (...) {
+          lock.lock();
+          _calling = 0;
+          _deliverer = std::thread::id();
+          _observer_done.notify_all();
+          throw;
+        }
+        lock.lock();
+        _calling = 0;
+        _observer_done.notify_all();
+      }
+    }
+    _deliverer = std::thread::id();
+  }
+
+  static auto root_changes() -> changes {
+    static const auto root = nlohmann::json::json_pointer();
+    return {&root, 1};
+  }
 
-  if (last_modified_time_ > last_sync_time_) {
-    std::ofstream out{config_path_, std::ios_base::out | std::ios_base::trunc};
-    std::cerr << __LINE__ << ":" << out.good();
-    out << config_data_ << std::flush;
-    if (out) {
-      last_sync_time_ = last_modified_time_;
-      last_sync_timestamp_ = std::filesystem::last_write_time(config_path_);
+  std::atomic<snapshot> _data;
+  std::atomic<std::uint64_t> _version = 0;
+  mutable std::mutex _write_mutex;  ///< Serializes the writers, guards the schema
+  config_validator _validator;
+  std::mutex _observer_mutex;  ///< Guards the members below, never held while calling an observer
+  std::condition_variable _observer_done;
+  std::vector<std::pair<std::uint64_t, std::shared_ptr<const version_observer>>> _observers;
+  std::uint64_t _last_observer_id = 0;
+  std::deque<publication> _undelivered;
+  std::thread::id _deliverer;  ///< Thread calling the observers, none if default
+  std::uint64_t _calling = 0;  ///< Id of the observer being called, 0 if none
+};
+
+/**
+ * @brief Typed handle of a config value, created by config::bind().
+ *
+ * The JSON pointer is parsed once and the converted value is cached, it is resolved again only
+ * after a new snapshot is published. So a read costs an atomic load of the version and a compare.
+ *
+ * A handle is not synchronized itself, copy it for each thread that reads it.
+ */
+template <typename T>
+class config_key {
+ public:
+  /**
+   * @brief Get the value of the latest snapshot, or config_not_found if the key does not exist,
+   * or config_type_mismatch if the value is not convertible to T.
+   */
+  auto get() -> const result<T>& {
+    auto version = _config->version();
+    if (version != _version) [[unlikely]] {
+      _resolve(version);
     }
-    std::cerr << __LINE__ << ":" << out.good();
+    return _value;
   }
-  return {};
-}
 
-void SyncConfig(SyncOption option) {
-  bool need_write = last_modified_time_ > last_sync_time_;
-  bool need_read = std::filesystem::last_write_time(config_path_) > last_sync_timestamp_;
-  if (need_write && (!need_read || option == kForceWrite)) {
+  auto pointer() const -> const nlohmann::json::json_pointer& { return _pointer; }
+
+ private:
+  friend class config;
+
+  config_key(const config& cfg, nlohmann::json::json_pointer pointer)
+      : _config(&cfg), _pointer(std::move(pointer)) {
+    _resolve(_config->version());
   }
-}
 
-auto& operator[](const std::string& key) { return config_data_[key]; }
+  // The snapshot loaded may be newer than version, which only costs one more resolving later
+  auto _resolve(std::uint64_t version) -> void {
+    auto data = _config->get();
+    _version = version;
+    const auto* value = data->find_pointer(_pointer);
+    if (value == nullptr) {
+      _value = make_error_code(error::config_not_found);
+      return;
+    }
+    try {
+      _value = value->template get<T>();
+    } catch (const nlohmann::json::exception&) {
+      _value = make_error_code(error::config_type_mismatch);
+    }
+  }
 
-private:
-std::shared_mutex mutex_;
-std::filesystem::path config_path_;
-nlohmann::json config_data_;
-std::chrono::system_clock::time_point last_modified_time_;
-std::chrono::system_clock::time_point last_sync_time_;
-std::filesystem::file_time_type last_sync_timestamp_;
+  const config* _config;
+  nlohmann::json::json_pointer _pointer;
+  std::uint64_t _version = std::numeric_limits<std::uint64_t>::max();
+  result<T> _value = make_error_code(error::config_not_found);
 };
 
-*/
 }  // namespace ascpp
@@ -0,0 +1,637 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <ios>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+#include "asio/error.hpp"
+#include "asio/io_context.hpp"
+#include "asio/post.hpp"
+#include "asio/steady_timer.hpp"
+#if defined(__linux__)
+#include "asio/buffer.hpp"
+#include "asio/posix/stream_descriptor.hpp"
+#endif
+#include "nlohmann/json.hpp"
+
+#include "app/info.hpp"
+#include "storage/config.hpp"
+#include "storage/config_view.hpp"
+#include "utils/error.hpp"
+#include "utils/log_file.hpp"
+#include "utils/mapped_file.hpp"
+#include "utils/system.hpp"
+
+namespace ascpp {
+
+enum class config_scope { user, machine };
+
+/**
+ * @brief Get the path of the config file: `get_config_dir()/<org>/<app>_{user,machine}.json`.
+ */
+inline auto get_config_path(const app_info& info, config_scope scope)
+    -> result<std::filesystem::path> {
+  TRY_ASSIGN(auto config_dir, get_config_dir());
+  auto name = info.app_name() + (scope == config_scope::user ? "_user.json" : "_machine.json");
+  return config_dir / info.org_name() / name;
+}
+
+/**
+ * @brief Get the path of the binary cache of the config file:
+ * `get_cache_dir()/<org>/<app>/config/<app>_{user,machine}.msgpack`.
+ */
+inline auto get_config_cache_path(const app_info& info, config_scope scope)
+    -> result<std::filesystem::path> {
+  TRY_ASSIGN(auto cache_dir, get_cache_dir());
+  auto name =
+      info.app_name() + (scope == config_scope::user ? "_user.msgpack" : "_machine.msgpack");
+  return cache_dir / info.org_name() / info.app_name() / "config" / name;
+}
+
+/**
+ * @brief Get the path of the config_view file of the config file, shared by the processes of the
+ * app: `get_cache_dir()/<org>/<app>/config/<app>_{user,machine}.view`.
+ */
+inline auto get_config_view_path(const app_info& info, config_scope scope)
+    -> result<std::filesystem::path> {
+  TRY_ASSIGN(auto cache_dir, get_cache_dir());
+  auto name = info.app_name() + (scope == config_scope::user ? "_user.view" : "_machine.view");
+  return cache_dir / info.org_name() / info.app_name() / "config" / name;
+}
+
+namespace detail {
+
+// Read instead of mapping, the file may be truncated by an editor while it is read
+inline auto read_text_file(const std::filesystem::path& path) -> result<std::string> {
+  auto in = std::ifstream(path, std::ios::binary | std::ios::ate);
+  if (!in) {
+    return std::make_error_code(std::errc::no_such_file_or_directory);
+  }
+  auto text = std::string(static_cast<std::size_t>(in.tellg()), '\0');
+  in.seekg(0);
+  in.read(text.data(), static_cast<std::streamsize>(text.size()));
+  text.resize(static_cast<std::size_t>(in.gcount()));
+  return text;
+}
+
+// An empty text is parsed as an empty object
+inline auto parse_config_text(std::string_view text) -> result<nlohmann::json> {
+  if (text.empty()) {
+    return nlohmann::json::object();
+  }
+  auto data = nlohmann::json::parse(text, nullptr, false);
+  if (data.is_discarded()) {
+    return make_error_code(error::invalid_config_file);
+  }
+  return data;
+}
+
+/**
+ * @brief Create a new temporary file next to path, named after it, the process id and a counter, so
+ * that processes and threads replacing the same file never write the same temporary file.
+ */
+inline auto create_temp_file(const std::filesystem::path& path, std::filesystem::path& temp)
+    -> result<int> {
+  static auto counter = std::atomic<std::uint32_t>(0);
+#if defined(_WIN32) || defined(_WIN64)
+  auto pid = ::_getpid();
+#else
+  auto pid = ::getpid();
+#endif
+  for (auto attempt = 0; attempt < 100; ++attempt) {
+    temp = path;
+    temp += std::format(".{}.{}.tmp", pid, counter.fetch_add(1, std::memory_order_relaxed));
+#if defined(_WIN32) || defined(_WIN64)
+    auto fd = ::_wopen(temp.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+                       _S_IREAD | _S_IWRITE);
+#else
+    auto fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+#endif
+    if (fd >= 0) {
+      return fd;
+    }
+    if (errno != EEXIST) {
+      break;  // else left by a crashed process of the same id, try the next name
+    }
+  }
+  return std::make_error_code(static_cast<std::errc>(errno));
+}
+
+/**
+ * @brief Replace the content of the file atomically: write a temporary file in the same directory,
+ * sync it, then rename it over the file.
+ *
+ * A crash leaves either the old or the new content, never a truncated file. Concurrent writers,
+ * e.g. worker processes rebuilding the same cache at startup, each write their own temporary file
+ * and the last rename wins.
+ */
+inline auto replace_file(const std::filesystem::path& path, std::string_view content)
+    -> result<void> {
+  auto temp = std::filesystem::path();
+  TRY_ASSIGN(auto fd, create_temp_file(path, temp));
+  auto file = log_file::from_fd(fd);
+  auto chunks = std::array<std::string_view, 1>{content};
+  auto res = file.write(chunks);
+  if (res) {
+    res = file.sync();
+  }
+  file.close();
+  auto err = std::error_code();
+  if (res) {
+    std::filesystem::rename(temp, path, err);
+  }
+  if (!res || err) {
+    std::filesystem::remove(temp, err);
+    return res ? err : res.error();
+  }
+#if !defined(_WIN32) && !defined(_WIN64)
+  // sync the directory as well, so that the rename itself survives a crash
+  auto dir_fd = ::open(path.parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd >= 0) {
+    ::fsync(dir_fd);
+    ::close(dir_fd);
+  }
+#endif
+  return {};
+}
+
+/**
+ * @brief Header of the binary cache of a config file, followed by the MessagePack of the config.
+ *
+ * The cache is only read on the host that wrote it, so the header is in the native byte order.
+ */
+struct config_cache_header {
+  std::array<char, 4> magic = {'A', 'C', 'F', 'G'};
+  std::uint32_t version = 1;
+  std::int64_t mtime = 0;  ///< Modification time of the JSON file, in ticks of file_time_type
+  std::uint64_t hash = 0;  ///< Hash of the JSON text
+};
+
+// FNV-1a over 8-byte words, stable across builds unlike std::hash
+inline auto hash_config_text(std::string_view text) -> std::uint64_t {
+  constexpr auto prime = 0x100000001b3ULL;
+  auto hash = 0xcbf29ce484222325ULL ^ text.size();
+  auto i = 0UZ;
+  for (; i + sizeof(std::uint64_t) <= text.size(); i += sizeof(std::uint64_t)) {
+    auto word = std::uint64_t();
+    std::memcpy(&word, text.data() + i, sizeof(word));
+    // rotate so that the high bits of a word reach the low bits of the following rounds
+    hash = std::rotl((hash ^ word) * prime, 29);
+  }
+  for (; i < text.size(); ++i) {
+    hash = (hash ^ static_cast<unsigned char>(text[i])) * prime;
+  }
+  return hash;
+}
+
+inline auto get_config_mtime(const std::filesystem::path& path) -> result<std::int64_t> {
+  auto err = std::error_code();
+  auto mtime = std::filesystem::last_write_time(path, err);
+  if (err) {
+    return err;
+  }
+  return static_cast<std::int64_t>(mtime.time_since_epoch().count());
+}
+
+/**
+ * @brief Decode the cache mapped in memory if it was built from the JSON text of given
+ * modification time and hash.
+ */
+inline auto read_config_cache(const std::filesystem::path& cache_path,
+                              std::int64_t mtime,
+                              std::uint64_t hash) -> result<nlohmann::json> {
+  TRY_ASSIGN(auto file, map_file(cache_path));
+  auto expected = config_cache_header{.mtime = mtime, .hash = hash};
+  auto header = config_cache_header();
+  if (file.size() < sizeof(header)) {
+    return make_error_code(error::invalid_config_file);
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != expected.magic || header.version != expected.version
+      || header.mtime != mtime || header.hash != hash) {
+    return make_error_code(error::invalid_config_file);
+  }
+  auto data = nlohmann::json::from_msgpack(file.data() + sizeof(header),
+                                           file.data() + file.size(), true, false);
+  if (data.is_discarded()) {
+    return make_error_code(error::invalid_config_file);
+  }
+  return data;
+}
+
+inline auto write_config_cache(const std::filesystem::path& cache_path,
+                               std::int64_t mtime,
+                               std::uint64_t hash,
+                               const nlohmann::json& data) -> result<void> {
+  auto header = config_cache_header{.mtime = mtime, .hash = hash};
+  auto content = std::string(reinterpret_cast<const char*>(&header), sizeof(header));
+  nlohmann::json::to_msgpack(data, content);
+  TRY_CHECK(create_file_path(cache_path.parent_path() / ""));
+  return replace_file(cache_path, content);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Read and parse a JSON config file, an empty file is read as an empty object.
+ */
+inline auto read_config_file(const std::filesystem::path& path) -> result<nlohmann::json> {
+  TRY_ASSIGN(auto text, detail::read_text_file(path));
+  return detail::parse_config_text(text);
+}
+
+/**
+ * @brief Read a JSON config file through its binary cache.
+ *
+ * If the cache was built from the file of the same modification time and content hash, the
+ * config is decoded from the MessagePack mapped in memory, which is several times faster than
+ * parsing the text. Otherwise the text is parsed and the cache rebuilt, failing to write the cache
+ * is not an error.
+ */
+inline auto read_config_file(const std::filesystem::path& path,
+                             const std::filesystem::path& cache_path) -> result<nlohmann::json> {
+  TRY_ASSIGN(auto mtime, detail::get_config_mtime(path));
+  TRY_ASSIGN(auto text, detail::read_text_file(path));
+  auto hash = detail::hash_config_text(text);
+  if (auto cached = detail::read_config_cache(cache_path, mtime, hash)) {
+    return std::move(*cached);
+  }
+  TRY_ASSIGN(auto data, detail::parse_config_text(text));
+  (void)detail::write_config_cache(cache_path, mtime, hash, data);
+  return data;
+}
+
+/**
+ * @brief Write a JSON config file atomically, see detail::replace_file().
+ */
+inline auto write_config_file(const std::filesystem::path& path, const nlohmann::json& data)
+    -> result<void> {
+  return detail::replace_file(path, data.dump(2) + '\n');
+}
+
+/**
+ * @brief Convert the config and write it atomically for open_config_view().
+ *
+ * The file is replaced rather than rewritten, so the processes still mapping the old one keep
+ * reading consistent data.
+ */
+inline auto write_config_view(const std::filesystem::path& path, const nlohmann::json& data)
+    -> result<void> {
+  TRY_CHECK(create_file_path(path.parent_path() / ""));
+  return detail::replace_file(path, build_config_view(data));
+}
+
+/**
+ * @brief Keep a config and its JSON file in sync in both directions.
+ *
+ * Reloading: on Linux the parent directory is watched by inotify through an asio stream
+ * descriptor, so no system call is made while the file does not change, and replacing the file by
+ * a rename (as editors and write_config_file() do) is detected as well. Elsewhere the modification
+ * time is polled every poll_interval. Changes are debounced: the file is read once debounce has
+ * elapsed since the last change, parsed on the thread running the io_context and published to the
+ * config, which notifies its observers. A file that fails to parse is ignored and the current
+ * snapshot kept, as well as a file whose content equals the current snapshot.
+ *
+ * Persisting: the snapshots published by other writers are written back by write_config_file(),
+ * at most once per flush_window however many are published within it. The file written by this
+ * object is recognized by its hash and not reloaded.
+ *
+ * With options::cache_path, the file is loaded at startup through its binary cache (see
+ * read_config_file()), and the cache is rebuilt whenever the file is reloaded or written. With
+ * options::view_path, a config_view file is written as well for the processes that only read the
+ * config.
+ *
+ * The pending asynchronous operations keep the object alive until stop() is called or the
+ * io_context is stopped.
+ */
+class config_file : public std::enable_shared_from_this<config_file> {
+ public:
+  struct options {
+    std::chrono::milliseconds debounce = std::chrono::milliseconds(100);
+    std::chrono::milliseconds poll_interval = std::chrono::seconds(1);  ///< Without inotify only
+    bool writable = true;  ///< Write the changes of the config back to the file
+    std::chrono::milliseconds flush_window = std::chrono::milliseconds(500);
+    /// Binary cache of the file kept up to date, e.g. get_config_cache_path(), empty for none
+    std::filesystem::path cache_path;
+    /// config_view file kept up to date, e.g. get_config_view_path(), empty for none
+    std::filesystem::path view_path;
+  };
+
+  config_file(config_file&&) = delete;
+  config_file(const config_file&) = delete;
+  auto operator=(config_file&&) -> config_file& = delete;
+  auto operator=(const config_file&) -> config_file& = delete;
+  ~config_file() = default;
+
+  static auto create(asio::io_context& ctx, config& cfg, std::filesystem::path path)
+      -> result<std::shared_ptr<config_file>> {
+    return create(ctx, cfg, std::move(path), options());
+  }
+
+  /**
+   * @brief Load the file into cfg if it exists, and start watching it and writing back changes.
+   */
+  static auto create(asio::io_context& ctx,
+                     config& cfg,
+                     std::filesystem::path path,
+                     options opts) -> result<std::shared_ptr<config_file>> {
+    TRY_CHECK(create_file_path(path.parent_path() / ""));
+    auto file = std::shared_ptr<config_file>(new config_file(ctx, cfg, std::move(path), opts));
+    if (std::filesystem::exists(file->_path)) {
+      TRY_ASSIGN(auto data, opts.cache_path.empty()
+                                ? read_config_file(file->_path)
+                                : read_config_file(file->_path, opts.cache_path));
+      TRY_CHECK(cfg.validate(data));
+      if (!opts.view_path.empty()) {
+        TRY_CHECK(write_config_view(opts.view_path, data));
+      }
+      TRY_ASSIGN(file->_synced_version, cfg.publish(data));
+    } else {
+      file->_synced_version = cfg.version();
+    }
+    TRY_CHECK(file->_start());
+    if (opts.writable) {
+      file->_observer_id =
+          cfg.subscribe([weak = std::weak_ptr<config_file>(file)](
+                            const config::snapshot& /*data*/, config::changes /*paths*/,
+                            std::uint64_t version) {
+            // let the io_context thread pick the change up
+            if (auto self = weak.lock()) {
+              asio::post(self->_flush_timer.get_executor(),
+                         [self, version] { self->_on_modified(version); });
+            }
+          });
+    }
+    return file;
+  }
+
+  /**
+   * @brief Stop watching, write the pending changes immediately.
+   */
+  auto stop() -> void {
+    if (_options.writable) {
+      _config->unsubscribe(_observer_id);
+    }
+    asio::post(_timer.get_executor(), [self = shared_from_this()] {
+      self->_stopped = true;
+      self->_timer.cancel();
+      self->_flush_timer.cancel();
+      self->_flush();
+#if defined(__linux__)
+      auto err = asio::error_code();
+      self->_inotify.close(err);
+#endif
+    });
+  }
+
+  auto path() const -> const std::filesystem::path& { return _path; }
+
+  /**
+   * @brief The last error met while reloading or writing, read it on the io_context thread.
+   */
+  auto last_error() const -> std::error_code { return _error; }
+
+  /**
+   * @brief When the config was last published by a writer other than this object.
+   */
+  auto last_modified_time() const -> std::chrono::system_clock::time_point {
+    return _last_modified_time;
+  }
+
+  /**
+   * @brief When the file was last written or read.
+   */
+  auto last_sync_time() const -> std::chrono::system_clock::time_point { return _last_sync_time; }
+
+ private:
+  config_file(asio::io_context& ctx, config& cfg, std::filesystem::path path, options opts)
+      : _config(&cfg),
+        _path(std::move(path)),
+        _options(opts),
+        _timer(ctx),
+        _flush_timer(ctx)
+#if defined(__linux__)
+        ,
+        _inotify(ctx)
+#endif
+  {
+  }
+
+#if defined(__linux__)
+  auto _start() -> result<void> {
+    auto fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+      return std::make_error_code(static_cast<std::errc>(errno));
+    }
+    _inotify.assign(fd);
+    auto mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+    if (::inotify_add_watch(fd, _path.parent_path().c_str(), mask) < 0) {
+      return std::make_error_code(static_cast<std::errc>(errno));
+    }
+    _read_events();
+    return {};
+  }
+
+  auto _read_events() -> void {
+    _inotify.async_read_some(
+        asio::buffer(_events), [self = shared_from_this()](asio::error_code ec, std::size_t size) {
+          if (ec || self->_stopped) {
+            return;
+          }
+          if (self->_is_changed(size)) {
+            self->_schedule_reload();
+          }
+          self->_read_events();
+        });
+  }
+
+  auto _is_changed(std::size_t size) const -> bool {
+    auto name = _path.filename().string();
+    for (auto offset = 0UZ; offset < size;) {
+      const auto* event = reinterpret_cast<const ::inotify_event*>(_events.data() + offset);
+      offset += sizeof(::inotify_event) + event->len;
+      if ((event->mask & IN_Q_OVERFLOW) != 0) {
+        return true;
+      }
+      // creating a file is followed by IN_CLOSE_WRITE, it is only watched to restart debouncing
+      if (event->len != 0 && name == event->name && (event->mask & IN_DELETE) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+#else
+  auto _start() -> result<void> {
+    auto err = std::error_code();
+    _last_write = std::filesystem::last_write_time(_path, err);
+    _poll();
+    return {};
+  }
+
+  auto _poll() -> void {
+    _timer.expires_after(_options.poll_interval);
+    _timer.async_wait([self = shared_from_this()](asio::error_code ec) {
+      if (ec || self->_stopped) {
+        return;
+      }
+      auto err = std::error_code();
+      auto last_write = std::filesystem::last_write_time(self->_path, err);
+      if (!err && last_write != self->_last_write) {
+        self->_last_write = last_write;
+        self->_reload();
+      }
+      self->_poll();
+    });
+  }
+#endif
+
+  auto _schedule_reload() -> void {
+    // restarting the timer cancels the wait of the previous change
+    _timer.expires_after(_options.debounce);
+    _timer.async_wait([self = shared_from_this()](asio::error_code ec) {
+      if (ec || self->_stopped) {
+        return;
+      }
+      self->_reload();
+    });
+  }
+
+  auto _reload() -> void {
+    auto text = detail::read_text_file(_path);
+    if (!text) {
+      _error = text.error();
+      return;
+    }
+    if (std::hash<std::string_view>()(*text) == _written_hash) {
+      return;
+    }
+    auto data = detail::parse_config_text(*text);
+    if (!data) {
+      _error = data.error();
+      return;
+    }
+    // an invalid file is not loaded, not even into the caches, until it is fixed
+    if (auto res = _config->validate(*data); !res) {
+      _error = res.error();
+      return;
+    }
+    _last_sync_time = std::chrono::system_clock::now();
+    _update_caches(*text, *data);
+    if (*_config->get() != *data) {
+      auto version = _config->publish(*data);
+      if (!version) {
+        _error = version.error();
+        return;
+      }
+      _synced_version = *version;
+    }
+  }
+
+  // Called on the io_context thread, so the next startup decodes the cache instead of the text
+  auto _update_caches(std::string_view text, const nlohmann::json& data) -> void {
+    if (!_options.cache_path.empty()) {
+      auto mtime = detail::get_config_mtime(_path);
+      if (mtime) {
+        (void)detail::write_config_cache(_options.cache_path, *mtime,
+                                         detail::hash_config_text(text), data);
+      }
+    }
+    if (!_options.view_path.empty()) {
+      auto res = write_config_view(_options.view_path, data);
+      if (!res) {
+        _error = res.error();
+      }
+    }
+  }
+
+  auto _on_modified(std::uint64_t version) -> void {
+    if (version <= _synced_version || _stopped) {
+      return;
+    }
+    _modified_version = std::max(_modified_version, version);
+    _last_modified_time = std::chrono::system_clock::now();
+    if (_flush_pending) {
+      return;
+    }
+    _flush_pending = true;
+    _flush_timer.expires_after(_options.flush_window);
+    _flush_timer.async_wait([self = shared_from_this()](asio::error_code ec) {
+      if (ec || self->_stopped) {
+        return;
+      }
+      self->_flush();
+    });
+  }
+
+  auto _flush() -> void {
+    _flush_pending = false;
+    if (_modified_version <= _synced_version) {
+      return;
+    }
+    // the snapshot may be newer than version, which only costs one more write later
+    auto version = _config->version();
+    auto data = _config->get()->to_json();
+    auto text = data.dump(2) + '\n';
+    auto res = detail::replace_file(_path, text);
+    if (!res) {
+      _error = res.error();
+      return;
+    }
+    _update_caches(text, data);
+    _written_hash = std::hash<std::string_view>()(text);
+    _synced_version = version;
+    _last_sync_time = std::chrono::system_clock::now();
+  }
+
+  config* _config;
+  std::filesystem::path _path;
+  options _options;
+  asio::steady_timer _timer;  ///< Debounces the reloads
+  asio::steady_timer _flush_timer;
+  bool _stopped = false;
+  bool _flush_pending = false;
+  std::error_code _error;
+  std::uint64_t _observer_id = 0;
+  std::uint64_t _synced_version = 0;  ///< Version equal to the content of the file
+  std::uint64_t _modified_version = 0;
+  std::size_t _written_hash = 0;  ///< Hash of the content written last time
+  std::chrono::system_clock::time_point _last_modified_time;
+  std::chrono::system_clock::time_point _last_sync_time;
+#if defined(__linux__)
+  asio::posix::stream_descriptor _inotify;
+  alignas(::inotify_event) std::array<char, 4096> _events;
+#else
+  std::filesystem::file_time_type _last_write;
+#endif
+};
+
+}  // namespace ascpp
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <functional>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+#include "storage/config_tree.hpp"
+#include "utils/error.hpp"
+
+namespace ascpp {
+
+namespace detail {
+
+/**
+ * @brief Constraints on the value at one JSON pointer, described by config_schema::add().
+ */
+struct config_rule {
+  std::string pointer;
+  std::vector<std::string> tokens;  ///< Unescaped tokens of the pointer
+  bool required = false;
+  std::uint32_t types = 0;  ///< Bit mask of the accepted nlohmann::json::value_t, 0 for any
+  bool has_range = false;
+  double min = 0;
+  double max = 0;
+  std::function<bool(const nlohmann::json&)> convertible;  ///< Checks the types with no mask
+  std::vector<std::function<bool(const nlohmann::json&)>> predicates;
+};
+
+template <typename T>
+constexpr auto config_type_mask() -> std::uint32_t {
+  using value_t = nlohmann::json::value_t;
+  auto bit = [](value_t type) { return 1U << static_cast<unsigned>(type); };
+  if constexpr (std::is_same_v<T, bool>) {
+    return bit(value_t::boolean);
+  } else if constexpr (std::is_integral_v<T>) {
+    // the negative values of the unsigned types are rejected by their ranges
+    return bit(value_t::number_integer) | bit(value_t::number_unsigned);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return bit(value_t::number_integer) | bit(value_t::number_unsigned) |
+           bit(value_t::number_float);
+  } else if constexpr (std::is_convertible_v<std::string, T>) {
+    return bit(value_t::string);
+  } else {
+    return 0;
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @brief Adder of the constraints on the value at a JSON pointer, the value is checked as T.
+ */
+template <typename T>
+class config_rule_adder {
+ public:
+  explicit config_rule_adder(detail::config_rule* rule) : _rule(rule) {}
+
+  /**
+   * @brief The key must exist, otherwise it may be missing but must be valid if present.
+   */
+  auto required() -> config_rule_adder& {
+    _rule->required = true;
+    return *this;
+  }
+
+  auto with_limits(std::unordered_set<T> limit_set) -> config_rule_adder& {
+    _rule->predicates.emplace_back([limit_set = std::move(limit_set)](const nlohmann::json& value) {
+      return limit_set.contains(value.get<T>());
+    });
+    return *this;
+  }
+
+  auto with_limits(std::function<bool(const T&)> limit_fn) -> config_rule_adder& {
+    _rule->predicates.emplace_back([limit_fn = std::move(limit_fn)](const nlohmann::json& value) {
+      return limit_fn(value.get<T>());
+    });
+    return *this;
+  }
+
+  /**
+   * @brief The number must be in [min, max], checked without calling any function.
+   */
+  auto with_range(T min, T max) -> config_rule_adder&
+    requires std::is_arithmetic_v<T>
+  {
+    _rule->has_range = true;
+    _rule->min = std::max(_rule->min, static_cast<double>(min));
+    _rule->max = std::min(_rule->max, static_cast<double>(max));
+    return *this;
+  }
+
+ private:
+  detail::config_rule* _rule;
+};
+
+/**
+ * @brief A schema compiled into a flat program that validates a whole config in one pass.
+ *
+ * The rules are sorted by their JSON pointers, so the program walks down and up the config like a
+ * depth-first traversal, each object member or array element on the way is looked up once for all
+ * the rules below it. The ranges and the types are checked by the program itself, only the limits
+ * given as sets or callables call a function, with the value converted to a DOM if it is an object
+ * or an array of a config_node.
+ */
+class config_validator {
+ public:
+  config_validator() = default;
+
+  /**
+   * @brief Validate the config, the error is config_not_found, config_type_mismatch or
+   * config_out_of_limits, with the pointer of the invalid value as its context.
+   */
+  auto validate(const nlohmann::json& data) const -> result<void> { return _validate(data, {}); }
+
+  auto validate(const config_node& data) const -> result<void> { return _validate(data, {}); }
+
+  /**
+   * @brief Validate a config of which only the values at the changed paths, and below, differ from
+   * a valid config. Only the rules on these values, or on a parent of them, are checked.
+   */
+  template <typename Value>
+    requires(std::is_same_v<Value, nlohmann::json> || std::is_same_v<Value, config_node>)
+  auto validate(const Value& data, std::span<const nlohmann::json::json_pointer> changed) const
+      -> result<void> {
+    auto checked = std::vector<bool>(_pointers.size());
+    for (const auto& path : changed) {
+      // adding or removing an array element shifts the elements after it
+      auto is_element = !path.empty()
+                        && (path.back() == "-"
+                            || detail::config_array_index(path.back()) != std::string_view::npos);
+      auto changed_pointer = is_element ? path.parent_pointer().to_string() : path.to_string();
+      for (auto i = 0UZ; i < _pointers.size(); ++i) {
+        checked[i] = checked[i] || _on_path(_pointers[i], changed_pointer)
+                     || _on_path(changed_pointer, _pointers[i]);
+      }
+    }
+    return _validate(data, checked);
+  }
+
+  /**
+   * @brief Number of the instructions of the program.
+   */
+  auto size() const -> std::size_t { return _program.size(); }
+
+ private:
+  friend class config_schema;
+
+  enum class op_code : std::uint8_t { enter, leave, required, type, convert, range, predicate };
+
+  struct instruction {
+    op_code op;
+    std::uint32_t rule;     ///< Index of the pointer of the rule, for the error context
+    std::uint32_t operand;  ///< Index of the key, type mask or index of the range or predicate
+  };
+
+  // Test if the value at pointer is the value at parent or below it
+  static auto _on_path(std::string_view parent, std::string_view pointer) -> bool {
+    return pointer.starts_with(parent)
+           && (pointer.size() == parent.size() || pointer[parent.size()] == '/');
+  }
+
+  static auto _child(const nlohmann::json& value, const std::string& key, std::size_t index)
+      -> const nlohmann::json* {
+    if (value.is_object()) {
+      auto itr = value.find(key);
+      return itr != value.end() ? &*itr : nullptr;
+    }
+    return value.is_array() && index < value.size() ? &value[index] : nullptr;
+  }
+
+  static auto _child(const config_node& value, const std::string& key, std::size_t index)
+      -> const config_node* {
+    return value.is_object() ? value.find(key) : value.at(index);
+  }
+
+  // The predicates take a DOM, a config_node is converted unless it is a scalar
+  static auto _dom(const nlohmann::json& value, nlohmann::json& /*buffer*/)
+      -> const nlohmann::json& {
+    return value;
+  }
+
+  static auto _dom(const config_node& value, nlohmann::json& buffer) -> const nlohmann::json& {
+    if (!value.is_object() && !value.is_array()) {
+      return value.scalar();
+    }
+    buffer = value.to_json();
+    return buffer;
+  }
+
+  // Run the program, checking only the rules set in checked if it is not empty
+  template <typename Value>
+  auto _validate(const Value& data, const std::vector<bool>& checked) const -> result<void> {
+    // the values from the root to the current member, null for missing members
+    auto stack = std::vector<const Value*>();
+    stack.reserve(_depth + 1);
+    stack.push_back(&data);
+    auto buffer = nlohmann::json();
+    for (const auto& inst : _program) {
+      const auto* value = stack.back();
+      if (inst.op != op_code::enter && inst.op != op_code::leave && !checked.empty()
+          && !checked[inst.rule]) {
+        continue;
+      }
+      switch (inst.op) {
+        case op_code::enter:
+          stack.push_back(value != nullptr
+                              ? _child(*value, _keys[inst.operand], _indices[inst.operand])
+                              : nullptr);
+          break;
+        case op_code::leave:
+          stack.pop_back();
+          break;
+        case op_code::required:
+          if (value == nullptr) {
+            return _fail(error::config_not_found, inst.rule);
+          }
+          break;
+        case op_code::type:
+          if (value != nullptr &&
+              (inst.operand & (1U << static_cast<unsigned>(value->type()))) == 0) {
+            return _fail(error::config_type_mismatch, inst.rule);
+          }
+          break;
+        case op_code::convert:
+          if (value != nullptr && !_predicates[inst.operand](_dom(*value, buffer))) {
+            return _fail(error::config_type_mismatch, inst.rule);
+          }
+          break;
+        case op_code::range:
+          if (value != nullptr) {
+            auto number = value->template get<double>();
+            if (number < _ranges[inst.operand].first || number > _ranges[inst.operand].second) {
+              return _fail(error::config_out_of_limits, inst.rule);
+            }
+          }
+          break;
+        case op_code::predicate:
+          if (value != nullptr && !_predicates[inst.operand](_dom(*value, buffer))) {
+            return _fail(error::config_out_of_limits, inst.rule);
+          }
+          break;
+      }
+    }
+    return {};
+  }
+
+  auto _fail(error::errc ec, std::uint32_t rule) const -> result<void> {
+    return result<void>(make_error_code(ec)).context("invalid config '{}'", _pointers[rule]);
+  }
+
+  std::vector<instruction> _program;
+  std::vector<std::string> _keys;
+  std::vector<std::size_t> _indices;  ///< Keys as array indices, npos if they are not
+  std::vector<std::string> _pointers;
+  std::vector<std::pair<double, double>> _ranges;
+  std::vector<std::function<bool(const nlohmann::json&)>> _predicates;
+  std::size_t _depth = 0;
+};
+
+/**
+ * @brief Descriptors of the valid configs, in the style of the options of cmdline.
+ *
+ * e.g. `schema.add<int>("/server/port").required().with_range(1, 65535);`
+ */
+class config_schema {
+ public:
+  /**
+   * @brief Add a rule on the value at the JSON pointer, which must be convertible to T.
+   *
+   * A token of the pointer names an element of an array where the config has an array, e.g.
+   * "/servers/0/port", and a member of an object elsewhere, as with json::at().
+   *
+   * @throw std::logic_error if pointer is not a valid JSON pointer
+   */
+  template <typename T>
+  auto add(std::string_view pointer) -> config_rule_adder<T> {
+    auto& rule = _rules.emplace_back();
+    rule.pointer = pointer;
+    try {
+      auto parsed = nlohmann::json::json_pointer(std::string(pointer));
+      for (auto ptr = parsed; !ptr.empty(); ptr = ptr.parent_pointer()) {
+        rule.tokens.insert(rule.tokens.begin(), ptr.back());
+      }
+    } catch (const nlohmann::json::parse_error& e) {
+      _rules.pop_back();
+      throw std::logic_error(std::format("invalid config key '{}': {}", pointer, e.what()));
+    }
+    rule.types = detail::config_type_mask<T>();
+    if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) {
+      rule.min = static_cast<double>(std::numeric_limits<T>::lowest());
+      rule.max = static_cast<double>(std::numeric_limits<T>::max());
+      // a config value out of the range of an integer type could not be read as T
+      rule.has_range = std::is_integral_v<T>;
+    }
+    if (rule.types == 0) {
+      // no type mask for T, e.g. a container, try to convert the value instead
+      rule.convertible = [](const nlohmann::json& value) {
+        try {
+          (void)value.get<T>();
+          return true;
+        } catch (const nlohmann::json::exception&) {
+          return false;
+        }
+      };
+    }
+    return config_rule_adder<T>(&rule);
+  }
+
+  /**
+   * @brief Compile the rules into a validator.
+   */
+  auto compile() const -> config_validator {
+    auto ret = config_validator();
+    auto order = std::vector<std::uint32_t>(_rules.size());
+    for (auto i = 0U; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::ranges::stable_sort(order, {}, [&](std::uint32_t i) -> const auto& {
+      return _rules[i].tokens;
+    });
+
+    auto path = std::vector<std::string>();  // tokens of the member the program is at
+    auto emit = [&](config_validator::op_code op, std::uint32_t rule, std::uint32_t operand) {
+      ret._program.push_back({op, rule, operand});
+    };
+    for (auto index : order) {
+      const auto& rule = _rules[index];
+      auto common = static_cast<std::size_t>(
+          std::ranges::mismatch(path, rule.tokens).in1 - path.begin());
+      for (; path.size() > common; path.pop_back()) {
+        emit(config_validator::op_code::leave, index, 0);
+      }
+      for (; path.size() < rule.tokens.size(); path.push_back(rule.tokens[path.size()])) {
+        ret._keys.push_back(rule.tokens[path.size()]);
+        ret._indices.push_back(detail::config_array_index(ret._keys.back()));
+        emit(config_validator::op_code::enter, index,
+             static_cast<std::uint32_t>(ret._keys.size() - 1));
+      }
+      ret._depth = std::max(ret._depth, path.size());
+
+      ret._pointers.push_back(rule.pointer);
+      auto rule_id = static_cast<std::uint32_t>(ret._pointers.size() - 1);
+      if (rule.required) {
+        emit(config_validator::op_code::required, rule_id, 0);
+      }
+      if (rule.types != 0) {
+        emit(config_validator::op_code::type, rule_id, rule.types);
+      }
+      if (rule.convertible) {
+        ret._predicates.push_back(rule.convertible);
+        emit(config_validator::op_code::convert, rule_id,
+             static_cast<std::uint32_t>(ret._predicates.size() - 1));
+      }
+      if (rule.has_range) {
+        ret._ranges.emplace_back(rule.min, rule.max);
+        emit(config_validator::op_code::range, rule_id,
+             static_cast<std::uint32_t>(ret._ranges.size() - 1));
+      }
+      for (const auto& pred : rule.predicates) {
+        ret._predicates.push_back(pred);
+        emit(config_validator::op_code::predicate, rule_id,
+             static_cast<std::uint32_t>(ret._predicates.size() - 1));
+      }
+    }
+    return ret;
+  }
+
+ private:
+  std::deque<detail::config_rule> _rules;  ///< Deque so that the adders keep valid pointers
+};
+
+}  // namespace ascpp
@@ -0,0 +1,440 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32) || defined(_WIN64)
+// same macros as mapped_file.hpp, whichever of the two is included first
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef NOGDI
+#define NOGDI
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "app/info.hpp"
+#include "storage/config.hpp"
+#include "storage/config_view.hpp"
+#include "utils/error.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace ascpp {
+
+/**
+ * @brief Get the name of the shared memory segment of the app config: `/<org>.<app>.config`.
+ */
+inline auto get_config_shm_name(const app_info& info) -> std::string {
+  auto name = std::format("/{}.{}.config", info.org_name(), info.app_name());
+  std::replace(name.begin() + 1, name.end(), '/', '_');
+  return name;
+}
+
+namespace detail {
+
+/**
+ * @brief Header of the shared memory segment, followed by the config in the config_view layout.
+ *
+ * The config is guarded by a seqlock: the leader makes the sequence odd, writes the config and its
+ * size, and makes the sequence even again. A follower copies the config out and retries a few
+ * times if the sequence has changed meanwhile. While the sequence is odd it keeps its current
+ * config, so a leader crashing in the middle of a write never blocks the followers.
+ */
+struct config_shm_header {
+  std::array<char, 4> magic = {'A', 'C', 'S', 'M'};
+  std::uint32_t version = 1;
+  std::uint64_t capacity = 0;  ///< Bytes available for the config after the header
+  std::atomic<std::uint64_t> sequence = 0;
+  std::atomic<std::uint64_t> config_version = 0;
+  std::atomic<std::uint64_t> size = 0;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "the seqlock in shared memory must be address free");
+
+inline auto last_system_error() -> std::error_code {
+#if defined(_WIN32) || defined(_WIN64)
+  return {static_cast<int>(::GetLastError()), std::system_category()};
+#else
+  return std::make_error_code(static_cast<std::errc>(errno));
+#endif
+}
+
+/**
+ * @brief Create or open the named segment of at least size bytes and map it, writable if size is
+ * not 0, otherwise read-only with its current size. An existing segment is never shrunk, the
+ * followers mapping its old size would fault reading past its new end.
+ */
+inline auto map_config_shm(const std::string& name, std::size_t size) -> result<mapped_file> {
+#if defined(_WIN32) || defined(_WIN64)
+  auto wname = std::wstring(L"Local\\") + std::wstring(name.begin() + 1, name.end());
+  auto mapping = size != 0
+                     ? ::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                            static_cast<DWORD>(std::uint64_t(size) >> 32),
+                                            static_cast<DWORD>(size), wname.c_str())
+                     : ::OpenFileMappingW(FILE_MAP_READ, FALSE, wname.c_str());
+  if (mapping == nullptr) {
+    return last_system_error();
+  }
+  auto* data = ::MapViewOfFile(mapping, size != 0 ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+  ::CloseHandle(mapping);
+  if (data == nullptr) {
+    return last_system_error();
+  }
+  if (size == 0) {
+    auto info = MEMORY_BASIC_INFORMATION();
+    ::VirtualQuery(data, &info, sizeof(info));
+    size = info.RegionSize;
+  }
+  return mapped_file::from_mapping(static_cast<const char*>(data), size);
+#else
+  auto writable = size != 0;
+  auto fd = writable ? ::shm_open(name.c_str(), O_RDWR | O_CREAT, 0644)
+                     : ::shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return last_system_error();
+  }
+  struct ::stat st {};
+  auto failed = ::fstat(fd, &st) != 0;
+  auto current = static_cast<std::size_t>(st.st_size);
+  if (!failed && writable && current < size) {
+    failed = ::ftruncate(fd, static_cast<off_t>(size)) != 0;
+  }
+  if (failed) {
+    auto ec = last_system_error();
+    ::close(fd);
+    return ec;
+  }
+  size = std::max(size, current);
+  if (size == 0) {
+    ::close(fd);
+    return make_error_code(error::invalid_config_file);
+  }
+  auto* data =
+      ::mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  auto ec = data == MAP_FAILED ? last_system_error() : std::error_code();
+  ::close(fd);
+  if (ec) {
+    return ec;
+  }
+  return mapped_file::from_mapping(static_cast<const char*>(data), size);
+#endif
+}
+
+/**
+ * @brief Exclusive ownership of the named segment by a leader, released on destruction or when the
+ * process exits. On POSIX it is a flock on the segment itself, on Windows a named mutex.
+ */
+class config_shm_lock {
+ public:
+  config_shm_lock(config_shm_lock&& other) noexcept
+      : _handle(std::exchange(other._handle, invalid_handle)) {}
+  config_shm_lock(const config_shm_lock&) = delete;
+  auto operator=(config_shm_lock&&) -> config_shm_lock& = delete;
+  auto operator=(const config_shm_lock&) -> config_shm_lock& = delete;
+
+  ~config_shm_lock() {
+    if (_handle != invalid_handle) {
+#if defined(_WIN32) || defined(_WIN64)
+      ::CloseHandle(_handle);
+#else
+      ::close(_handle);
+#endif
+    }
+  }
+
+  /**
+   * @brief Lock the segment named name, creating it if needed, or fail with device_or_resource_busy
+   * if another leader holds it.
+   */
+  static auto acquire(const std::string& name) -> result<config_shm_lock> {
+#if defined(_WIN32) || defined(_WIN64)
+    auto wname =
+        std::wstring(L"Local\\") + std::wstring(name.begin() + 1, name.end()) + L".leader";
+    auto* mutex = ::CreateMutexW(nullptr, FALSE, wname.c_str());
+    if (mutex == nullptr) {
+      return last_system_error();
+    }
+    if (::GetLastError() == ERROR_ALREADY_EXISTS) {
+      ::CloseHandle(mutex);
+      return std::make_error_code(std::errc::device_or_resource_busy);
+    }
+    return config_shm_lock(mutex);
+#else
+    while (true) {
+      auto lock = config_shm_lock(::shm_open(name.c_str(), O_RDWR | O_CREAT, 0644));
+      if (lock._handle < 0) {
+        return last_system_error();
+      }
+      if (::flock(lock._handle, LOCK_EX | LOCK_NB) != 0) {
+        return errno == EWOULDBLOCK ? std::make_error_code(std::errc::device_or_resource_busy)
+                                    : last_system_error();
+      }
+      // the previous leader may have unlinked the segment after it has been opened, then the
+      // segment mapped by name is a new one that this lock does not cover
+      struct ::stat st {};
+      if (::fstat(lock._handle, &st) != 0) {
+        return last_system_error();
+      }
+      if (st.st_nlink != 0) {
+        return lock;
+      }
+    }
+#endif
+  }
+
+ private:
+#if defined(_WIN32) || defined(_WIN64)
+  using handle_type = HANDLE;
+  static constexpr auto invalid_handle = handle_type(nullptr);
+#else
+  using handle_type = int;
+  static constexpr auto invalid_handle = -1;
+#endif
+
+  explicit config_shm_lock(handle_type handle) : _handle(handle) {}
+
+  handle_type _handle;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Publisher of the snapshots of a config into a shared memory segment, for the other
+ * processes of the app on the host to read with config_shm_follower.
+ *
+ * The current snapshot is written on creation and every snapshot published to the config later is
+ * written by the publishing thread, converted to the flat layout of config_view, so the followers
+ * need neither parse it nor build a DOM. The segment is removed when the leader is destroyed, the
+ * followers keep the last config they have read.
+ */
+class config_shm_leader {
+ public:
+  config_shm_leader(config_shm_leader&&) = delete;
+  config_shm_leader(const config_shm_leader&) = delete;
+  auto operator=(config_shm_leader&&) -> config_shm_leader& = delete;
+  auto operator=(const config_shm_leader&) -> config_shm_leader& = delete;
+
+  ~config_shm_leader() {
+    _config->unsubscribe(_observer_id);
+    _segment.unmap();
+#if !defined(_WIN32) && !defined(_WIN64)
+    ::shm_unlink(_name.c_str());
+#endif
+  }
+
+  /**
+   * @brief Create the segment named name, e.g. by get_config_shm_name(), with room for a config of
+   * capacity bytes in the config_view layout, and publish cfg into it. The segment left by a
+   * previous leader is reused, with its capacity if it is larger. Only one leader may own a
+   * segment at a time, another one fails with device_or_resource_busy.
+   */
+  static auto create(config& cfg, std::string name, std::size_t capacity)
+      -> result<std::unique_ptr<config_shm_leader>> {
+    TRY_ASSIGN(auto lock, detail::config_shm_lock::acquire(name));
+    TRY_ASSIGN(auto segment,
+               detail::map_config_shm(name, sizeof(detail::config_shm_header) + capacity));
+    auto leader = std::unique_ptr<config_shm_leader>(
+        new config_shm_leader(cfg, std::move(name), std::move(lock), std::move(segment)));
+    auto* header = leader->_header();
+    // the segment left by a leader that has crashed keeps its sequence, so that its followers
+    // never see the sequence they have read again for a different config, and it is made odd
+    // before the rest of the header is reset so that they never read it half reset
+    auto expected = detail::config_shm_header();
+    auto seq = header->magic == expected.magic && header->version == expected.version
+                   ? header->sequence.load(std::memory_order_relaxed)
+                   : 0;
+    header->sequence.store(seq | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = expected.magic;
+    header->version = expected.version;
+    header->capacity = leader->_segment.size() - sizeof(*header);
+    TRY_CHECK(leader->_write(*cfg.get(), cfg.version()));
+    leader->_observer_id =
+        cfg.subscribe([self = leader.get()](const config::snapshot& data, config::changes /*paths*/,
+                                            std::uint64_t version) {
+          auto res = self->_write(*data, version);
+          self->_error = res ? std::error_code() : res.error();
+        });
+    return leader;
+  }
+
+  auto name() const -> const std::string& { return _name; }
+
+  /**
+   * @brief Error of the last write, e.g. when a config exceeds the capacity and is not shared.
+   */
+  auto last_error() const -> std::error_code { return _error; }
+
+ private:
+  config_shm_leader(config& cfg, std::string name, detail::config_shm_lock lock,
+                    mapped_file segment)
+      : _config(&cfg),
+        _name(std::move(name)),
+        _lock(std::move(lock)),
+        _segment(std::move(segment)) {}
+
+  auto _header() -> detail::config_shm_header* {
+    return reinterpret_cast<detail::config_shm_header*>(const_cast<char*>(_segment.data()));
+  }
+
+  auto _write(const config_node& data, std::uint64_t version) -> result<void> {
+    auto buffer = build_config_view(data);
+    auto* header = _header();
+    if (buffer.size() > header->capacity) {
+      return make_error_code(error::OUT_OF_RANGE);
+    }
+    // the sequence is already odd on the first write after create()
+    auto seq = header->sequence.load(std::memory_order_relaxed) | 1;
+    header->sequence.store(seq, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(const_cast<char*>(_segment.data()) + sizeof(*header), buffer.data(),
+                buffer.size());
+    header->size.store(buffer.size(), std::memory_order_relaxed);
+    header->config_version.store(version, std::memory_order_relaxed);
+    header->sequence.store(seq + 1, std::memory_order_release);
+    return {};
+  }
+
+  config* _config;
+  std::string _name;
+  detail::config_shm_lock _lock;
+  mapped_file _segment;
+  std::uint64_t _observer_id = 0;
+  std::error_code _error;
+};
+
+/**
+ * @brief Reader of the config shared by a config_shm_leader, mapping the segment read-only.
+ *
+ * poll() costs an atomic load when nothing changed, otherwise it copies the new config out of the
+ * segment, which is a memcpy of its flat layout. get() is lock-free and the views it returns stay
+ * valid and unchanged however the config is updated afterwards.
+ */
+class config_shm_follower {
+ public:
+  using snapshot = std::shared_ptr<const config_view>;
+
+  static constexpr auto max_retries = 8;
+
+  config_shm_follower(config_shm_follower&&) = delete;
+  config_shm_follower(const config_shm_follower&) = delete;
+  auto operator=(config_shm_follower&&) -> config_shm_follower& = delete;
+  auto operator=(const config_shm_follower&) -> config_shm_follower& = delete;
+  ~config_shm_follower() = default;
+
+  /**
+   * @brief Map the segment named name and read the current config.
+   */
+  static auto open(const std::string& name) -> result<std::unique_ptr<config_shm_follower>> {
+    TRY_ASSIGN(auto segment, detail::map_config_shm(name, 0));
+    if (segment.size() < sizeof(detail::config_shm_header)) {
+      return make_error_code(error::invalid_config_file);
+    }
+    auto follower =
+        std::unique_ptr<config_shm_follower>(new config_shm_follower(name, std::move(segment)));
+    const auto* header = follower->_header();
+    auto expected = detail::config_shm_header();
+    if (header->magic != expected.magic || header->version != expected.version
+        || header->capacity > follower->_segment.size() - sizeof(*header)) {
+      return make_error_code(error::invalid_config_file);
+    }
+    TRY_ASSIGN(auto read, follower->poll());
+    if (!read) {
+      return std::make_error_code(std::errc::resource_unavailable_try_again);
+    }
+    return follower;
+  }
+
+  /**
+   * @brief Read the config if the leader has published a new one, return whether it is new.
+   *
+   * It returns false and keeps the current config while the leader is writing, or has crashed in
+   * the middle of a write, and if the config keeps changing during max_retries copies. Only one
+   * thread may poll at a time, while any thread may get().
+   */
+  auto poll() -> result<bool> {
+    const auto* header = _header();
+    auto seq = header->sequence.load(std::memory_order_acquire);
+    if (seq == _sequence) {
+      return false;
+    }
+    auto buffer = std::string();
+    auto version = std::uint64_t();
+    for (auto retry = 0;; ++retry) {
+      if (seq % 2 != 0 || retry == max_retries) {
+        return false;
+      }
+      auto size = header->size.load(std::memory_order_relaxed);
+      version = header->config_version.load(std::memory_order_relaxed);
+      if (size <= _segment.size() - sizeof(*header)) {
+        buffer.resize_and_overwrite(size, [&](char* out, std::size_t count) {
+          std::memcpy(out, _segment.data() + sizeof(*header), count);
+          return count;
+        });
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (auto next = header->sequence.load(std::memory_order_relaxed); next != seq) {
+        seq = next;
+      } else if (size > _segment.size() - sizeof(*header)) {
+        // a new leader has grown the segment
+        TRY_ASSIGN(_segment, detail::map_config_shm(_name, 0));
+        header = _header();
+      } else {
+        break;
+      }
+    }
+
+    TRY_CHECK(detail::check_config_view(buffer));
+    _sequence = seq;
+    _version.store(version, std::memory_order_relaxed);
+    _view.store(std::make_shared<const config_view>(std::move(buffer)), std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Get the last config read.
+   */
+  auto get() const -> snapshot { return _view.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Version of the config of the leader when the last config read was published.
+   */
+  auto version() const -> std::uint64_t { return _version.load(std::memory_order_relaxed); }
+
+ private:
+  config_shm_follower(std::string name, mapped_file segment)
+      : _name(std::move(name)), _segment(std::move(segment)) {}
+
+  auto _header() const -> const detail::config_shm_header* {
+    return reinterpret_cast<const detail::config_shm_header*>(_segment.data());
+  }
+
+  std::string _name;
+  mapped_file _segment;
+  std::uint64_t _sequence = 0;
+  std::atomic<std::uint64_t> _version = 0;
+  std::atomic<snapshot> _view;
+};
+
+}  // namespace ascpp
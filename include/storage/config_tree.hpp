@@ -0,0 +1,519 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+#include "utils/error.hpp"
+
+namespace ascpp {
+
+namespace detail {
+
+/**
+ * @brief Get the array index of a JSON pointer token, npos if it is not one, e.g. "-" or "01".
+ */
+inline auto config_array_index(std::string_view token) -> std::size_t {
+  auto index = std::size_t();
+  auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), index);
+  if (ec != std::errc() || end != token.data() + token.size() || token.empty()
+      || (token.size() > 1 && token.front() == '0')) {
+    return std::string_view::npos;
+  }
+  return index;
+}
+
+/**
+ * @brief Split a JSON pointer into its unescaped tokens, false if it is not a valid JSON pointer.
+ */
+inline auto split_config_pointer(std::string_view pointer, std::vector<std::string>& tokens)
+    -> bool {
+  tokens.clear();
+  while (!pointer.empty()) {
+    if (pointer.front() != '/') {
+      return false;
+    }
+    pointer.remove_prefix(1);
+    auto token = pointer.substr(0, pointer.find('/'));
+    pointer.remove_prefix(token.size());
+    auto& unescaped = tokens.emplace_back();
+    for (auto i = 0UZ; i < token.size(); ++i) {
+      if (token[i] != '~') {
+        unescaped.push_back(token[i]);
+      } else if (i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1')) {
+        unescaped.push_back(token[++i] == '0' ? '~' : '/');
+      } else {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Immutable JSON value whose objects and arrays hold their children by shared_ptr, so that
+ * a modified tree shares every subtree off the modified paths with the original one.
+ *
+ * A modification copies only the nodes from the root down to the modified value, each of them
+ * being the list of the pointers to its children, so it costs the widths of the nodes on the path
+ * whatever the size of the tree. Scalars are stored as nlohmann::json, the members of an object
+ * are sorted by key like in nlohmann::json.
+ */
+class config_node {
+  struct private_tag {};
+
+ public:
+  using ptr = std::shared_ptr<const config_node>;
+  using member = std::pair<std::string, ptr>;
+  using value_t = nlohmann::json::value_t;
+
+  // Public for std::make_shared only, create the nodes by make()
+  config_node(private_tag /*tag*/, nlohmann::json scalar)
+      : _type(scalar.type()), _scalar(std::move(scalar)) {}
+
+  config_node(private_tag /*tag*/, value_t type) : _type(type) {}
+
+  /**
+   * @brief Convert a DOM to a tree, allocates a node per value.
+   */
+  static auto make(const nlohmann::json& data) -> ptr {
+    if (data.is_object()) {
+      auto members = std::vector<member>();
+      members.reserve(data.size());
+      for (const auto& [key, value] : data.items()) {
+        members.emplace_back(key, make(value));
+      }
+      return _make_object(std::move(members));
+    }
+    if (data.is_array()) {
+      auto elements = std::vector<ptr>();
+      elements.reserve(data.size());
+      for (const auto& value : data) {
+        elements.push_back(make(value));
+      }
+      return _make_array(std::move(elements));
+    }
+    return std::make_shared<const config_node>(private_tag(), data);
+  }
+
+  /**
+   * @brief Apply a JSON patch (RFC 6902) to root, return the patched tree, or config_patch_failed
+   * with the failed operation as context.
+   *
+   * The values moved or copied by the patch are shared, not copied.
+   */
+  static auto patch(ptr root, const nlohmann::json& ops) -> result<ptr> {
+    if (!ops.is_array()) {
+      return _patch_error("a JSON patch must be an array");
+    }
+    for (const auto& op : ops) {
+      TRY_ASSIGN(root, _apply(root, op));
+    }
+    return root;
+  }
+
+  /**
+   * @brief Merge a JSON merge patch (RFC 7396) into target, return the merged tree.
+   */
+  static auto merge_patch(const ptr& target, const nlohmann::json& patch) -> ptr {
+    if (!patch.is_object()) {
+      return make(patch);
+    }
+    auto ret = target != nullptr && target->is_object() ? target : _make_object({});
+    for (const auto& [key, value] : patch.items()) {
+      auto [pos, found] = ret->_find_member(key);
+      if (value.is_null()) {
+        if (found) {
+          ret = ret->_erase_child(pos);
+        }
+      } else if (found) {
+        ret = ret->_set_child(pos, merge_patch(ret->_members[pos].second, value));
+      } else {
+        auto members = ret->_members;
+        members.emplace(members.begin() + static_cast<std::ptrdiff_t>(pos), key,
+                        merge_patch(nullptr, value));
+        ret = _make_object(std::move(members));
+      }
+    }
+    return ret;
+  }
+
+  auto type() const -> value_t { return _type; }
+
+  auto is_null() const -> bool { return _type == value_t::null; }
+
+  auto is_object() const -> bool { return _type == value_t::object; }
+
+  auto is_array() const -> bool { return _type == value_t::array; }
+
+  /**
+   * @brief Number of the elements of an array or the members of an object, 0 for the others.
+   */
+  auto size() const -> std::size_t {
+    return is_object() ? _members.size() : _elements.size();
+  }
+
+  auto members() const -> std::span<const member> { return _members; }
+
+  auto elements() const -> std::span<const ptr> { return _elements; }
+
+  /**
+   * @brief Value of a scalar, null for an object or an array.
+   */
+  auto scalar() const -> const nlohmann::json& { return _scalar; }
+
+  /**
+   * @brief Find a member of an object by binary search, nullptr if there is none.
+   */
+  auto find(std::string_view key) const -> const config_node* {
+    auto [pos, found] = _find_member(key);
+    return found ? _members[pos].second.get() : nullptr;
+  }
+
+  /**
+   * @brief Get an element of an array, nullptr if there is none.
+   */
+  auto at(std::size_t index) const -> const config_node* {
+    return index < _elements.size() ? _elements[index].get() : nullptr;
+  }
+
+  auto contains(std::string_view key) const -> bool { return find(key) != nullptr; }
+
+  /**
+   * @brief Get a member of an object, a null value if there is none.
+   */
+  auto operator[](std::string_view key) const -> const config_node& {
+    const auto* value = find(key);
+    return value != nullptr ? *value : _null();
+  }
+
+  /**
+   * @brief Get an element of an array, a null value if there is none.
+   */
+  auto operator[](std::size_t index) const -> const config_node& {
+    const auto* value = at(index);
+    return value != nullptr ? *value : _null();
+  }
+
+  /**
+   * @brief Get the value at the JSON pointer relative to this value, nullptr if there is none or
+   * pointer is invalid.
+   */
+  auto find_pointer(std::string_view pointer) const -> const config_node* {
+    auto tokens = std::vector<std::string>();
+    if (!detail::split_config_pointer(pointer, tokens)) {
+      return nullptr;
+    }
+    const auto* value = this;
+    for (const auto& token : tokens) {
+      auto pos = value->_child_index(token);
+      if (pos == std::string_view::npos) {
+        return nullptr;
+      }
+      value = value->_child(pos).get();
+    }
+    return value;
+  }
+
+  auto find_pointer(const nlohmann::json::json_pointer& pointer) const -> const config_node* {
+    return find_pointer(pointer.to_string());
+  }
+
+  /**
+   * @brief Get the value as T like nlohmann::json::get(), an object or an array is converted to a
+   * DOM first.
+   *
+   * @throw nlohmann::json::exception if the value is not convertible to T
+   */
+  template <typename T>
+  auto get() const -> T {
+    if (is_object() || is_array()) {
+      return to_json().get<T>();
+    }
+    return _scalar.get<T>();
+  }
+
+  /**
+   * @brief Convert back to a DOM, allocates.
+   */
+  auto to_json() const -> nlohmann::json {
+    if (is_object()) {
+      auto ret = nlohmann::json::object();
+      for (const auto& [key, value] : _members) {
+        ret.emplace(key, value->to_json());
+      }
+      return ret;
+    }
+    if (is_array()) {
+      auto ret = nlohmann::json::array();
+      for (const auto& value : _elements) {
+        ret.push_back(value->to_json());
+      }
+      return ret;
+    }
+    return _scalar;
+  }
+
+  // The subtrees shared by both sides are not compared
+  friend auto operator==(const config_node& x, const config_node& y) -> bool {
+    if (&x == &y) {
+      return true;
+    }
+    if (x.is_object() || x.is_array() || y.is_object() || y.is_array()) {
+      return x._type == y._type
+             && std::ranges::equal(x._members, y._members,
+                                   [](const member& a, const member& b) {
+                                     return a.first == b.first && *a.second == *b.second;
+                                   })
+             && std::ranges::equal(x._elements, y._elements,
+                                   [](const ptr& a, const ptr& b) { return *a == *b; });
+    }
+    return x._scalar == y._scalar;
+  }
+
+  friend auto operator==(const config_node& x, const nlohmann::json& y) -> bool {
+    if (!x.is_object() && !x.is_array()) {
+      return x._scalar == y;
+    }
+    if (x._type != y.type() || x.size() != y.size()) {
+      return false;
+    }
+    auto i = 0UZ;
+    for (auto itr = y.begin(); itr != y.end(); ++itr, ++i) {
+      if (x.is_object() ? x._members[i].first != itr.key() || !(*x._members[i].second == *itr)
+                        : !(*x._elements[i] == *itr)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  static auto _make_object(std::vector<member> members) -> ptr {
+    auto node = std::make_shared<config_node>(private_tag(), value_t::object);
+    node->_members = std::move(members);
+    return node;
+  }
+
+  static auto _make_array(std::vector<ptr> elements) -> ptr {
+    auto node = std::make_shared<config_node>(private_tag(), value_t::array);
+    node->_elements = std::move(elements);
+    return node;
+  }
+
+  static auto _null() -> const config_node& {
+    static const auto null = config_node(private_tag(), nullptr);
+    return null;
+  }
+
+  static auto _patch_error(std::string_view message) -> result<ptr> {
+    return result<ptr>(make_error_code(error::config_patch_failed)).context("{}", message);
+  }
+
+  // Position of the member key, or where it would be inserted, and if it is found
+  auto _find_member(std::string_view key) const -> std::pair<std::size_t, bool> {
+    auto itr = std::ranges::lower_bound(_members, key, {},
+                                        [](const member& item) -> std::string_view {
+                                          return item.first;
+                                        });
+    return {static_cast<std::size_t>(itr - _members.begin()),
+            itr != _members.end() && itr->first == key};
+  }
+
+  // Position of the child named by a token of a JSON pointer, npos if there is none
+  auto _child_index(std::string_view token) const -> std::size_t {
+    if (is_object()) {
+      auto [pos, found] = _find_member(token);
+      return found ? pos : std::string_view::npos;
+    }
+    auto index = detail::config_array_index(token);
+    return index < _elements.size() ? index : std::string_view::npos;
+  }
+
+  auto _child(std::size_t pos) const -> const ptr& {
+    return is_object() ? _members[pos].second : _elements[pos];
+  }
+
+  // Copies of this node with a child replaced, removed or inserted, sharing the other children
+  auto _set_child(std::size_t pos, ptr child) const -> ptr {
+    if (is_object()) {
+      auto members = _members;
+      members[pos].second = std::move(child);
+      return _make_object(std::move(members));
+    }
+    auto elements = _elements;
+    elements[pos] = std::move(child);
+    return _make_array(std::move(elements));
+  }
+
+  auto _erase_child(std::size_t pos) const -> ptr {
+    if (is_object()) {
+      auto members = _members;
+      members.erase(members.begin() + static_cast<std::ptrdiff_t>(pos));
+      return _make_object(std::move(members));
+    }
+    auto elements = _elements;
+    elements.erase(elements.begin() + static_cast<std::ptrdiff_t>(pos));
+    return _make_array(std::move(elements));
+  }
+
+  // Add value at token of this object or array, replacing a member of the same key
+  auto _add_child(const std::string& token, ptr value, std::string_view path) const
+      -> result<ptr> {
+    if (is_object()) {
+      auto [pos, found] = _find_member(token);
+      if (found) {
+        return _set_child(pos, std::move(value));
+      }
+      auto members = _members;
+      members.emplace(members.begin() + static_cast<std::ptrdiff_t>(pos), token, std::move(value));
+      return _make_object(std::move(members));
+    }
+    auto index = token == "-" ? _elements.size() : detail::config_array_index(token);
+    if (!is_array() || index > _elements.size()) {
+      return _patch_error(std::format("no place to add '{}'", path));
+    }
+    auto elements = _elements;
+    elements.insert(elements.begin() + static_cast<std::ptrdiff_t>(index), std::move(value));
+    return _make_array(std::move(elements));
+  }
+
+  // Replace the value at tokens below root by fn(parent, last token), copying the nodes above it
+  template <typename F>
+  static auto _update(const ptr& root, std::span<const std::string> tokens, std::string_view path,
+                      const F& fn) -> result<ptr> {
+    if (tokens.size() == 1) {
+      return fn(*root, tokens.front());
+    }
+    auto pos = root->_child_index(tokens.front());
+    if (pos == std::string_view::npos) {
+      return _patch_error(std::format("path not found '{}'", path));
+    }
+    TRY_ASSIGN(auto child, _update(root->_child(pos), tokens.subspan(1), path, fn));
+    return root->_set_child(pos, std::move(child));
+  }
+
+  static auto _add(const ptr& root, std::span<const std::string> tokens, std::string_view path,
+                   ptr value) -> result<ptr> {
+    if (tokens.empty()) {
+      return value;
+    }
+    return _update(root, tokens, path, [&](const config_node& parent, const std::string& token) {
+      return parent._add_child(token, value, path);
+    });
+  }
+
+  static auto _remove(const ptr& root, std::span<const std::string> tokens, std::string_view path)
+      -> result<ptr> {
+    if (tokens.empty()) {
+      return _patch_error("cannot remove the root");
+    }
+    return _update(root, tokens, path, [&](const config_node& parent, const std::string& token) {
+      auto pos = parent._child_index(token);
+      if (pos == std::string_view::npos) {
+        return _patch_error(std::format("path not found '{}'", path));
+      }
+      return result<ptr>(parent._erase_child(pos));
+    });
+  }
+
+  static auto _replace(const ptr& root, std::span<const std::string> tokens,
+                       std::string_view path, ptr value) -> result<ptr> {
+    if (tokens.empty()) {
+      return value;
+    }
+    return _update(root, tokens, path, [&](const config_node& parent, const std::string& token) {
+      auto pos = parent._child_index(token);
+      if (pos == std::string_view::npos) {
+        return _patch_error(std::format("path not found '{}'", path));
+      }
+      return result<ptr>(parent._set_child(pos, value));
+    });
+  }
+
+  // The value at tokens below root, shared, nullptr if there is none
+  static auto _find(const ptr& root, std::span<const std::string> tokens) -> ptr {
+    auto value = root;
+    for (const auto& token : tokens) {
+      auto pos = value->_child_index(token);
+      if (pos == std::string_view::npos) {
+        return nullptr;
+      }
+      value = value->_child(pos);
+    }
+    return value;
+  }
+
+  static auto _apply(const ptr& root, const nlohmann::json& op) -> result<ptr> {
+    auto get_string = [&](const char* name) -> const std::string* {
+      auto itr = op.is_object() ? op.find(name) : op.end();
+      return itr != op.end() && itr->is_string() ? &itr->get_ref<const std::string&>() : nullptr;
+    };
+    auto invalid = [&] { return _patch_error(std::format("invalid operation {}", op.dump())); };
+    const auto* name = get_string("op");
+    const auto* path = get_string("path");
+    auto tokens = std::vector<std::string>();
+    if (name == nullptr || path == nullptr || !detail::split_config_pointer(*path, tokens)) {
+      return invalid();
+    }
+    if (*name == "remove") {
+      return _remove(root, tokens, *path);
+    }
+    if (*name == "move" || *name == "copy") {
+      const auto* from = get_string("from");
+      auto from_tokens = std::vector<std::string>();
+      if (from == nullptr || !detail::split_config_pointer(*from, from_tokens)) {
+        return invalid();
+      }
+      auto value = _find(root, from_tokens);
+      if (value == nullptr) {
+        return _patch_error(std::format("path not found '{}'", *from));
+      }
+      if (*name == "copy") {
+        return _add(root, tokens, *path, std::move(value));
+      }
+      if (tokens.size() > from_tokens.size()
+          && std::ranges::equal(from_tokens, std::span(tokens).first(from_tokens.size()))) {
+        return _patch_error(std::format("cannot move '{}' into itself", *from));
+      }
+      TRY_ASSIGN(auto removed, _remove(root, from_tokens, *from));
+      return _add(removed, tokens, *path, std::move(value));
+    }
+    auto value = op.is_object() ? op.find("value") : op.end();
+    if (value == op.end()) {
+      return invalid();
+    }
+    if (*name == "add") {
+      return _add(root, tokens, *path, make(*value));
+    }
+    if (*name == "replace") {
+      return _replace(root, tokens, *path, make(*value));
+    }
+    if (*name == "test") {
+      auto current = _find(root, tokens);
+      if (current == nullptr || !(*current == *value)) {
+        return _patch_error(std::format("test failed at '{}'", *path));
+      }
+      return root;
+    }
+    return invalid();
+  }
+
+  value_t _type;
+  nlohmann::json _scalar;  ///< Null for an object or an array
+  std::vector<member> _members;
+  std::vector<ptr> _elements;
+};
+
+}  // namespace ascpp
@@ -0,0 +1,492 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "nlohmann/json.hpp"
+
+#include "storage/config_tree.hpp"
+#include "utils/error.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace ascpp {
+
+namespace detail {
+
+/**
+ * @brief Flat layout of a config view, in the native byte order.
+ *
+ * The buffer starts with a header and every other part is addressed by its offset from the start
+ * of the buffer, so it is used in place wherever it is mapped:
+ *
+ * - a value is a config_view_ref, null and boolean are stored in the ref itself, the others point
+ *   to their data;
+ * - int64, uint64 and double: 8 bytes aligned to 8;
+ * - string: uint32 size followed by the bytes and a '\0';
+ * - array: uint32 count followed by count refs;
+ * - object: uint32 count followed by count entries sorted by the bytes of the keys, each entry is
+ *   the offset of the key string followed by the ref of the value.
+ */
+struct config_view_ref {
+  enum kind : std::uint32_t {
+    null,
+    boolean,
+    integer,
+    unsigned_integer,
+    floating,
+    string,
+    array,
+    object,
+  };
+
+  kind type = null;
+  std::uint32_t data = 0;  ///< Value of boolean, offset of the others
+};
+
+struct config_view_entry {
+  std::uint32_t key;  ///< Offset of the key string
+  config_view_ref value;
+};
+
+struct config_view_header {
+  std::array<char, 4> magic = {'A', 'C', 'F', 'V'};
+  std::uint32_t version = 1;
+  std::uint64_t size = 0;  ///< Size of the whole buffer
+  config_view_ref root;
+};
+
+// Load by memcpy, so that reading the mapping needs no alignment and no object lifetime
+template <typename T>
+  requires std::is_trivially_copyable_v<T>
+inline auto load_view(const char* base, std::size_t offset) -> T {
+  auto value = T();
+  std::memcpy(&value, base + offset, sizeof(T));
+  return value;
+}
+
+}  // namespace detail
+
+/**
+ * @brief A value in a config_view, cheap to copy, valid as long as the view.
+ */
+class config_value {
+ public:
+  using kind = detail::config_view_ref::kind;
+
+  config_value() = default;
+
+  auto type() const -> kind { return _ref.type; }
+
+  auto is_null() const -> bool { return _ref.type == kind::null; }
+
+  auto is_object() const -> bool { return _ref.type == kind::object; }
+
+  auto is_array() const -> bool { return _ref.type == kind::array; }
+
+  /**
+   * @brief Number of the elements of an array or the members of an object, 0 for the others.
+   */
+  auto size() const -> std::size_t {
+    if (_ref.type != kind::array && _ref.type != kind::object) {
+      return 0;
+    }
+    return detail::load_view<std::uint32_t>(_base, _ref.data);
+  }
+
+  /**
+   * @brief Find a member of an object by binary search.
+   */
+  auto find(std::string_view key) const -> result<config_value> {
+    if (_ref.type != kind::object) {
+      return make_error_code(error::config_type_mismatch);
+    }
+    auto low = 0UZ;
+    auto high = size();
+    while (low < high) {
+      auto mid = low + (high - low) / 2;
+      auto entry = _entry(mid);
+      auto cmp = _string(entry.key).compare(key);
+      if (cmp == 0) {
+        return config_value(_base, entry.value);
+      }
+      if (cmp < 0) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return make_error_code(error::config_not_found);
+  }
+
+  /**
+   * @brief Get an element of an array.
+   */
+  auto at(std::size_t index) const -> result<config_value> {
+    if (_ref.type != kind::array) {
+      return make_error_code(error::config_type_mismatch);
+    }
+    if (index >= size()) {
+      return make_error_code(error::config_not_found);
+    }
+    auto offset = _ref.data + sizeof(std::uint32_t) + index * sizeof(detail::config_view_ref);
+    return config_value(_base, detail::load_view<detail::config_view_ref>(_base, offset));
+  }
+
+  /**
+   * @brief Get the value at the JSON pointer relative to this value, e.g. "/server/hosts/0".
+   *
+   * Only the tokens with the escapes "~0" and "~1" are copied to be unescaped.
+   */
+  auto find_pointer(std::string_view pointer) const -> result<config_value> {
+    auto value = *this;
+    auto unescaped = std::string();
+    while (!pointer.empty()) {
+      if (pointer.front() != '/') {
+        return make_error_code(error::INVALID_ARGUMENT);
+      }
+      pointer.remove_prefix(1);
+      auto token = pointer.substr(0, pointer.find('/'));
+      pointer.remove_prefix(token.size());
+      if (value.is_array()) {
+        auto index = 0UZ;
+        auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), index);
+        if (ec != std::errc() || end != token.data() + token.size() || token.empty()) {
+          return make_error_code(error::config_not_found);
+        }
+        TRY_ASSIGN(value, value.at(index));
+      } else if (token.find('~') == std::string_view::npos) {
+        TRY_ASSIGN(value, value.find(token));
+      } else {
+        unescaped.clear();
+        for (auto i = 0UZ; i < token.size(); ++i) {
+          if (token[i] != '~') {
+            unescaped.push_back(token[i]);
+          } else if (i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1')) {
+            unescaped.push_back(token[++i] == '0' ? '~' : '/');
+          } else {
+            return make_error_code(error::INVALID_ARGUMENT);
+          }
+        }
+        TRY_ASSIGN(value, value.find(unescaped));
+      }
+    }
+    return value;
+  }
+
+  /**
+   * @brief Get the value as T, which is bool, an arithmetic type or std::string_view.
+   *
+   * Strings are returned as views into the mapping, numbers are converted like nlohmann::json
+   * does.
+   */
+  template <typename T>
+    requires(std::is_arithmetic_v<T> || std::is_same_v<T, std::string_view>)
+  auto get() const -> result<T> {
+    if constexpr (std::is_same_v<T, bool>) {
+      if (_ref.type != kind::boolean) {
+        return make_error_code(error::config_type_mismatch);
+      }
+      return _ref.data != 0;
+    } else if constexpr (std::is_arithmetic_v<T>) {
+      switch (_ref.type) {
+        case kind::integer:
+          return static_cast<T>(detail::load_view<std::int64_t>(_base, _ref.data));
+        case kind::unsigned_integer:
+          return static_cast<T>(detail::load_view<std::uint64_t>(_base, _ref.data));
+        case kind::floating:
+          return static_cast<T>(detail::load_view<double>(_base, _ref.data));
+        default:
+          return make_error_code(error::config_type_mismatch);
+      }
+    } else {
+      if (_ref.type != kind::string) {
+        return make_error_code(error::config_type_mismatch);
+      }
+      return _string(_ref.data);
+    }
+  }
+
+  /**
+   * @brief Iterate the members of an object as (key, value), or the elements of an array as
+   * ("", value).
+   */
+  template <typename F>
+  auto for_each(F&& fn) const -> void {
+    for (auto i = 0UZ; i < size(); ++i) {
+      if (_ref.type == kind::object) {
+        auto entry = _entry(i);
+        fn(_string(entry.key), config_value(_base, entry.value));
+      } else {
+        fn(std::string_view(), at(i).value());
+      }
+    }
+  }
+
+  /**
+   * @brief Convert back to a DOM, allocates.
+   */
+  auto to_json() const -> nlohmann::json {
+    switch (_ref.type) {
+      case kind::null:
+        return nullptr;
+      case kind::boolean:
+        return _ref.data != 0;
+      case kind::integer:
+        return detail::load_view<std::int64_t>(_base, _ref.data);
+      case kind::unsigned_integer:
+        return detail::load_view<std::uint64_t>(_base, _ref.data);
+      case kind::floating:
+        return detail::load_view<double>(_base, _ref.data);
+      case kind::string:
+        return _string(_ref.data);
+      case kind::array: {
+        auto ret = nlohmann::json::array();
+        for_each([&](std::string_view, config_value value) { ret.push_back(value.to_json()); });
+        return ret;
+      }
+      case kind::object: {
+        auto ret = nlohmann::json::object();
+        for_each([&](std::string_view key, config_value value) {
+          ret.emplace(std::string(key), value.to_json());
+        });
+        return ret;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  friend class config_view;
+
+  config_value(const char* base, detail::config_view_ref ref) : _base(base), _ref(ref) {}
+
+  auto _string(std::uint32_t offset) const -> std::string_view {
+    return {_base + offset + sizeof(std::uint32_t),
+            detail::load_view<std::uint32_t>(_base, offset)};
+  }
+
+  auto _entry(std::size_t index) const -> detail::config_view_entry {
+    auto offset = _ref.data + sizeof(std::uint32_t) + index * sizeof(detail::config_view_entry);
+    return detail::load_view<detail::config_view_entry>(_base, offset);
+  }
+
+  const char* _base = nullptr;
+  detail::config_view_ref _ref;
+};
+
+/**
+ * @brief Read-only config mapped from a file in the flat layout built by build_config_view().
+ *
+ * Lookups search the mapping directly, nothing is deserialized and no DOM is built, and all the
+ * processes mapping the same file share its pages. The file is trusted to be written by
+ * build_config_view(), only its header and size are checked when it is opened.
+ *
+ * A view may also own a buffer in the flat layout, e.g. one copied out of shared memory.
+ */
+class config_view {
+ public:
+  config_view() = default;
+
+  explicit config_view(mapped_file file) : _file(std::move(file)) {}
+
+  explicit config_view(std::string buffer) : _buffer(std::move(buffer)) {}
+
+  /**
+   * @brief Get the root value, null for a view holding no config, e.g. default-constructed.
+   */
+  auto root() const -> config_value {
+    if (_size() < sizeof(detail::config_view_header)) {
+      return {};
+    }
+    auto header = detail::load_view<detail::config_view_header>(_data(), 0);
+    return {_data(), header.root};
+  }
+
+  auto find(std::string_view pointer) const -> result<config_value> {
+    return root().find_pointer(pointer);
+  }
+
+ private:
+  auto _data() const -> const char* {
+    return _file.data() != nullptr ? _file.data() : _buffer.data();
+  }
+
+  auto _size() const -> std::size_t {
+    return _file.data() != nullptr ? _file.size() : _buffer.size();
+  }
+
+  mapped_file _file;
+  std::string _buffer;
+};
+
+namespace detail {
+
+class config_view_builder {
+ public:
+  template <typename Value>
+  auto build(const Value& data) -> std::string {
+    _out.assign(sizeof(config_view_header), '\0');
+    auto header = config_view_header();
+    header.root = _write(data);
+    header.size = _out.size();
+    std::memcpy(_out.data(), &header, sizeof(header));
+    return std::move(_out);
+  }
+
+ private:
+  auto _write(const nlohmann::json& data) -> config_view_ref {
+    using kind = config_view_ref::kind;
+    switch (data.type()) {
+      case nlohmann::json::value_t::boolean:
+        return {kind::boolean, data.get<bool>() ? 1U : 0U};
+      case nlohmann::json::value_t::number_integer:
+        return {kind::integer, _append(data.get<std::int64_t>())};
+      case nlohmann::json::value_t::number_unsigned:
+        return {kind::unsigned_integer, _append(data.get<std::uint64_t>())};
+      case nlohmann::json::value_t::number_float:
+        return {kind::floating, _append(data.get<double>())};
+      case nlohmann::json::value_t::string:
+        return {kind::string, _append_string(data.get_ref<const std::string&>())};
+      case nlohmann::json::value_t::array: {
+        auto offset = _reserve(data.size(), sizeof(config_view_ref));
+        auto i = 0UZ;
+        for (const auto& item : data) {
+          _store(offset + sizeof(std::uint32_t) + i++ * sizeof(config_view_ref), _write(item));
+        }
+        return {kind::array, offset};
+      }
+      case nlohmann::json::value_t::object: {
+        // the members of nlohmann::json are ordered by std::less<std::string>, which compares the
+        // bytes as unsigned char like std::string_view::compare in config_value::find()
+        auto offset = _reserve(data.size(), sizeof(config_view_entry));
+        auto i = 0UZ;
+        for (const auto& [key, value] : data.items()) {
+          auto entry = config_view_entry{_append_string(key), _write(value)};
+          _store(offset + sizeof(std::uint32_t) + i++ * sizeof(config_view_entry), entry);
+        }
+        return {kind::object, offset};
+      }
+      default:
+        return {};
+    }
+  }
+
+  auto _write(const config_node& data) -> config_view_ref {
+    using kind = config_view_ref::kind;
+    if (data.is_array()) {
+      auto offset = _reserve(data.size(), sizeof(config_view_ref));
+      auto i = 0UZ;
+      for (const auto& item : data.elements()) {
+        _store(offset + sizeof(std::uint32_t) + i++ * sizeof(config_view_ref), _write(*item));
+      }
+      return {kind::array, offset};
+    }
+    if (data.is_object()) {
+      // the members of config_node are ordered like those of nlohmann::json
+      auto offset = _reserve(data.size(), sizeof(config_view_entry));
+      auto i = 0UZ;
+      for (const auto& [key, value] : data.members()) {
+        auto entry = config_view_entry{_append_string(key), _write(*value)};
+        _store(offset + sizeof(std::uint32_t) + i++ * sizeof(config_view_entry), entry);
+      }
+      return {kind::object, offset};
+    }
+    return _write(data.scalar());
+  }
+
+  auto _align(std::size_t alignment) -> void {
+    _out.resize((_out.size() + alignment - 1) / alignment * alignment, '\0');
+  }
+
+  template <typename T>
+  auto _append(T value) -> std::uint32_t {
+    _align(alignof(T));
+    auto offset = _offset();
+    _out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    return offset;
+  }
+
+  auto _append_string(std::string_view str) -> std::uint32_t {
+    auto offset = _append(static_cast<std::uint32_t>(str.size()));
+    _out.append(str);
+    _out.push_back('\0');
+    return offset;
+  }
+
+  // Append the count of a container and leave room for its items
+  auto _reserve(std::size_t count, std::size_t item_size) -> std::uint32_t {
+    auto offset = _append(static_cast<std::uint32_t>(count));
+    _out.resize(_out.size() + count * item_size, '\0');
+    return offset;
+  }
+
+  template <typename T>
+  auto _store(std::size_t offset, const T& value) -> void {
+    std::memcpy(_out.data() + offset, &value, sizeof(value));
+  }
+
+  auto _offset() const -> std::uint32_t {
+    if (_out.size() > std::numeric_limits<std::uint32_t>::max()) {
+      throw std::length_error("config is too large for config_view");
+    }
+    return static_cast<std::uint32_t>(_out.size());
+  }
+
+  std::string _out;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Convert a JSON config to the flat layout of config_view.
+ *
+ * @throw std::length_error if the result exceeds 4 GiB
+ */
+inline auto build_config_view(const nlohmann::json& data) -> std::string {
+  return detail::config_view_builder().build(data);
+}
+
+inline auto build_config_view(const config_node& data) -> std::string {
+  return detail::config_view_builder().build(data);
+}
+
+namespace detail {
+
+/**
+ * @brief Check the header of a buffer built by build_config_view().
+ */
+inline auto check_config_view(std::string_view buffer) -> result<void> {
+  if (buffer.size() < sizeof(config_view_header)) {
+    return make_error_code(error::invalid_config_file);
+  }
+  auto header = load_view<config_view_header>(buffer.data(), 0);
+  auto expected = config_view_header();
+  if (header.magic != expected.magic || header.version != expected.version
+      || header.size != buffer.size()) {
+    return make_error_code(error::invalid_config_file);
+  }
+  return {};
+}
+
+}  // namespace detail
+
+/**
+ * @brief Map a file written from build_config_view().
+ */
+inline auto open_config_view(const std::filesystem::path& path) -> result<config_view> {
+  TRY_ASSIGN(auto file, map_file(path));
+  TRY_CHECK(detail::check_config_view(file.view()));
+  return config_view(std::move(file));
+}
+
+}  // namespace ascpp
@@ -1,18 +1,34 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
 #include <expected>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <source_location>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <system_error>
 #include <type_traits>
+#include <vector>
 
 /**
  * @brief Provide std::error_code make_error_code(error_category_derived::errc);
+ *
+ * error_category_derived must be constexpr default constructible, the category object is constant
+ * initialized so make_error_code() does not pay for the guard of a function-local static.
  */
 #define MAKE_ERROR_CODE(error_category_derived)                                   \
   inline auto make_error_code(error_category_derived::errc ec)->std::error_code { \
-    static auto err_cat = error_category_derived();                               \
-    return {ec, err_cat};                                                         \
+    return {ec, ::ascpp::error_category_instance<error_category_derived>};         \
   }
 
 /**
@@ -26,7 +42,39 @@
 
 namespace ascpp {
 
-class error : public std::error_category {
+/**
+ * @brief Base of the error categories whose messages are static strings.
+ */
+class static_error_category : public std::error_category {
+ public:
+  constexpr static_error_category() noexcept = default;
+
+  /**
+   * @brief Get the message of ec without allocation, the returned view must be null-terminated.
+   */
+  virtual auto message_view(int ec) const noexcept -> std::string_view = 0;
+
+  auto message(int ec) const -> std::string override { return std::string(message_view(ec)); }
+};
+
+/**
+ * @brief The constant initialized singleton of an error category.
+ */
+template <typename Category>
+inline constinit const Category error_category_instance{};
+
+/**
+ * @brief Get the message of ec without allocation if its category is a static_error_category,
+ * otherwise return an empty view.
+ */
+inline auto message_view(const std::error_code& ec) noexcept -> std::string_view {
+  if (const auto* cat = dynamic_cast<const static_error_category*>(&ec.category())) {
+    return cat->message_view(ec.value());
+  }
+  return {};
+}
+
+class error : public static_error_category {
  public:
   enum errc {
     no_error,
@@ -35,16 +83,33 @@ class error : public std::error_category {
     set_env_failed,
     codecvt_failed,
     INVALID_ARGUMENT,
-    OUT_OF_RANGE
+    OUT_OF_RANGE,
+    corrupted_log,
+    config_not_found,
+    config_type_mismatch,
+    invalid_config_file,
+    config_out_of_limits,
+    config_patch_failed,
   };
 
   auto name() const noexcept -> const char* override { return "ascpp"; }
 
-  auto message(int ec) const -> std::string override {
-    constexpr auto msg = std::array{
-        "no error",       "get env failed",   "env value is empty", "set env failed",
-        "codecvt failed", "invalid argument", "out of range",
-    };
+  auto message_view(int ec) const noexcept -> std::string_view override {
+    constexpr auto msg = std::to_array<std::string_view>({
+        "no error",
+        "get env failed",
+        "env value is empty",
+        "set env failed",
+        "codecvt failed",
+        "invalid argument",
+        "out of range",
+        "corrupted log data",
+        "config key not found",
+        "config value type mismatch",
+        "invalid config file",
+        "config value out of limits",
+        "config patch failed",
+    });
     if (static_cast<unsigned>(ec) < msg.size()) {
       return msg[ec];
     }
@@ -63,79 +128,658 @@ ERROR_CODE_ENUM(ascpp::error);
  * @brief Try to get the result value if it has value, otherwise return the error to upper.
  *
  */
-#define TRY(...)                    \
-  ({                                \
-    auto _ascpp_res_ = __VA_ARGS__; \
-    if (!_ascpp_res_.has_value()) { \
-      return _ascpp_res_.error();   \
-    }                               \
-    std::move(_ascpp_res_).value(); \
+#define TRY(...)                                 \
+  ({                                             \
+    auto _ascpp_res_ = __VA_ARGS__;              \
+    if (!_ascpp_res_.has_value()) [[unlikely]] { \
+      return std::move(_ascpp_res_).error();     \
+    }                                            \
+    *std::move(_ascpp_res_);                     \
   })
 #endif
 
+#define ASCPP_CONCAT_IMPL(a, b) a##b
+#define ASCPP_CONCAT(a, b)      ASCPP_CONCAT_IMPL(a, b)
+
+/**
+ * @brief Portable form of TRY, declare or assign lhs with the result value if it has value,
+ * otherwise return the error to upper.
+ *
+ * e.g. `TRY_ASSIGN(auto val, get_value());` or `TRY_ASSIGN(obj.field, get_value());`
+ */
+#define TRY_ASSIGN(lhs, ...) \
+  TRY_ASSIGN_IMPL(ASCPP_CONCAT(_ascpp_res_, __COUNTER__), lhs, __VA_ARGS__)
+
+#define TRY_ASSIGN_IMPL(res, lhs, ...)               \
+  auto&& res = __VA_ARGS__;                          \
+  if (!res.has_value()) [[unlikely]] {               \
+    return std::forward<decltype(res)>(res).error(); \
+  }                                                  \
+  lhs = *std::forward<decltype(res)>(res)
+
+/**
+ * @brief Portable form of TRY for the results whose value is discarded, return the error to upper
+ * if there is no value.
+ */
+#define TRY_CHECK(...)                                                     \
+  do {                                                                     \
+    auto&& _ascpp_res_ = __VA_ARGS__;                                      \
+    if (!_ascpp_res_.has_value()) [[unlikely]] {                           \
+      return std::forward<decltype(_ascpp_res_)>(_ascpp_res_).error();     \
+    }                                                                      \
+  } while (false)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ASCPP_COLD __attribute__((cold, noinline))
+#elif defined(_MSC_VER)
+#define ASCPP_COLD __declspec(noinline)
+#else
+#define ASCPP_COLD
+#endif
+
 namespace ascpp {
 
+/**
+ * @brief Exception thrown by result::value() when there is no value.
+ *
+ * The message is only built when what() is called, so throwing costs no string allocation. The
+ * messages of static_error_category are returned without allocation at all.
+ */
 class result_error : public std::runtime_error {
  public:
-  explicit result_error(const std::error_code& ec) : std::runtime_error(ec.message()), ec_(ec) {}
+  explicit result_error(const std::error_code& ec) : std::runtime_error(""), ec_(ec) {}
+
+  auto what() const noexcept -> const char* override try {
+    if (auto msg = message_view(ec_); !msg.empty()) {
+      return msg.data();
+    }
+    if (!what_) {
+      what_ = std::make_shared<const std::string>(ec_.message());
+    }
+    return what_->c_str();
+  } catch (...) {
+    return ec_.category().name();
+  }
 
   auto code() const -> const std::error_code& { return ec_; }
 
  private:
   std::error_code ec_;
+  mutable std::shared_ptr<const std::string> what_;
+};
+
+namespace detail {
+
+[[noreturn]] ASCPP_COLD inline auto throw_result_error(const std::error_code& ec) -> void {
+  throw result_error(ec);
+}
+
+inline constexpr auto max_error_categories = 255UZ;
+
+// Slot i holds the category whose error_id::slot is i + 1, slot 0 is std::system_category()
+inline constinit std::array<std::atomic<const std::error_category*>, max_error_categories>
+    error_category_table{};
+
+inline auto error_category_slot(const std::error_category& cat) -> std::uint32_t {
+  if (cat == std::system_category()) {
+    return 0;
+  }
+  for (auto i = 0UZ; i < error_category_table.size(); ++i) {
+    auto* cur = error_category_table[i].load(std::memory_order_acquire);
+    if (cur == nullptr
+        && error_category_table[i].compare_exchange_strong(cur, &cat, std::memory_order_acq_rel)) {
+      return static_cast<std::uint32_t>(i + 1);
+    }
+    if (*cur == cat) {
+      return static_cast<std::uint32_t>(i + 1);
+    }
+  }
+  throw std::length_error("too many error categories for ascpp::error_id");
+}
+
+// Out of line so that a function returning a compact_result builds it in registers on success
+ASCPP_COLD inline auto make_error_id(int value, const std::error_category& cat, unsigned value_bits)
+    -> std::uint32_t {
+  if (value < -(1 << (value_bits - 1)) || value >= (1 << (value_bits - 1))) {
+    throw std::out_of_range("error value does not fit in ascpp::error_id");
+  }
+  return (error_category_slot(cat) << value_bits)
+         | (static_cast<std::uint32_t>(value) & ((1U << value_bits) - 1));
+}
+
+}  // namespace detail
+
+/**
+ * @brief Compact 32-bit replacement of std::error_code.
+ *
+ * The high 8 bits index a static category table and the low 24 bits store the signed error value,
+ * so a result carrying it is as small as the value itself plus the discriminator.
+ */
+class error_id {
+ public:
+  constexpr error_id() noexcept = default;
+
+  error_id(int value, const std::error_category& cat)
+      : id_(detail::make_error_id(value, cat, value_bits)) {}
+
+  error_id(const std::error_code& ec) : error_id(ec.value(), ec.category()) {}
+
+  template <typename E>
+    requires std::is_error_code_enum_v<E>
+  error_id(E e) : error_id(make_error_code(e)) {}
+
+  auto value() const noexcept -> int {
+    // sign extend the low 24 bits
+    return static_cast<int>(id_ << (32 - value_bits)) >> (32 - value_bits);
+  }
+
+  auto category() const noexcept -> const std::error_category& {
+    auto slot = id_ >> value_bits;
+    if (slot == 0) {
+      return std::system_category();
+    }
+    return *detail::error_category_table[slot - 1].load(std::memory_order_acquire);
+  }
+
+  auto code() const noexcept -> std::error_code { return {value(), category()}; }
+
+  auto message() const -> std::string { return category().message(value()); }
+
+  auto raw() const noexcept -> std::uint32_t { return id_; }
+
+  operator std::error_code() const noexcept { return code(); }
+
+  explicit operator bool() const noexcept { return value() != 0; }
+
+  friend constexpr auto operator==(error_id lhs, error_id rhs) -> bool = default;
+
+  friend auto operator==(error_id lhs, const std::error_code& rhs) -> bool {
+    return lhs.code() == rhs;
+  }
+
+  template <typename E>
+    requires std::is_error_code_enum_v<E>
+  friend auto operator==(error_id lhs, E rhs) -> bool {
+    return lhs.code() == make_error_code(rhs);
+  }
+
+ private:
+  static constexpr auto value_bits = 24U;
+
+  std::uint32_t id_ = 0;
+};
+
+/**
+ * @brief One frame of the context attached to an error while it bubbles up.
+ */
+struct error_context_frame {
+  std::source_location location;
+  std::string_view message;  ///< Owned by the thread-local context arena
+};
+
+/**
+ * @brief Format string of result::context() that also captures the source location of the caller.
+ */
+template <typename... Args>
+struct context_format {
+  template <typename S>
+    requires std::convertible_to<const S&, std::string_view>
+  consteval context_format(const S& fmt,
+                           std::source_location loc = std::source_location::current())
+      : fmt(fmt), loc(loc) {}
+
+  std::format_string<Args...> fmt;
+  std::source_location loc;
+};
+
+namespace detail {
+
+/**
+ * @brief Thread-local storage of the context frames of the error being propagated.
+ *
+ * A trace belongs to one error as it bubbles up through distinct call sites. It restarts when the
+ * error code changes, when a call site already in the trace records context again, i.e. the same
+ * code path failed anew, or when it reaches max_frames. Messages are allocated once each from a
+ * monotonic buffer released on restart, so recording context does not touch the global allocator
+ * until the inline buffer is exhausted.
+ */
+class error_context_arena {
+ public:
+  static constexpr auto max_frames = 32UZ;
+
+  error_context_arena() = default;
+  error_context_arena(error_context_arena&&) = delete;
+  error_context_arena(const error_context_arena&) = delete;
+  auto operator=(error_context_arena&&) -> error_context_arena& = delete;
+  auto operator=(const error_context_arena&) -> error_context_arena& = delete;
+  ~error_context_arena() = default;
+
+  static auto instance() -> error_context_arena& {
+    thread_local auto arena = error_context_arena();
+    return arena;
+  }
+
+  auto push(const std::error_code& ec,
+            const std::source_location& loc,
+            std::string_view fmt,
+            std::format_args args) -> void {
+    if (ec != code_ || size_ == max_frames || contains(loc)) {
+      clear();
+      code_ = ec;
+    }
+    scratch_.clear();
+    std::vformat_to(std::back_inserter(scratch_), fmt, args);
+    auto* data = static_cast<char*>(resource_.allocate(scratch_.size(), alignof(char)));
+    scratch_.copy(data, scratch_.size());
+    frames_[size_++] = {loc, std::string_view(data, scratch_.size())};
+  }
+
+  auto frames(const std::error_code& ec) const -> std::span<const error_context_frame> {
+    if (ec != code_) {
+      return {};
+    }
+    return std::span(frames_.data(), size_);
+  }
+
+  auto clear() -> void {
+    size_ = 0;
+    resource_.release();
+    code_.clear();
+  }
+
+ private:
+  static constexpr auto inline_size = 4096UZ;
+
+  auto contains(const std::source_location& loc) const -> bool {
+    return std::ranges::any_of(std::span(frames_.data(), size_), [&](const auto& frame) {
+      return frame.location.line() == loc.line() && frame.location.column() == loc.column()
+             && std::string_view(frame.location.file_name()) == loc.file_name();
+    });
+  }
+
+  std::array<std::byte, inline_size> buffer_;
+  std::pmr::monotonic_buffer_resource resource_{buffer_.data(), buffer_.size()};
+  std::array<error_context_frame, max_frames> frames_;
+  std::size_t size_ = 0;
+  std::string scratch_;  ///< Reused to format the messages
+  std::error_code code_;
+};
+
+ASCPP_COLD inline auto push_error_context(const std::error_code& ec,
+                                          const std::source_location& loc,
+                                          std::string_view fmt,
+                                          std::format_args args) -> void {
+  error_context_arena::instance().push(ec, loc, fmt, args);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Get the context frames recorded by result::context() on this thread for the error ec,
+ * innermost first. It is empty if ec is not the error being traced.
+ */
+inline auto error_context(const std::error_code& ec) -> std::span<const error_context_frame> {
+  return detail::error_context_arena::instance().frames(ec);
+}
+
+/**
+ * @brief Format the context frames of ec as lines of "file:line: message", innermost first.
+ */
+inline auto format_error_context(const std::error_code& ec) -> std::string {
+  auto ret = std::string();
+  for (const auto& frame : error_context(ec)) {
+    std::format_to(std::back_inserter(ret), "{}:{}: {}\n", frame.location.file_name(),
+                   frame.location.line(), frame.message);
+  }
+  return ret;
+}
+
+/**
+ * @brief Drop the context recorded on this thread, call it once the error has been handled.
+ */
+inline auto clear_error_context() -> void {
+  detail::error_context_arena::instance().clear();
+}
+
+namespace detail {
+
+/**
+ * @brief std::expected held as a member, the base of compact_result.
+ *
+ * The constructors of a base class subobject must not write its tail padding, which a derived
+ * class may reuse, so GCC builds a result_impl deriving from a small std::expected field by field
+ * in memory, then reloads it as a whole to return it in a register, which stalls on the store
+ * forwarding. Held as a member, the std::expected is a complete object built in registers.
+ */
+template <typename T, typename E>
+class compact_expected {
+  using impl_type = std::expected<T, E>;
+
+ public:
+  using value_type = T;
+  using error_type = E;
+  using unexpected_type = std::unexpected<E>;
+
+  constexpr compact_expected() = default;
+
+  template <typename U>
+    requires(!std::is_same_v<std::remove_cvref_t<U>, compact_expected>
+             && std::is_constructible_v<impl_type, U>)
+  constexpr explicit(!std::is_convertible_v<U, impl_type>) compact_expected(U&& arg)
+      : _impl(std::forward<U>(arg)) {}
+
+  template <typename Tag, typename Arg, typename... Args>
+    requires((std::is_same_v<Tag, std::in_place_t> || std::is_same_v<Tag, std::unexpect_t>)
+             && std::is_constructible_v<impl_type, Tag, Arg, Args...>)
+  constexpr explicit compact_expected(Tag tag, Arg&& arg, Args&&... args)
+      : _impl(tag, std::forward<Arg>(arg), std::forward<Args>(args)...) {}
+
+  template <typename U>
+    requires(!std::is_same_v<std::remove_cvref_t<U>, compact_expected>
+             && std::is_assignable_v<impl_type&, U>)
+  constexpr auto operator=(U&& arg) -> compact_expected& {
+    _impl = std::forward<U>(arg);
+    return *this;
+  }
+
+  constexpr auto has_value() const noexcept -> bool { return _impl.has_value(); }
+  constexpr explicit operator bool() const noexcept { return _impl.has_value(); }
+
+  constexpr auto operator->() noexcept { return _impl.operator->(); }
+  constexpr auto operator->() const noexcept { return _impl.operator->(); }
+  constexpr auto operator*() & noexcept -> decltype(auto) { return *_impl; }
+  constexpr auto operator*() const& noexcept -> decltype(auto) { return *_impl; }
+  constexpr auto operator*() && noexcept -> decltype(auto) { return *std::move(_impl); }
+  constexpr auto operator*() const&& noexcept -> decltype(auto) { return *std::move(_impl); }
+
+  constexpr auto value() & -> decltype(auto) { return _impl.value(); }
+  constexpr auto value() const& -> decltype(auto) { return _impl.value(); }
+  constexpr auto value() && -> decltype(auto) { return std::move(_impl).value(); }
+  constexpr auto value() const&& -> decltype(auto) { return std::move(_impl).value(); }
+
+  constexpr auto error() & noexcept -> E& { return _impl.error(); }
+  constexpr auto error() const& noexcept -> const E& { return _impl.error(); }
+  constexpr auto error() && noexcept -> E&& { return std::move(_impl).error(); }
+  constexpr auto error() const&& noexcept -> const E&& { return std::move(_impl).error(); }
+
+  template <typename U>
+  constexpr auto value_or(U&& other) const& {
+    return _impl.value_or(std::forward<U>(other));
+  }
+
+  template <typename U>
+  constexpr auto value_or(U&& other) && {
+    return std::move(_impl).value_or(std::forward<U>(other));
+  }
+
+  template <typename... Args>
+  constexpr auto emplace(Args&&... args) noexcept(std::is_void_v<T>
+                                                  || std::is_nothrow_constructible_v<T, Args...>)
+      -> decltype(auto) {
+    return _impl.emplace(std::forward<Args>(args)...);
+  }
+
+  template <typename F>
+  constexpr auto transform(F&& fn) const& {
+    return _impl.transform(std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto transform(F&& fn) && {
+    return std::move(_impl).transform(std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto or_else(F&& fn) const& {
+    return _impl.or_else(std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto or_else(F&& fn) && {
+    return std::move(_impl).or_else(std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto transform_error(F&& fn) const& {
+    return _impl.transform_error(std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto transform_error(F&& fn) && {
+    return std::move(_impl).transform_error(std::forward<F>(fn));
+  }
+
+  template <typename T2, typename E2>
+  friend constexpr auto operator==(const compact_expected& x, const compact_expected<T2, E2>& y)
+      -> bool {
+    return x._impl == y._impl;
+  }
+
+  template <typename E2>
+  friend constexpr auto operator==(const compact_expected& x, const std::unexpected<E2>& e)
+      -> bool {
+    return x._impl == e;
+  }
+
+  template <typename T2>
+    requires(!std::is_void_v<T> && !requires(const T2& y) { unwrap_expected(y); })
+  friend constexpr auto operator==(const compact_expected& x, const T2& val) -> bool {
+    return x._impl == val;
+  }
+
+ private:
+  template <typename, typename>
+  friend class compact_expected;
+
+  friend constexpr auto unwrap_expected(const compact_expected& x) -> const impl_type& {
+    return x._impl;
+  }
+
+  friend constexpr auto unwrap_expected(compact_expected&& x) -> impl_type&& {
+    return std::move(x._impl);
+  }
+
+  impl_type _impl;
+};
+
+// Error type of Base without instantiating std::expected, so that result<T> can be named while T
+// is still incomplete, e.g. as the return type of a member function of T
+template <typename Base>
+struct expected_error {
+  using type = typename Base::error_type;
+};
+
+template <typename T, typename E>
+struct expected_error<std::expected<T, E>> {
+  using type = E;
+};
+
+template <typename T, typename E>
+struct expected_error<compact_expected<T, E>> {
+  using type = E;
 };
 
+/// Base of the result of U with the error type E, compact_expected for error_id
+template <typename U, typename E>
+using expected_base
+    = std::conditional_t<std::is_same_v<E, error_id>, compact_expected<U, E>, std::expected<U, E>>;
+
+}  // namespace detail
+
+template <typename T, typename Base>
+  requires(!std::is_same_v<T, typename detail::expected_error<Base>::type>)
+class result_impl;
+
+template <typename T>
+inline constexpr bool is_result_v = false;
+
+template <typename T, typename Base>
+inline constexpr bool is_result_v<result_impl<T, Base>> = true;
+
+namespace detail {
+
+// Wrap the return value of fn into a result, results returned by fn are passed through.
+template <typename E, typename F, typename... Args>
+constexpr auto invoke_to_result(F&& fn, Args&&... args) {
+  using ret_type = std::remove_cvref_t<std::invoke_result_t<F, Args...>>;
+  if constexpr (is_result_v<ret_type>) {
+    return std::invoke(std::forward<F>(fn), std::forward<Args>(args)...);
+  } else if constexpr (std::is_void_v<ret_type>) {
+    std::invoke(std::forward<F>(fn), std::forward<Args>(args)...);
+    return result_impl<void, expected_base<void, E>>();
+  } else {
+    return result_impl<ret_type, expected_base<ret_type, E>>(
+        std::invoke(std::forward<F>(fn), std::forward<Args>(args)...));
+  }
+}
+
+template <typename E, typename F, typename... Args>
+using invoke_to_result_t
+    = decltype(invoke_to_result<E>(std::declval<F>(), std::declval<Args>()...));
+
+}  // namespace detail
+
 template <typename T, typename Base>
-  requires(!std::is_same_v<T, std::error_code>)
+  requires(!std::is_same_v<T, typename detail::expected_error<Base>::type>)
 class [[nodiscard]] result_impl : public Base {
   template <typename U>
-  using result = result_impl<U, std::expected<U, std::error_code>>;
+  using rebind = result_impl<U, detail::expected_base<U, typename Base::error_type>>;
 
  public:
   using base_type = Base;
+  using error_type = typename Base::error_type;
   using Base::Base;
 
-  result_impl(const std::error_code& ec) : Base(std::unexpected(ec)) {}
+  // Taken by value so that they are preferred to the converting constructor of Base, which would
+  // otherwise construct a value from an rvalue error, e.g. result<bool> from std::error_code.
+  result_impl(error_type ec) : Base(std::unexpected(ec)) {}
+
+  result_impl(std::error_code ec)
+    requires(!std::is_same_v<error_type, std::error_code>)
+      : Base(std::unexpected(error_type(ec))) {}
 
-  auto operator=(const std::error_code& ec) -> result_impl& {
+  // From a compact_result, e.g. result<T> from compact_result<T>
+  template <typename U, typename E>
+    requires std::is_constructible_v<Base, const std::expected<U, E>&>
+  explicit(!std::is_convertible_v<const std::expected<U, E>&, Base>)
+      result_impl(const detail::compact_expected<U, E>& other)
+      : Base(unwrap_expected(other)) {}
+
+  auto operator=(error_type ec) -> result_impl& {
     Base::operator=(std::unexpected(ec));
     return *this;
   }
 
+  auto operator=(std::error_code ec) -> result_impl&
+    requires(!std::is_same_v<error_type, std::error_code>)
+  {
+    Base::operator=(std::unexpected(error_type(ec)));
+    return *this;
+  }
+
   [[nodiscard]] auto value() & -> T& {
-    if (!this->has_value()) {
-      throw result_error(this->error());
+    if (this->has_value()) [[likely]] {
+      return **this;
     }
-    return static_cast<Base&>(*this).value();
+    detail::throw_result_error(this->error());
   }
 
   [[nodiscard]] auto value() const& -> const T& {
-    if (!this->has_value()) {
-      throw result_error(this->error());
+    if (this->has_value()) [[likely]] {
+      return **this;
     }
-    return static_cast<const Base&>(*this).value();
+    detail::throw_result_error(this->error());
   }
 
   [[nodiscard]] auto value() && -> T&& {
-    if (!this->has_value()) {
-      throw result_error(this->error());
+    if (this->has_value()) [[likely]] {
+      return std::move(**this);
     }
-    return static_cast<Base&&>(*this).value();
+    detail::throw_result_error(this->error());
   }
 
   [[nodiscard]] auto value() const&& -> const T&& {
-    if (!this->has_value()) {
-      throw result_error(this->error());
+    if (this->has_value()) [[likely]] {
+      return std::move(**this);
     }
-    return static_cast<const Base&&>(*this).value();
+    detail::throw_result_error(this->error());
   }
 
   auto operator->() const noexcept -> const T* = delete;
 
+  /**
+   * @brief Transform the value by fn if there is one, otherwise propagate the error.
+   *
+   * @return result<U> where U is the return type of fn
+   */
+  template <typename F>
+  constexpr auto map(F&& fn) const&
+      -> rebind<std::remove_cvref_t<std::invoke_result_t<F, const T&>>> {
+    if (this->has_value()) [[likely]] {
+      return _invoke_value(std::forward<F>(fn), **this);
+    }
+    return this->error();
+  }
+
+  template <typename F>
+  constexpr auto map(F&& fn) && -> rebind<std::remove_cvref_t<std::invoke_result_t<F, T&&>>> {
+    if (this->has_value()) [[likely]] {
+      return _invoke_value(std::forward<F>(fn), std::move(**this));
+    }
+    return std::move(this->error());
+  }
+
+  /**
+   * @brief Invoke fn, which returns a result itself, with the value if there is one, otherwise
+   * propagate the error.
+   */
+  template <typename F>
+    requires is_result_v<std::remove_cvref_t<std::invoke_result_t<F, const T&>>>
+  constexpr auto and_then(F&& fn) const&
+      -> std::remove_cvref_t<std::invoke_result_t<F, const T&>> {
+    if (this->has_value()) [[likely]] {
+      return std::invoke(std::forward<F>(fn), **this);
+    }
+    return this->error();
+  }
+
+  template <typename F>
+    requires is_result_v<std::remove_cvref_t<std::invoke_result_t<F, T&&>>>
+  constexpr auto and_then(F&& fn) && -> std::remove_cvref_t<std::invoke_result_t<F, T&&>> {
+    if (this->has_value()) [[likely]] {
+      return std::invoke(std::forward<F>(fn), std::move(**this));
+    }
+    return std::move(this->error());
+  }
+
+  /**
+   * @brief Attach a formatted message and the caller location to the error, does nothing but a
+   * has_value test if there is no error.
+   */
+  template <typename... Args>
+  auto context(context_format<std::type_identity_t<Args>...> fmt, Args&&... args) &
+      -> result_impl& {
+    if (!this->has_value()) [[unlikely]] {
+      detail::push_error_context(this->error(), fmt.loc, fmt.fmt.get(),
+                                 std::make_format_args(args...));
+    }
+    return *this;
+  }
+
+  template <typename... Args>
+  auto context(context_format<std::type_identity_t<Args>...> fmt, Args&&... args) &&
+      -> result_impl&& {
+    if (!this->has_value()) [[unlikely]] {
+      detail::push_error_context(this->error(), fmt.loc, fmt.fmt.get(),
+                                 std::make_format_args(args...));
+    }
+    return std::move(*this);
+  }
+
   template <class T2>
-  friend constexpr auto operator==(const result_impl& lhs, const result<T2>& rhs) -> bool {
+  friend constexpr auto operator==(const result_impl& lhs, const rebind<T2>& rhs) -> bool {
     return static_cast<const base_type&>(lhs)
-           == static_cast<const typename result<T2>::base_type&>(rhs);
+           == static_cast<const typename rebind<T2>::base_type&>(rhs);
   }
 
   template <class T2>
@@ -143,6 +787,20 @@ class [[nodiscard]] result_impl : public Base {
     return static_cast<const base_type&>(x) == val;
   }
 
+ private:
+  template <typename F, typename V>
+  static constexpr auto _invoke_value(F&& fn, V&& val)
+      -> rebind<std::remove_cvref_t<std::invoke_result_t<F, V>>> {
+    if constexpr (std::is_void_v<std::invoke_result_t<F, V>>) {
+      std::invoke(std::forward<F>(fn), std::forward<V>(val));
+      return {};
+    } else {
+      return std::invoke(std::forward<F>(fn), std::forward<V>(val));
+    }
+  }
+
+ public:
+
   template <class E2>
   friend constexpr auto operator==(const result_impl& x, const std::unexpected<E2>& e) -> bool {
     return static_cast<const base_type&>(x) == e;
@@ -160,17 +818,31 @@ class [[nodiscard]] result_impl : public Base {
 template <typename Base>
 class [[nodiscard]] result_impl<void, Base> : public Base {
   template <typename U>
-  using result = result_impl<U, std::expected<U, std::error_code>>;
+  using rebind = result_impl<U, detail::expected_base<U, typename Base::error_type>>;
 
  public:
   using base_type = Base;
+  using error_type = typename Base::error_type;
   using Base::Base;
 
-  result_impl(const std::error_code& ec) : Base(std::unexpected(ec)) {}
+  // Taken by value so that they are preferred to the converting constructor of Base, which would
+  // otherwise construct a value from an rvalue error, e.g. result<bool> from std::error_code.
+  result_impl(error_type ec) : Base(std::unexpected(ec)) {}
+
+  result_impl(std::error_code ec)
+    requires(!std::is_same_v<error_type, std::error_code>)
+      : Base(std::unexpected(error_type(ec))) {}
+
+  // From a compact_result, e.g. result<T> from compact_result<T>
+  template <typename U, typename E>
+    requires std::is_constructible_v<Base, const std::expected<U, E>&>
+  explicit(!std::is_convertible_v<const std::expected<U, E>&, Base>)
+      result_impl(const detail::compact_expected<U, E>& other)
+      : Base(unwrap_expected(other)) {}
 
   template <typename U>
-  explicit result_impl(const result<U>& other) {
-    if (other.has_value()) {
+  explicit result_impl(const rebind<U>& other) {
+    if (other.has_value()) [[likely]] {
       Base::emplace();
     } else {
       Base::operator=(std::unexpected(other.error()));
@@ -178,22 +850,29 @@ class [[nodiscard]] result_impl<void, Base> : public Base {
   }
 
   template <typename U>
-  explicit result_impl(result<U>&& other) {
-    if (other.has_value()) {
+  explicit result_impl(rebind<U>&& other) {
+    if (other.has_value()) [[likely]] {
       Base::emplace();
     } else {
       Base::operator=(std::unexpected(std::move(other.error())));
     }
   }
 
-  auto operator=(const std::error_code& ec) -> result_impl& {
+  auto operator=(error_type ec) -> result_impl& {
     Base::operator=(std::unexpected(ec));
     return *this;
   }
 
+  auto operator=(std::error_code ec) -> result_impl&
+    requires(!std::is_same_v<error_type, std::error_code>)
+  {
+    Base::operator=(std::unexpected(error_type(ec)));
+    return *this;
+  }
+
   template <typename U>
-  auto operator=(const result<U>& other) -> result_impl& {
-    if (other.has_value()) {
+  auto operator=(const rebind<U>& other) -> result_impl& {
+    if (other.has_value()) [[likely]] {
       Base::emplace();
     } else {
       Base::operator=(std::unexpected(other.error()));
@@ -202,8 +881,8 @@ class [[nodiscard]] result_impl<void, Base> : public Base {
   }
 
   template <typename U>
-  auto operator=(result<U>&& other) -> result_impl& {
-    if (other.has_value()) {
+  auto operator=(rebind<U>&& other) -> result_impl& {
+    if (other.has_value()) [[likely]] {
       Base::emplace();
     } else {
       Base::operator=(std::unexpected(std::move(other.error())));
@@ -212,23 +891,76 @@ class [[nodiscard]] result_impl<void, Base> : public Base {
   }
 
   auto value() const& -> void {
-    if (!this->has_value()) {
-      throw result_error(this->error());
+    if (!this->has_value()) [[unlikely]] {
+      detail::throw_result_error(this->error());
     }
-    return static_cast<const Base&>(*this).value();
   }
 
   auto value() const&& -> void {
-    if (!this->has_value()) {
-      throw result_error(this->error());
+    if (!this->has_value()) [[unlikely]] {
+      detail::throw_result_error(this->error());
+    }
+  }
+
+  /**
+   * @brief Invoke fn if there is no error, otherwise propagate the error.
+   *
+   * @return result<U> where U is the return type of fn
+   */
+  template <typename F>
+  constexpr auto map(F&& fn) const -> rebind<std::remove_cvref_t<std::invoke_result_t<F>>> {
+    if (this->has_value()) [[likely]] {
+      if constexpr (std::is_void_v<std::invoke_result_t<F>>) {
+        std::invoke(std::forward<F>(fn));
+        return {};
+      } else {
+        return std::invoke(std::forward<F>(fn));
+      }
+    }
+    return this->error();
+  }
+
+  /**
+   * @brief Invoke fn, which returns a result itself, if there is no error, otherwise propagate the
+   * error.
+   */
+  template <typename F>
+    requires is_result_v<std::remove_cvref_t<std::invoke_result_t<F>>>
+  constexpr auto and_then(F&& fn) const -> std::remove_cvref_t<std::invoke_result_t<F>> {
+    if (this->has_value()) [[likely]] {
+      return std::invoke(std::forward<F>(fn));
+    }
+    return this->error();
+  }
+
+  /**
+   * @brief Attach a formatted message and the caller location to the error, does nothing but a
+   * has_value test if there is no error.
+   */
+  template <typename... Args>
+  auto context(context_format<std::type_identity_t<Args>...> fmt, Args&&... args) &
+      -> result_impl& {
+    if (!this->has_value()) [[unlikely]] {
+      detail::push_error_context(this->error(), fmt.loc, fmt.fmt.get(),
+                                 std::make_format_args(args...));
     }
-    return static_cast<const Base&&>(*this).value();
+    return *this;
+  }
+
+  template <typename... Args>
+  auto context(context_format<std::type_identity_t<Args>...> fmt, Args&&... args) &&
+      -> result_impl&& {
+    if (!this->has_value()) [[unlikely]] {
+      detail::push_error_context(this->error(), fmt.loc, fmt.fmt.get(),
+                                 std::make_format_args(args...));
+    }
+    return std::move(*this);
   }
 
   template <class T2>
-  friend constexpr auto operator==(const result_impl& lhs, const result<T2>& rhs) -> bool {
+  friend constexpr auto operator==(const result_impl& lhs, const rebind<T2>& rhs) -> bool {
     return static_cast<const base_type&>(lhs)
-           == static_cast<const typename result<T2>::base_type&>(rhs);
+           == static_cast<const typename rebind<T2>::base_type&>(rhs);
   }
 
   template <class E2>
@@ -253,4 +985,37 @@ class [[nodiscard]] result_impl<void, Base> : public Base {
 template <typename T>
 using result = result_impl<T, std::expected<T, std::error_code>>;
 
+/**
+ * @brief Same as result<T> but carry an error_id instead of std::error_code, use it on hot paths
+ * where the size of the result matters.
+ *
+ * @tparam T result value type
+ */
+template <typename T>
+using compact_result = result_impl<T, detail::compact_expected<T, error_id>>;
+
+/**
+ * @brief Invoke fn with the values of all results if all of them have value, otherwise return the
+ * first error. The value returned by fn is wrapped into a result unless it is a result already.
+ *
+ * This is the branch-only alternative to TRY: each argument costs a single has_value test.
+ */
+template <typename F, typename R, typename... Rs>
+  requires(is_result_v<std::remove_cvref_t<R>> && (is_result_v<std::remove_cvref_t<Rs>> && ...))
+constexpr auto try_invoke(F&& fn, R&& res, Rs&&... results) -> detail::invoke_to_result_t<
+    typename std::remove_cvref_t<R>::error_type,
+    F,
+    decltype(*std::forward<R>(res)),
+    decltype(*std::forward<Rs>(results))...> {
+  using error_type = typename std::remove_cvref_t<R>::error_type;
+  if (res.has_value() && (results.has_value() && ...)) [[likely]] {
+    return detail::invoke_to_result<error_type>(std::forward<F>(fn), *std::forward<R>(res),
+                                                *std::forward<Rs>(results)...);
+  }
+  auto err = error_type();
+  ((!res.has_value() && (err = res.error(), true))
+   || ((!results.has_value() && (err = results.error(), true)) || ...));
+  return err;
+}
+
 }  // namespace ascpp
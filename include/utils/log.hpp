@@ -1,12 +1,549 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include "app/info.hpp"
 
+/**
+ * @brief Minimum level compiled into the program, 0 to 5 stand for TRACE to FATAL.
+ *
+ * Statements below it written with the ASCPP_LOG macros are discarded at compile time, their
+ * arguments are neither evaluated nor copied.
+ */
+#ifndef ASCPP_LOG_MIN_LEVEL
+#define ASCPP_LOG_MIN_LEVEL 0
+#endif
+
+/**
+ * @brief Log through the logger lg if lvl passes both the compile-time and the runtime minimum
+ * level. The arguments are evaluated only when the statement is logged.
+ *
+ * @code
+ * ASCPP_LOG(log, DEBUG, "request {} took {} us", id, elapsed);
+ * @endcode
+ */
+#define ASCPP_LOG(lg, lvl, ...)                                                   \
+  do {                                                                            \
+    if constexpr (::ascpp::logger::lvl >= ASCPP_LOG_MIN_LEVEL) {                  \
+      if (auto& ascpp_log_ = (lg); ascpp_log_.enabled(::ascpp::logger::lvl)) {    \
+        ascpp_log_.write(::ascpp::logger::lvl, __VA_ARGS__);                      \
+      }                                                                           \
+    }                                                                             \
+  } while (false)
+
+/**
+ * @brief Log at most count records per interval from this call site, e.g. on a hot error path.
+ *
+ * The state of the limit is a static slot of the call site, checked by a couple of atomic
+ * operations. The number of suppressed records is reported by "last message repeated N times"
+ * before the next record logged.
+ *
+ * @code
+ * ASCPP_LOG_LIMIT(log, WARN, 10, std::chrono::seconds(1), "invalid option {}", name);
+ * @endcode
+ */
+#define ASCPP_LOG_LIMIT(lg, lvl, count, interval, ...)                                       \
+  do {                                                                                       \
+    if constexpr (::ascpp::logger::lvl >= ASCPP_LOG_MIN_LEVEL) {                             \
+      static constinit auto ascpp_limiter_ = ::ascpp::detail::log_rate_limiter();            \
+      if (auto& ascpp_log_ = (lg); ascpp_log_.enabled(::ascpp::logger::lvl)                  \
+                                   && ascpp_limiter_.try_acquire(count, interval)) {         \
+        if (auto ascpp_repeated_ = ascpp_limiter_.take_suppressed(); ascpp_repeated_ != 0) { \
+          ascpp_log_.write(::ascpp::logger::lvl, "last message repeated {} times",           \
+                           ascpp_repeated_);                                                 \
+        }                                                                                    \
+        ascpp_log_.write(::ascpp::logger::lvl, __VA_ARGS__);                                 \
+      }                                                                                      \
+    }                                                                                        \
+  } while (false)
+
+/**
+ * @brief Log at most one record per interval from this call site.
+ */
+#define ASCPP_LOG_EVERY(lg, lvl, interval, ...) ASCPP_LOG_LIMIT(lg, lvl, 1, interval, __VA_ARGS__)
+
+#define ASCPP_LOG_TRACE(lg, ...) ASCPP_LOG(lg, TRACE, __VA_ARGS__)
+#define ASCPP_LOG_DEBUG(lg, ...) ASCPP_LOG(lg, DEBUG, __VA_ARGS__)
+#define ASCPP_LOG_INFO(lg, ...) ASCPP_LOG(lg, INFO, __VA_ARGS__)
+#define ASCPP_LOG_WARN(lg, ...) ASCPP_LOG(lg, WARN, __VA_ARGS__)
+#define ASCPP_LOG_ERROR(lg, ...) ASCPP_LOG(lg, ERROR, __VA_ARGS__)
+#define ASCPP_LOG_FATAL(lg, ...) ASCPP_LOG(lg, FATAL, __VA_ARGS__)
+
+namespace ascpp {
+
+class logger;
+class log_sink;
+
+/**
+ * @brief What a log call does when the ring buffer of its thread is full.
+ */
+enum class log_overflow_policy : std::uint8_t {
+  block,        ///< Wait for the background thread to make room, never lose a record
+  drop_newest,  ///< Drop the record being logged
+  drop_oldest,  ///< Overwrite the oldest record in the ring
+  sample,       ///< Once the ring is half full, keep only one record out of sample_rate
+};
+
+namespace detail {
+
+class log_core;
+
+/**
+ * @brief Type of a packed argument, used to encode it without the C++ type. Integers are tagged
+ * with their size, arguments of other types can only be formatted in process.
+ */
+enum class log_arg_type : std::uint8_t {
+  other,
+  boolean,
+  character,
+  int8,
+  int16,
+  int32,
+  int64,
+  uint8,
+  uint16,
+  uint32,
+  uint64,
+  float32,
+  float64,
+  string,
+};
+
+/**
+ * @brief Type erased functions to decode the arguments packed by a log call.
+ */
+struct log_codec {
+  /// Append the message formatted from fmt and the packed arguments to out
+  void (*format)(std::string& out, std::string_view fmt, const std::byte* args);
+  const log_arg_type* arg_types;
+  std::uint32_t arg_count;
+};
+
+/**
+ * @brief Fixed-size binary record written by the producer thread into its ring buffer.
+ *
+ * Only the pointer to the format string is stored, so the format string must have static storage
+ * duration, which is always the case for string literals.
+ */
+struct log_record {
+  static constexpr auto size = 256UZ;
+  static constexpr auto header_size = 32UZ;
+
+  const log_codec* codec;
+  const char* fmt;
+  std::uint32_t fmt_size;
+  std::uint8_t level;
+  std::int64_t timestamp;  ///< Nanoseconds since the epoch of std::chrono::system_clock
+  std::array<std::byte, size - header_size> args;
+};
+
+static_assert(sizeof(log_record) == log_record::size);
+static_assert(std::is_trivially_copyable_v<log_record>);
+
+template <typename T>
+concept log_string_arg = std::is_convertible_v<const T&, std::string_view>;
+
+/// Type of the argument decoded by the consumer, strings are decoded as views of the record
+template <typename T>
+using log_view_t = std::conditional_t<log_string_arg<T>, std::string_view, T>;
+
+template <typename T>
+constexpr auto log_fixed_size() -> std::size_t {
+  if constexpr (log_string_arg<T>) {
+    return sizeof(std::uint32_t);
+  } else {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "log arguments must be strings or trivially copyable, they are copied by value");
+    return sizeof(T);
+  }
+}
+
+/**
+ * @brief Sequentially pack the arguments of a log call into the args of a log_record. Strings are
+ * stored as length-prefixed characters and truncated to the space left by the other arguments, at
+ * a UTF-8 code point boundary and followed by "…".
+ */
+class log_writer {
+ public:
+  log_writer(std::byte* data, std::size_t size) : _data(data), _size(size) {}
+
+  template <typename... Args>
+  auto write(const Args&... args) -> void {
+    constexpr auto fixed_size = (log_fixed_size<Args>() + ... + 0UZ);
+    static_assert(fixed_size <= log_record::size - log_record::header_size,
+                  "log arguments too large for a log record, log a string or fewer arguments");
+    [[maybe_unused]] auto reserved = fixed_size;
+    (_write(args, reserved), ...);
+  }
+
+ private:
+  template <typename T>
+  auto _write(const T& arg, std::size_t& reserved) -> void {
+    reserved -= log_fixed_size<T>();
+    if constexpr (log_string_arg<T>) {
+      auto str = std::string_view(arg);
+      // the fixed sizes fit in a record, but a buffer smaller than a record may have no room left
+      auto used = _pos + sizeof(std::uint32_t) + reserved;
+      auto budget = _size - std::min(used, _size);
+      auto len = std::min(str.size(), budget);
+      auto mark = 0UZ;
+      if (len < str.size()) {
+        // cut at a code point boundary and mark the cut if there is room for it
+        mark = budget >= truncated_mark.size() ? truncated_mark.size() : 0;
+        len = budget - mark;
+        while (len > 0 && (static_cast<unsigned char>(str[len]) & 0xC0) == 0x80) {
+          --len;
+        }
+      }
+      auto size = static_cast<std::uint32_t>(len + mark);
+      std::memcpy(_data + _pos, &size, sizeof(size));
+      std::memcpy(_data + _pos + sizeof(size), str.data(), len);
+      std::memcpy(_data + _pos + sizeof(size) + len, truncated_mark.data(), mark);
+      _pos += sizeof(size) + size;
+    } else {
+      std::memcpy(_data + _pos, &arg, sizeof(T));
+      _pos += sizeof(T);
+    }
+  }
+
+  static constexpr auto truncated_mark = std::string_view("\xE2\x80\xA6");  // "…" in UTF-8
+
+  std::byte* _data;
+  std::size_t _size;
+  std::size_t _pos = 0;
+};
+
+/**
+ * @brief Read back the arguments packed by log_writer.
+ */
+class log_reader {
+ public:
+  explicit log_reader(const std::byte* data) : _data(data) {}
+
+  template <typename T>
+  auto read() -> log_view_t<T> {
+    if constexpr (log_string_arg<T>) {
+      auto len = std::uint32_t();
+      std::memcpy(&len, _data + _pos, sizeof(len));
+      auto str = std::string_view(reinterpret_cast<const char*>(_data + _pos + sizeof(len)), len);
+      _pos += sizeof(len) + len;
+      return str;
+    } else {
+      auto value = T();
+      std::memcpy(&value, _data + _pos, sizeof(T));
+      _pos += sizeof(T);
+      return value;
+    }
+  }
+
+ private:
+  const std::byte* _data;
+  std::size_t _pos = 0;
+};
+
+template <typename... Args>
+auto format_log_args(std::string& out, std::string_view fmt, const std::byte* args) -> void {
+  [[maybe_unused]] auto reader = log_reader(args);
+  // braced initialization guarantees the left to right order of evaluation
+  auto values = std::tuple<log_view_t<Args>...>{reader.read<Args>()...};
+  std::apply(
+      [&](auto&... vals) {
+        std::vformat_to(std::back_inserter(out), fmt, std::make_format_args(vals...));
+      },
+      values);
+}
+
+template <typename T>
+constexpr auto get_log_arg_type() -> log_arg_type {
+  if constexpr (log_string_arg<T>) {
+    return log_arg_type::string;
+  } else if constexpr (std::is_same_v<T, bool>) {
+    return log_arg_type::boolean;
+  } else if constexpr (std::is_same_v<T, char>) {
+    return log_arg_type::character;
+  } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T> && sizeof(T) <= 8) {
+    constexpr auto types = std::to_array(
+        {log_arg_type::int8, log_arg_type::int16, log_arg_type::int32, log_arg_type::int64});
+    return types[std::countr_zero(sizeof(T))];
+  } else if constexpr (std::is_integral_v<T> && sizeof(T) <= 8) {
+    constexpr auto types = std::to_array(
+        {log_arg_type::uint8, log_arg_type::uint16, log_arg_type::uint32, log_arg_type::uint64});
+    return types[std::countr_zero(sizeof(T))];
+  } else if constexpr (std::is_same_v<T, float>) {
+    return log_arg_type::float32;
+  } else if constexpr (std::is_same_v<T, double>) {
+    return log_arg_type::float64;
+  } else {
+    return log_arg_type::other;
+  }
+}
+
+template <typename... Args>
+inline constexpr auto log_arg_types_v = std::array<log_arg_type, sizeof...(Args)>{
+    get_log_arg_type<Args>()...};
+
+template <typename... Args>
+inline constexpr auto log_codec_v = log_codec{
+    &format_log_args<Args...>, log_arg_types_v<Args...>.data(), sizeof...(Args)};
+
+/**
+ * @brief Single-producer single-consumer ring of log records, one per logging thread.
+ *
+ * Under drop_oldest policy the producer also drops the oldest record to reuse its slot, so both
+ * claim records by CAS on a claim index: the consumer before copying a record out, the producer
+ * before overwriting it. A slot is written again only after the consumer has released it by
+ * advancing the head, or if its record was never claimed. When the consumer is still copying the
+ * oldest record, the producer drops the newest one instead.
+ */
+class log_ring {
+ public:
+  log_ring(std::size_t capacity,
+           std::uint32_t thread_index,
+           log_overflow_policy policy = log_overflow_policy::drop_newest,
+           std::uint32_t sample_rate = 1)
+      : _slots(std::bit_ceil(capacity)),
+        _mask(_slots.size() - 1),
+        _thread_index(thread_index),
+        _policy(policy),
+        _sample_rate(std::max(sample_rate, 1U)),
+        _threshold(policy == log_overflow_policy::sample ? _slots.size() / 2 : _slots.size()) {}
+
+  /**
+   * @brief Producer: get the slot to write, nullptr if the record is dropped by the overflow policy
+   * or, under block policy, if the ring is full.
+   */
+  auto try_reserve() -> log_record* {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head_cache >= _threshold) [[unlikely]] {
+      return _reserve_slow(tail);
+    }
+    return &_slots[tail & _mask];
+  }
+
+  /// Producer: publish the slot returned by try_reserve()
+  auto commit() -> void {
+    _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /// Consumer: copy out the oldest record
+  auto try_pop(log_record& out) -> bool {
+    if (_policy == log_overflow_policy::drop_oldest) {
+      return _pop_claimed(out);
+    }
+    auto head = _head.load(std::memory_order_relaxed);
+    if (_tail_cache == head) {
+      _tail_cache = _tail.load(std::memory_order_acquire);
+      if (_tail_cache == head) {
+        return false;
+      }
+    }
+    out = _slots[head & _mask];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Consumer: test if there is no record to pop
+  auto empty() const -> bool { return size() == 0; }
+
+  /// Number of records in the ring
+  auto size() const -> std::size_t {
+    auto& head = _policy == log_overflow_policy::drop_oldest ? _claim : _head;
+    auto first = head.load(std::memory_order_acquire);
+    return _tail.load(std::memory_order_acquire) - first;
+  }
+
+  auto capacity() const -> std::size_t { return _slots.size(); }
+
+  /// Called when the producer thread exits
+  auto close() -> void { _closed.store(true, std::memory_order_release); }
+
+  auto closed() const -> bool { return _closed.load(std::memory_order_acquire); }
+
+  /// Number of records committed by the producer, including the ones overwritten later
+  auto enqueued() const -> std::uint64_t { return _tail.load(std::memory_order_relaxed); }
+
+  auto dropped() const -> std::uint64_t { return _dropped.load(std::memory_order_relaxed); }
+
+  auto thread_index() const -> std::uint32_t { return _thread_index; }
+
+ private:
+  static constexpr auto cache_line = 64UZ;
+
+  auto _drop() -> void {
+    _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  // Consumer under drop_oldest policy: claim the oldest record not dropped by the producer
+  auto _pop_claimed(log_record& out) -> bool {
+    auto claim = _claim.load(std::memory_order_acquire);
+    do {
+      // the producer may have dropped records up to past the cached tail
+      if (static_cast<std::ptrdiff_t>(_tail_cache - claim) <= 0) {
+        _tail_cache = _tail.load(std::memory_order_acquire);
+        if (_tail_cache == claim) {
+          return false;
+        }
+      }
+    } while (!_claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel,
+                                           std::memory_order_acquire));
+    out = _slots[claim & _mask];
+    // the records before are either copied out or dropped, their slots can all be reused
+    _head.store(claim + 1, std::memory_order_release);
+    return true;
+  }
+
+  auto _reserve_slow(std::size_t tail) -> log_record* {
+    _head_cache = _head.load(std::memory_order_acquire);
+    auto size = tail - _head_cache;
+    if (size < _threshold) {
+      return &_slots[tail & _mask];
+    }
+    switch (_policy) {
+      case log_overflow_policy::block:
+        return nullptr;
+      case log_overflow_policy::drop_newest:
+        break;
+      case log_overflow_policy::drop_oldest: {
+        // the slot is reusable if the consumer has not claimed its record, or else drop the newest
+        auto oldest = tail - _slots.size();
+        _drop();
+        if (_claim.compare_exchange_strong(oldest, oldest + 1, std::memory_order_acq_rel,
+                                           std::memory_order_relaxed)) {
+          return &_slots[tail & _mask];
+        }
+        return nullptr;
+      }
+      case log_overflow_policy::sample:
+        if (size < _slots.size() && ++_sampled % _sample_rate == 0) {
+          return &_slots[tail & _mask];
+        }
+        break;
+    }
+    _drop();
+    return nullptr;
+  }
+
+  std::vector<log_record> _slots;
+  std::size_t _mask;
+  std::uint32_t _thread_index;
+  log_overflow_policy _policy;
+  std::uint32_t _sample_rate;
+  std::size_t _threshold;  ///< Size from which the overflow policy applies
+  std::atomic<bool> _closed = false;
+  alignas(cache_line) std::atomic<std::size_t> _tail = 0;
+  std::size_t _head_cache = 0;
+  std::uint32_t _sampled = 0;
+  std::atomic<std::uint64_t> _dropped = 0;
+  alignas(cache_line) std::atomic<std::size_t> _head = 0;  ///< Records before are released
+  std::atomic<std::size_t> _claim = 0;  ///< Records before are claimed, under drop_oldest policy
+  std::size_t _tail_cache = 0;
+};
+
+/**
+ * @brief Rate limit of a log call site by the generic cell rate algorithm, which keeps a single
+ * timestamp: the theoretical arrival time of the next record if records came at the steady rate.
+ */
+class log_rate_limiter {
+ public:
+  constexpr log_rate_limiter() = default;
+
+  /**
+   * @brief Test if a record may be logged within count records per interval, count it as
+   * suppressed otherwise.
+   */
+  template <typename Rep, typename Period>
+  auto try_acquire(std::uint32_t count, std::chrono::duration<Rep, Period> interval) -> bool {
+    auto period = std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count();
+    auto emission = period / std::max(count, 1U);
+    auto tolerance = period - emission;
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+                   .count();
+    auto tat = _tat.load(std::memory_order_relaxed);
+    while (true) {
+      auto start = std::max(tat, now);
+      if (start - now > tolerance) {
+        _suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      if (_tat.compare_exchange_weak(tat, start + emission, std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+  }
+
+  /// Take the number of records suppressed since the last call
+  auto take_suppressed() -> std::uint64_t {
+    if (_suppressed.load(std::memory_order_relaxed) == 0) {
+      return 0;
+    }
+    return _suppressed.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<std::int64_t> _tat = 0;
+  std::atomic<std::uint64_t> _suppressed = 0;
+};
+
+// Cache of the ring used last on this thread, trivial so that accessing it needs no guard
+inline thread_local constinit std::uint64_t cached_log_core_id = 0;
+inline thread_local constinit log_ring* cached_log_ring = nullptr;
+
+}  // namespace detail
+
+/**
+ * @brief Asynchronous logger.
+ *
+ * A log call copies its arguments by value into a fixed-size record in the ring buffer of the
+ * calling thread, without lock or allocation. A background thread formats the records and writes
+ * them to the sinks. Copies of a logger share the same background thread and sinks.
+ */
 class logger {
  public:
   enum level { TRACE, DEBUG, INFO, WARN, ERROR, FATAL };
 
-  explicit logger(const ascpp::app_info* info) : _app_info(info) {}
+  struct options {
+    std::size_t ring_capacity = 1024;  ///< Records buffered per thread, rounded up to power of 2
+    std::chrono::milliseconds max_poll_interval = std::chrono::milliseconds(50);
+    log_overflow_policy overflow = log_overflow_policy::drop_newest;
+    std::uint32_t sample_rate = 16;  ///< Used by log_overflow_policy::sample
+  };
+
+  /**
+   * @brief Counters of the logger, updated by the background thread after each drain.
+   */
+  struct stats {
+    std::uint64_t enqueued;   ///< Records put into the ring buffers
+    std::uint64_t dropped;    ///< Records dropped or overwritten by the overflow policy
+    std::uint64_t written;    ///< Records written to the sinks
+    std::size_t high_water;   ///< Maximum number of records seen in a ring buffer
+  };
+
+  explicit logger(const app_info* info) : logger(info, options()) {}
+
+  logger(const app_info* info, options opts);
 
   logger(logger&&) = default;
   logger(const logger&) = default;
@@ -14,6 +551,524 @@ class logger {
   auto operator=(const logger&) -> logger& = default;
   ~logger() = default;
 
+  /**
+   * @brief Log if lvl is not below the runtime level, prefer the ASCPP_LOG macros to also skip
+   * evaluating the arguments and to discard the statement below ASCPP_LOG_MIN_LEVEL.
+   */
+  template <typename... Args>
+  auto log(level lvl, std::format_string<Args...> fmt, Args&&... args) -> void {
+    if (enabled(lvl)) {
+      write(lvl, fmt, std::forward<Args>(args)...);
+    }
+  }
+
+  /**
+   * @brief Log without checking the level. The arguments are copied by value, the message is
+   * formatted by the background thread.
+   */
+  template <typename... Args>
+  auto write(level lvl, std::format_string<Args...> fmt, Args&&... args) -> void;
+
+  /**
+   * @brief Test if lvl is not below the runtime level, a single relaxed atomic load.
+   */
+  auto enabled(level lvl) const -> bool;
+
+  /**
+   * @brief Set the runtime minimum level, shared by the copies of this logger.
+   */
+  auto set_level(level lvl) -> void;
+
+  auto get_level() const -> level;
+
+  template <typename... Args>
+  auto trace(std::format_string<Args...> fmt, Args&&... args) -> void {
+    log(TRACE, fmt, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  auto debug(std::format_string<Args...> fmt, Args&&... args) -> void {
+    log(DEBUG, fmt, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  auto info(std::format_string<Args...> fmt, Args&&... args) -> void {
+    log(INFO, fmt, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  auto warn(std::format_string<Args...> fmt, Args&&... args) -> void {
+    log(WARN, fmt, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  auto error(std::format_string<Args...> fmt, Args&&... args) -> void {
+    log(ERROR, fmt, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  auto fatal(std::format_string<Args...> fmt, Args&&... args) -> void {
+    log(FATAL, fmt, std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief Replace the sinks, records are written to std::clog if no sink is set.
+   */
+  auto set_sinks(std::vector<std::shared_ptr<log_sink>> sinks) -> void;
+
+  auto add_sink(std::shared_ptr<log_sink> sink) -> void;
+
+  /**
+   * @brief Block until the records logged before the call are written to the sinks.
+   */
+  auto flush() -> void;
+
+  /**
+   * @brief Number of records dropped because the ring buffer of the logging thread was full.
+   */
+  auto dropped() const -> std::uint64_t;
+
+  /**
+   * @brief Get the counters without lock, they are up to date after flush().
+   */
+  auto get_stats() const -> stats;
+
+  auto get_app_info() const -> const app_info* { return _app_info; }
+
+  static auto level_name(level lvl) -> std::string_view {
+    constexpr auto names = std::to_array<std::string_view>({
+        "TRACE",
+        "DEBUG",
+        "INFO",
+        "WARN",
+        "ERROR",
+        "FATAL",
+    });
+    return names[static_cast<std::size_t>(lvl)];
+  }
+
+ private:
+  const app_info* _app_info;
+  std::shared_ptr<detail::log_core> _core;
+};
+
+/**
+ * @brief A record decoded by the background thread of logger.
+ */
+struct log_entry {
+  logger::level lvl;
+  std::chrono::sys_time<std::chrono::nanoseconds> time;
+  std::uint32_t thread_index;  ///< Sequence number of the logging thread, starts from 1
+  std::string_view message;    ///< Formatted message, empty if no sink needs_text()
+  std::string_view line;       ///< Formatted line with time, level and thread, ends with '\n'
+  const detail::log_record* record;
+};
+
+/**
+ * @brief Destination of the log entries, only called from the background thread of logger.
+ */
+class log_sink {
+ public:
+  log_sink() = default;
+  log_sink(log_sink&&) = delete;
+  log_sink(const log_sink&) = delete;
+  auto operator=(log_sink&&) -> log_sink& = delete;
+  auto operator=(const log_sink&) -> log_sink& = delete;
+  virtual ~log_sink() = default;
+
+  /**
+   * @brief Write a batch of entries, sorted by time.
+   */
+  virtual auto write(std::span<const log_entry> entries) -> void = 0;
+
+  virtual auto flush() -> void {}
+
+  /**
+   * @brief Whether the sink reads the formatted message and line of the entries. The background
+   * thread skips formatting when no sink needs it.
+   */
+  virtual auto needs_text() const -> bool { return true; }
+};
+
+/**
+ * @brief Write log lines to a std::ostream.
+ */
+class stream_sink : public log_sink {
+ public:
+  explicit stream_sink(std::ostream& out) : _out(&out) {}
+
+  auto write(std::span<const log_entry> entries) -> void override {
+    for (const auto& entry : entries) {
+      _out->write(entry.line.data(), static_cast<std::streamsize>(entry.line.size()));
+    }
+  }
+
+  auto flush() -> void override { _out->flush(); }
+
+ private:
+  std::ostream* _out;
+};
+
+namespace detail {
+
+/**
+ * @brief Shared state of the copies of a logger: the ring registry, the sinks and the background
+ * thread that drains the rings.
+ */
+class log_core {
+ public:
+  explicit log_core(logger::options opts) : _options(opts), _thread([this] { _run(); }) {}
+
+  log_core(log_core&&) = delete;
+  log_core(const log_core&) = delete;
+  auto operator=(log_core&&) -> log_core& = delete;
+  auto operator=(const log_core&) -> log_core& = delete;
+
+  ~log_core() {
+    {
+      auto lock = std::lock_guard(_mutex);
+      _stop = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+  }
+
+  /// Get the ring of the calling thread, register one at the first call on a thread
+  auto local_ring() -> log_ring* {
+    if (cached_log_core_id == _id) [[likely]] {
+      return cached_log_ring;
+    }
+    return _register_ring();
+  }
+
+  auto set_sinks(std::vector<std::shared_ptr<log_sink>> sinks) -> void {
+    auto lock = std::lock_guard(_sinks_mutex);
+    _sinks = std::move(sinks);
+  }
+
+  auto add_sink(std::shared_ptr<log_sink> sink) -> void {
+    auto lock = std::lock_guard(_sinks_mutex);
+    _sinks.emplace_back(std::move(sink));
+  }
+
+  auto flush() -> void {
+    auto lock = std::unique_lock(_mutex);
+    auto target = ++_flush_requested;
+    _cv.notify_all();
+    _cv.wait(lock, [&] { return _flush_done >= target || _stop; });
+  }
+
+  auto dropped() const -> std::uint64_t {
+    return _dropped_total.load(std::memory_order_relaxed);
+  }
+
+  auto get_stats() const -> logger::stats {
+    return {
+        .enqueued = _enqueued_total.load(std::memory_order_relaxed),
+        .dropped = _dropped_total.load(std::memory_order_relaxed),
+        .written = _written_total.load(std::memory_order_relaxed),
+        .high_water = _high_water.load(std::memory_order_relaxed),
+    };
+  }
+
+  /**
+   * @brief Producer: wait until the full ring has room under block policy, return nullptr under
+   * the other policies, which already handled the record.
+   */
+  auto wait_reserve(log_ring& ring) -> log_record* {
+    if (_options.overflow != log_overflow_policy::block) {
+      return nullptr;
+    }
+    while (true) {
+      // a lost wakeup only delays the background thread until its next poll
+      _wakeup.store(true, std::memory_order_relaxed);
+      _cv.notify_one();
+      std::this_thread::yield();
+      if (auto* rec = ring.try_reserve()) {
+        return rec;
+      }
+    }
+  }
+
+  auto level() const -> logger::level { return _level.load(std::memory_order_relaxed); }
+
+  auto set_level(logger::level lvl) -> void { _level.store(lvl, std::memory_order_relaxed); }
+
  private:
-  const ascpp::app_info* _app_info;
+  struct thread_rings {
+    thread_rings() = default;
+    thread_rings(thread_rings&&) = delete;
+    thread_rings(const thread_rings&) = delete;
+    auto operator=(thread_rings&&) -> thread_rings& = delete;
+    auto operator=(const thread_rings&) -> thread_rings& = delete;
+
+    ~thread_rings() {
+      for (auto& [id, ring] : rings) {
+        ring->close();
+      }
+      cached_log_core_id = 0;
+      cached_log_ring = nullptr;
+    }
+
+    std::vector<std::pair<std::uint64_t, std::shared_ptr<log_ring>>> rings;
+  };
+
+  static auto _next_id() -> std::uint64_t {
+    static constinit auto next = std::atomic<std::uint64_t>(1);
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  auto _register_ring() -> log_ring* {
+    thread_local auto local = thread_rings();
+    auto itr = std::ranges::find(local.rings, _id, &decltype(local.rings)::value_type::first);
+    if (itr == local.rings.end()) {
+      auto lock = std::lock_guard(_rings_mutex);
+      auto ring = std::make_shared<log_ring>(_options.ring_capacity, ++_thread_count,
+                                             _options.overflow, _options.sample_rate);
+      _rings.emplace_back(ring);
+      _rings_version.fetch_add(1, std::memory_order_release);
+      itr = local.rings.emplace(local.rings.end(), _id, std::move(ring));
+    }
+    cached_log_core_id = _id;
+    cached_log_ring = itr->second.get();
+    return cached_log_ring;
+  }
+
+  auto _run() -> void {
+    auto rings = std::vector<std::shared_ptr<log_ring>>();
+    auto rings_version = std::uint64_t();
+    auto poll_interval = std::chrono::milliseconds(1);
+    while (true) {
+      auto stop = false;
+      auto flush_target = std::uint64_t();
+      {
+        auto lock = std::unique_lock(_mutex);
+        _cv.wait_for(lock, poll_interval, [&] {
+          return _stop || _flush_requested > _flush_done
+                 || _wakeup.exchange(false, std::memory_order_relaxed);
+        });
+        stop = _stop;
+        flush_target = _flush_requested;
+      }
+
+      if (_rings_version.load(std::memory_order_acquire) != rings_version) {
+        auto lock = std::lock_guard(_rings_mutex);
+        rings = _rings;
+        rings_version = _rings_version.load(std::memory_order_relaxed);
+      }
+
+      auto count = _drain(rings);
+      if (std::ranges::any_of(rings, &log_ring::closed)) {
+        _collect_closed();
+      }
+      poll_interval = count != 0 ? std::chrono::milliseconds(1)
+                                 : std::min(poll_interval * 2, _options.max_poll_interval);
+
+      {
+        auto lock = std::lock_guard(_mutex);
+        _flush_done = flush_target;
+      }
+      _cv.notify_all();
+      if (stop) {
+        break;
+      }
+    }
+  }
+
+  // Drain the rings and write the records to sinks batch by batch, return the number of records
+  auto _drain(const std::vector<std::shared_ptr<log_ring>>& rings) -> std::size_t {
+    auto total = 0UZ;
+    auto rec = log_record();
+    while (true) {
+      auto enqueued = _enqueued_closed;
+      auto dropped = _dropped_closed;
+      for (const auto& ring : rings) {
+        enqueued += ring->enqueued();
+        dropped += ring->dropped();
+        _high_water_local = std::max(_high_water_local, ring->size());
+        while (_records.size() < max_batch && ring->try_pop(rec)) {
+          _records.emplace_back(rec);
+          _thread_indexes.emplace_back(ring->thread_index());
+        }
+      }
+
+      auto count = _records.size();
+      if (count != 0) {
+        _write_batch();
+      }
+      total += count;
+      _enqueued_total.store(enqueued, std::memory_order_relaxed);
+      _dropped_total.store(dropped, std::memory_order_relaxed);
+      _written_total.store(_written_total.load(std::memory_order_relaxed) + count,
+                           std::memory_order_relaxed);
+      _high_water.store(_high_water_local, std::memory_order_relaxed);
+      if (count < max_batch) {
+        return total;
+      }
+    }
+  }
+
+  auto _write_batch() -> void {
+    _lines.clear();
+    _entries.clear();
+    auto lock = std::lock_guard(_sinks_mutex);
+    auto needs_text = _sinks.empty() || std::ranges::any_of(_sinks, &log_sink::needs_text);
+    auto offsets = std::vector<std::pair<std::size_t, std::size_t>>();
+    for (auto i = 0UZ; i < _records.size(); ++i) {
+      const auto& rec = _records[i];
+      auto time = std::chrono::sys_time<std::chrono::nanoseconds>(
+          std::chrono::nanoseconds(rec.timestamp));
+      auto lvl = static_cast<logger::level>(rec.level);
+      _entries.push_back({lvl, time, _thread_indexes[i], {}, {}, &rec});
+      if (!needs_text) {
+        continue;
+      }
+      auto line_begin = _lines.size();
+      std::format_to(std::back_inserter(_lines), "{:%F %T} {:<5} [{}] ",
+                     std::chrono::floor<std::chrono::microseconds>(time), logger::level_name(lvl),
+                     _thread_indexes[i]);
+      auto msg_begin = _lines.size();
+      rec.codec->format(_lines, std::string_view(rec.fmt, rec.fmt_size), rec.args.data());
+      offsets.emplace_back(line_begin, msg_begin);
+      _lines += '\n';
+    }
+    // _lines may reallocate while formatting, so the views are taken at last
+    for (auto i = 0UZ; i < offsets.size(); ++i) {
+      auto line_end = i + 1 < offsets.size() ? offsets[i + 1].first : _lines.size();
+      auto [line_begin, msg_begin] = offsets[i];
+      _entries[i].line = std::string_view(_lines).substr(line_begin, line_end - line_begin);
+      _entries[i].message = std::string_view(_lines).substr(msg_begin, line_end - msg_begin - 1);
+    }
+    std::ranges::stable_sort(_entries, {}, &log_entry::time);
+
+    if (_sinks.empty()) {
+      auto sink = stream_sink(std::clog);
+      sink.write(_entries);
+      sink.flush();
+    }
+    for (const auto& sink : _sinks) {
+      sink->write(_entries);
+      sink->flush();
+    }
+    _records.clear();
+    _thread_indexes.clear();
+  }
+
+  // Unregister the rings whose thread exited, once they are empty
+  auto _collect_closed() -> void {
+    auto lock = std::lock_guard(_rings_mutex);
+    auto removed = std::ranges::remove_if(_rings, [this](const auto& ring) {
+      if (ring->closed() && ring->empty()) {
+        _enqueued_closed += ring->enqueued();
+        _dropped_closed += ring->dropped();
+        return true;
+      }
+      return false;
+    });
+    _rings.erase(removed.begin(), removed.end());
+    _rings_version.fetch_add(1, std::memory_order_release);
+  }
+
+  static constexpr auto max_batch = 4096UZ;
+
+  logger::options _options;
+  std::uint64_t _id = _next_id();
+
+  std::mutex _rings_mutex;
+  std::vector<std::shared_ptr<log_ring>> _rings;
+  std::atomic<std::uint64_t> _rings_version = 0;
+  std::uint32_t _thread_count = 0;
+
+  std::mutex _sinks_mutex;
+  std::vector<std::shared_ptr<log_sink>> _sinks;
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  bool _stop = false;
+  std::uint64_t _flush_requested = 0;
+  std::uint64_t _flush_done = 0;
+
+  std::atomic<std::uint64_t> _enqueued_total = 0;
+  std::atomic<std::uint64_t> _dropped_total = 0;
+  std::atomic<std::uint64_t> _written_total = 0;
+  std::atomic<std::size_t> _high_water = 0;
+  std::atomic<bool> _wakeup = false;
+  std::uint64_t _enqueued_closed = 0;
+  std::uint64_t _dropped_closed = 0;
+  std::size_t _high_water_local = 0;
+
+  // read by every log call, kept away from the fields written by the background thread
+  alignas(64) std::atomic<logger::level> _level = logger::TRACE;
+
+  // Only used by the background thread
+  std::vector<log_record> _records;
+  std::vector<std::uint32_t> _thread_indexes;
+  std::vector<log_entry> _entries;
+  std::string _lines;
+
+  std::thread _thread;
 };
+
+}  // namespace detail
+
+inline logger::logger(const app_info* info, options opts)
+    : _app_info(info), _core(std::make_shared<detail::log_core>(opts)) {}
+
+template <typename... Args>
+auto logger::write(level lvl, std::format_string<Args...> fmt, Args&&... args) -> void {
+  auto* ring = _core->local_ring();
+  auto* rec = ring->try_reserve();
+  if (rec == nullptr) [[unlikely]] {
+    rec = _core->wait_reserve(*ring);
+    if (rec == nullptr) {
+      return;
+    }
+  }
+  auto fmt_view = fmt.get();
+  rec->codec = &detail::log_codec_v<std::remove_cvref_t<Args>...>;
+  rec->fmt = fmt_view.data();
+  rec->fmt_size = static_cast<std::uint32_t>(fmt_view.size());
+  rec->level = static_cast<std::uint8_t>(lvl);
+  rec->timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  detail::log_writer(rec->args.data(), rec->args.size()).write(args...);
+  ring->commit();
+  if (lvl == FATAL) [[unlikely]] {
+    flush();
+  }
+}
+
+inline auto logger::enabled(level lvl) const -> bool {
+  return lvl >= _core->level();
+}
+
+inline auto logger::set_level(level lvl) -> void {
+  _core->set_level(lvl);
+}
+
+inline auto logger::get_level() const -> level {
+  return _core->level();
+}
+
+inline auto logger::set_sinks(std::vector<std::shared_ptr<log_sink>> sinks) -> void {
+  _core->set_sinks(std::move(sinks));
+}
+
+inline auto logger::add_sink(std::shared_ptr<log_sink> sink) -> void {
+  _core->add_sink(std::move(sink));
+}
+
+inline auto logger::flush() -> void {
+  _core->flush();
+}
+
+inline auto logger::dropped() const -> std::uint64_t {
+  return _core->dropped();
+}
+
+inline auto logger::get_stats() const -> stats {
+  return _core->get_stats();
+}
+
+}  // namespace ascpp
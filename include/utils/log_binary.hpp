@@ -0,0 +1,495 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "utils/error.hpp"
+#include "utils/log.hpp"
+
+/**
+ * @file
+ * @brief Compact binary encoding of log records, formatted offline by ascpp-logcat.
+ *
+ * A stream is a header followed by blocks, a file may contain several streams, e.g. one per run
+ * of the program appending to it.
+ *
+ * @code
+ * header  := 0xA5 "LOG" version:u8 base_time:zigzag
+ * block   := 0x01 format | 0x02 record | 0x03 message
+ * format  := id:varint arg_count:varint arg_type:u8* size:varint char*
+ * record  := id:varint level:u8 thread:varint delta_time:zigzag arg*
+ * message := level:u8 thread:varint delta_time:zigzag size:varint char*
+ * @endcode
+ *
+ * Times are nanoseconds, each delta_time is relative to the previous record of the stream or to
+ * base_time. Each format string is written once per stream, before the first record using it.
+ * Integer arguments are (zigzag) varints, floating point arguments are little-endian IEEE 754,
+ * strings are sized by a varint. A record with an argument of other type is formatted in process
+ * and written as a message block.
+ */
+
+namespace ascpp {
+
+/**
+ * @brief An argument decoded from a binary log stream.
+ */
+using log_value =
+    std::variant<bool, char, std::int64_t, std::uint64_t, float, double, std::string_view>;
+
+/**
+ * @brief A log record decoded from a binary log stream, the views refer to the decoded data.
+ */
+struct log_event {
+  logger::level lvl;
+  std::chrono::sys_time<std::chrono::nanoseconds> time;
+  std::uint32_t thread_index;
+  std::string_view format;
+  std::vector<log_value> args;
+};
+
+namespace detail {
+
+inline constexpr auto log_magic = std::string_view("\xA5LOG");
+inline constexpr auto log_version = std::uint8_t(1);
+
+enum log_block : std::uint8_t {
+  log_format_block = 0x01,
+  log_record_block = 0x02,
+  log_message_block = 0x03,
+};
+
+inline auto put_varint(std::string& out, std::uint64_t value) -> void {
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+inline auto put_zigzag(std::string& out, std::int64_t value) -> void {
+  put_varint(out,
+             (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+template <typename T>
+using log_float_bits_t = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+
+template <typename T>
+auto put_little_endian(std::string& out, T value) -> void {
+  auto bits = std::bit_cast<log_float_bits_t<T>>(value);
+  for (auto i = 0UZ; i < sizeof(T); ++i) {
+    out += static_cast<char>(bits >> (i * 8));
+  }
+}
+
+/**
+ * @brief Encode the entries of logger into a binary log stream.
+ */
+class log_encoder {
+ public:
+  /**
+   * @brief Whether the header of the current stream has been written.
+   */
+  auto started() const -> bool { return _started; }
+
+  /**
+   * @brief Write the header of a new stream and forget the format strings written before.
+   */
+  auto start(std::string& out, std::int64_t base_time) -> void {
+    _formats.clear();
+    _time = base_time;
+    _started = true;
+    out += log_magic;
+    out += static_cast<char>(log_version);
+    put_zigzag(out, base_time);
+  }
+
+  auto encode(std::string& out, const log_entry& entry) -> void {
+    const auto& rec = *entry.record;
+    auto fmt = std::string_view(rec.fmt, rec.fmt_size);
+    auto [itr, inserted] = _formats.try_emplace({rec.fmt, rec.codec}, _formats.size(), true);
+    auto& [id, binary] = itr->second;
+    if (inserted) {
+      auto types = std::span(rec.codec->arg_types, rec.codec->arg_count);
+      binary = std::ranges::find(types, log_arg_type::other) == types.end();
+      if (binary) {
+        out += static_cast<char>(log_format_block);
+        put_varint(out, id);
+        put_varint(out, types.size());
+        for (auto type : types) {
+          out += static_cast<char>(type);
+        }
+        put_varint(out, fmt.size());
+        out += fmt;
+      }
+    }
+
+    if (binary) {
+      out += static_cast<char>(log_record_block);
+      put_varint(out, id);
+    } else {
+      out += static_cast<char>(log_message_block);
+    }
+    out += static_cast<char>(entry.lvl);
+    put_varint(out, entry.thread_index);
+    put_zigzag(out, rec.timestamp - _time);
+    _time = rec.timestamp;
+
+    if (binary) {
+      _encode_args(out, rec);
+    } else {
+      _message.clear();
+      rec.codec->format(_message, fmt, rec.args.data());
+      put_varint(out, _message.size());
+      out += _message;
+    }
+  }
+
+ private:
+  using format_key = std::pair<const char*, const log_codec*>;
+
+  struct format_key_hash {
+    auto operator()(const format_key& key) const noexcept -> std::size_t {
+      return std::hash<const void*>()(key.first) ^ (std::hash<const void*>()(key.second) << 1);
+    }
+  };
+
+  static auto _encode_args(std::string& out, const log_record& rec) -> void {
+    const auto* data = rec.args.data();
+    auto read = [&data]<typename T>(std::type_identity<T>) {
+      auto value = T();
+      std::memcpy(&value, data, sizeof(T));
+      data += sizeof(T);
+      return value;
+    };
+    for (auto type : std::span(rec.codec->arg_types, rec.codec->arg_count)) {
+      switch (type) {
+        case log_arg_type::boolean:
+        case log_arg_type::character:
+        case log_arg_type::uint8:
+          out += static_cast<char>(read(std::type_identity<std::uint8_t>()));
+          break;
+        case log_arg_type::int8:
+          put_zigzag(out, read(std::type_identity<std::int8_t>()));
+          break;
+        case log_arg_type::int16:
+          put_zigzag(out, read(std::type_identity<std::int16_t>()));
+          break;
+        case log_arg_type::int32:
+          put_zigzag(out, read(std::type_identity<std::int32_t>()));
+          break;
+        case log_arg_type::int64:
+          put_zigzag(out, read(std::type_identity<std::int64_t>()));
+          break;
+        case log_arg_type::uint16:
+          put_varint(out, read(std::type_identity<std::uint16_t>()));
+          break;
+        case log_arg_type::uint32:
+          put_varint(out, read(std::type_identity<std::uint32_t>()));
+          break;
+        case log_arg_type::uint64:
+          put_varint(out, read(std::type_identity<std::uint64_t>()));
+          break;
+        case log_arg_type::float32:
+          put_little_endian(out, read(std::type_identity<float>()));
+          break;
+        case log_arg_type::float64:
+          put_little_endian(out, read(std::type_identity<double>()));
+          break;
+        case log_arg_type::string: {
+          auto size = read(std::type_identity<std::uint32_t>());
+          put_varint(out, size);
+          out.append(reinterpret_cast<const char*>(data), size);
+          data += size;
+          break;
+        }
+        case log_arg_type::other:
+          break;
+      }
+    }
+  }
+
+  std::unordered_map<format_key, std::pair<std::uint32_t, bool>, format_key_hash> _formats;
+  std::int64_t _time = 0;
+  bool _started = false;
+  std::string _message;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Decode the log events from binary log streams.
+ */
+class log_decoder {
+ public:
+  explicit log_decoder(std::string_view data) : _data(data) {}
+
+  /**
+   * @brief Decode the next record into event, return false at the end of data.
+   */
+  auto next(log_event& event) -> result<bool> {
+    while (_pos < _data.size()) {
+      if (_data.substr(_pos).starts_with(detail::log_magic)) {
+        _pos += detail::log_magic.size();
+        TRY_ASSIGN(auto version, _get_byte());
+        if (version != detail::log_version) {
+          return make_error_code(error::corrupted_log);
+        }
+        TRY_ASSIGN(_time, _get_zigzag());
+        _formats.clear();
+        _started = true;
+        continue;
+      }
+      if (!_started) {
+        return make_error_code(error::corrupted_log);
+      }
+      TRY_ASSIGN(auto block, _get_byte());
+      switch (block) {
+        case detail::log_format_block:
+          TRY_CHECK(_get_format());
+          break;
+        case detail::log_record_block:
+          TRY_CHECK(_get_record(event));
+          return true;
+        case detail::log_message_block:
+          TRY_CHECK(_get_message(event));
+          return true;
+        default:
+          return make_error_code(error::corrupted_log);
+      }
+    }
+    return false;
+  }
+
+ private:
+  struct format_info {
+    std::string_view format;
+    std::vector<detail::log_arg_type> arg_types;
+  };
+
+  auto _get_byte() -> result<std::uint8_t> {
+    if (_pos >= _data.size()) {
+      return make_error_code(error::corrupted_log);
+    }
+    return static_cast<std::uint8_t>(_data[_pos++]);
+  }
+
+  auto _get_bytes(std::size_t size) -> result<std::string_view> {
+    if (size > _data.size() - _pos) {
+      return make_error_code(error::corrupted_log);
+    }
+    auto bytes = _data.substr(_pos, size);
+    _pos += size;
+    return bytes;
+  }
+
+  auto _get_varint() -> result<std::uint64_t> {
+    auto value = std::uint64_t();
+    for (auto shift = 0; shift < 64; shift += 7) {
+      TRY_ASSIGN(auto byte, _get_byte());
+      value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+    return make_error_code(error::corrupted_log);
+  }
+
+  auto _get_zigzag() -> result<std::int64_t> {
+    TRY_ASSIGN(auto value, _get_varint());
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+  }
+
+  template <typename T>
+  auto _get_little_endian() -> result<T> {
+    using bits_type = detail::log_float_bits_t<T>;
+    TRY_ASSIGN(auto bytes, _get_bytes(sizeof(T)));
+    auto bits = bits_type();
+    for (auto i = 0UZ; i < sizeof(T); ++i) {
+      bits |= static_cast<bits_type>(static_cast<std::uint8_t>(bytes[i])) << (i * 8);
+    }
+    return std::bit_cast<T>(bits);
+  }
+
+  auto _get_format() -> result<void> {
+    TRY_ASSIGN(auto id, _get_varint());
+    TRY_ASSIGN(auto count, _get_varint());
+    if (id != _formats.size() || count > _data.size() - _pos) {
+      return make_error_code(error::corrupted_log);
+    }
+    auto info = format_info();
+    for (auto i = 0UZ; i < count; ++i) {
+      TRY_ASSIGN(auto type, _get_byte());
+      if (type == 0 || type > static_cast<std::uint8_t>(detail::log_arg_type::string)) {
+        return make_error_code(error::corrupted_log);
+      }
+      info.arg_types.push_back(static_cast<detail::log_arg_type>(type));
+    }
+    TRY_ASSIGN(auto size, _get_varint());
+    TRY_ASSIGN(info.format, _get_bytes(size));
+    _formats.push_back(std::move(info));
+    return {};
+  }
+
+  auto _get_header(log_event& event) -> result<void> {
+    TRY_ASSIGN(auto lvl, _get_byte());
+    if (lvl > logger::FATAL) {
+      return make_error_code(error::corrupted_log);
+    }
+    TRY_ASSIGN(auto thread_index, _get_varint());
+    TRY_ASSIGN(auto delta, _get_zigzag());
+    _time += delta;
+    event.lvl = static_cast<logger::level>(lvl);
+    event.thread_index = static_cast<std::uint32_t>(thread_index);
+    event.time =
+        std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(_time));
+    event.args.clear();
+    return {};
+  }
+
+  auto _get_record(log_event& event) -> result<void> {
+    TRY_ASSIGN(auto id, _get_varint());
+    if (id >= _formats.size()) {
+      return make_error_code(error::corrupted_log);
+    }
+    TRY_CHECK(_get_header(event));
+    const auto& info = _formats[id];
+    event.format = info.format;
+    for (auto type : info.arg_types) {
+      TRY_ASSIGN(auto value, _get_arg(type));
+      event.args.push_back(value);
+    }
+    return {};
+  }
+
+  auto _get_message(log_event& event) -> result<void> {
+    TRY_CHECK(_get_header(event));
+    TRY_ASSIGN(auto size, _get_varint());
+    TRY_ASSIGN(auto message, _get_bytes(size));
+    event.format = "{}";
+    event.args.emplace_back(message);
+    return {};
+  }
+
+  auto _get_arg(detail::log_arg_type type) -> result<log_value> {
+    switch (type) {
+      case detail::log_arg_type::boolean: {
+        TRY_ASSIGN(auto value, _get_byte());
+        return log_value(value != 0);
+      }
+      case detail::log_arg_type::character: {
+        TRY_ASSIGN(auto value, _get_byte());
+        return log_value(static_cast<char>(value));
+      }
+      case detail::log_arg_type::uint8: {
+        TRY_ASSIGN(auto value, _get_byte());
+        return log_value(std::uint64_t(value));
+      }
+      case detail::log_arg_type::int8:
+      case detail::log_arg_type::int16:
+      case detail::log_arg_type::int32:
+      case detail::log_arg_type::int64: {
+        TRY_ASSIGN(auto value, _get_zigzag());
+        return log_value(value);
+      }
+      case detail::log_arg_type::uint16:
+      case detail::log_arg_type::uint32:
+      case detail::log_arg_type::uint64: {
+        TRY_ASSIGN(auto value, _get_varint());
+        return log_value(value);
+      }
+      case detail::log_arg_type::float32: {
+        TRY_ASSIGN(auto value, _get_little_endian<float>());
+        return log_value(value);
+      }
+      case detail::log_arg_type::float64: {
+        TRY_ASSIGN(auto value, _get_little_endian<double>());
+        return log_value(value);
+      }
+      case detail::log_arg_type::string: {
+        TRY_ASSIGN(auto size, _get_varint());
+        TRY_ASSIGN(auto value, _get_bytes(size));
+        return log_value(value);
+      }
+      case detail::log_arg_type::other:
+        break;
+    }
+    return make_error_code(error::corrupted_log);
+  }
+
+  std::string_view _data;
+  std::size_t _pos = 0;
+  std::int64_t _time = 0;
+  bool _started = false;
+  std::vector<format_info> _formats;
+};
+
+/**
+ * @brief Format the message of a decoded event with its format string.
+ *
+ * Each replacement field is formatted separately, nested replacement fields in the format spec
+ * such as `{:{}}` are not supported. Throw std::format_error if the format string is invalid.
+ */
+inline auto format_log_event(std::string& out, const log_event& event) -> void {
+  const auto& fmt = event.format;
+  auto next_arg = 0UZ;
+  for (auto i = 0UZ; i < fmt.size(); ++i) {
+    if (fmt[i] == '}') {
+      if (i + 1 >= fmt.size() || fmt[i + 1] != '}') {
+        throw std::format_error("unmatched '}' in format string");
+      }
+      out += '}';
+      ++i;
+    } else if (fmt[i] != '{') {
+      out += fmt[i];
+    } else if (i + 1 < fmt.size() && fmt[i + 1] == '{') {
+      out += '{';
+      ++i;
+    } else {
+      auto end = fmt.find('}', i);
+      if (end == std::string_view::npos) {
+        throw std::format_error("unmatched '{' in format string");
+      }
+      auto field = fmt.substr(i + 1, end - i - 1);
+      auto colon = std::min(field.find(':'), field.size());
+      auto arg_id = field.substr(0, colon);
+      auto index = next_arg++;
+      if (!arg_id.empty()) {
+        index = 0;
+        for (auto ch : arg_id) {
+          if (ch < '0' || ch > '9') {
+            throw std::format_error("invalid argument id in format string");
+          }
+          index = index * 10 + static_cast<std::size_t>(ch - '0');
+        }
+      }
+      if (index >= event.args.size()) {
+        throw std::format_error("argument index out of range");
+      }
+      auto spec = std::string("{") + std::string(field.substr(colon)) + "}";
+      std::visit(
+          [&](const auto& value) {
+            std::vformat_to(std::back_inserter(out), spec, std::make_format_args(value));
+          },
+          event.args[index]);
+      i = end;
+    }
+  }
+}
+
+}  // namespace ascpp
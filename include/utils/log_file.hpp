@@ -0,0 +1,458 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "app/info.hpp"
+#include "utils/error.hpp"
+#include "utils/log.hpp"
+#include "utils/log_binary.hpp"
+#include "utils/system.hpp"
+
+namespace ascpp {
+
+namespace detail {
+
+/**
+ * @brief Append-only file written by a batch of chunks per system call.
+ */
+class log_file {
+ public:
+  log_file() = default;
+
+  log_file(log_file&& other) noexcept : _fd(std::exchange(other._fd, -1)) {}
+
+  log_file(const log_file&) = delete;
+
+  auto operator=(log_file&& other) noexcept -> log_file& {
+    std::swap(_fd, other._fd);
+    return *this;
+  }
+
+  auto operator=(const log_file&) -> log_file& = delete;
+
+  ~log_file() { close(); }
+
+  auto is_open() const -> bool { return _fd >= 0; }
+
+  /**
+   * @brief Write all chunks in order, with a single writev() as long as the kernel accepts them.
+   */
+  auto write(std::span<const std::string_view> chunks) -> result<void> {
+#if defined(_WIN32) || defined(_WIN64)
+    for (auto chunk : chunks) {
+      while (!chunk.empty()) {
+        auto count = ::_write(_fd, chunk.data(), static_cast<unsigned>(chunk.size()));
+        if (count < 0) {
+          return std::make_error_code(static_cast<std::errc>(errno));
+        }
+        chunk.remove_prefix(static_cast<std::size_t>(count));
+      }
+    }
+#else
+    auto iov = std::array<::iovec, max_iov>();
+    auto idx = 0UZ;
+    auto offset = 0UZ;  // bytes of chunks[idx] already written
+    while (idx < chunks.size()) {
+      auto count = 0UZ;
+      for (auto i = idx; i < chunks.size() && count < iov.size(); ++i, ++count) {
+        auto skip = i == idx ? offset : 0UZ;
+        iov[count].iov_base = const_cast<char*>(chunks[i].data() + skip);
+        iov[count].iov_len = chunks[i].size() - skip;
+      }
+      auto written = ::writev(_fd, iov.data(), static_cast<int>(count));
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return std::make_error_code(static_cast<std::errc>(errno));
+      }
+      auto left = static_cast<std::size_t>(written);
+      while (idx < chunks.size() && left >= chunks[idx].size() - offset) {
+        left -= chunks[idx].size() - offset;
+        offset = 0;
+        ++idx;
+      }
+      offset += left;
+    }
+#endif
+    return {};
+  }
+
+  /**
+   * @brief Flush the written data to the storage device.
+   */
+  auto sync() -> result<void> {
+#if defined(_WIN32) || defined(_WIN64)
+    if (::_commit(_fd) != 0) {
+#elif defined(__APPLE__)
+    if (::fsync(_fd) != 0) {
+#else
+    if (::fdatasync(_fd) != 0) {
+#endif
+      return std::make_error_code(static_cast<std::errc>(errno));
+    }
+    return {};
+  }
+
+  auto size() const -> result<std::uint64_t> {
+#if defined(_WIN32) || defined(_WIN64)
+    struct ::_stat64 st {};
+    if (::_fstat64(_fd, &st) != 0) {
+#else
+    struct ::stat st {};
+    if (::fstat(_fd, &st) != 0) {
+#endif
+      return std::make_error_code(static_cast<std::errc>(errno));
+    }
+    return static_cast<std::uint64_t>(st.st_size);
+  }
+
+  /**
+   * @brief Time the file was created, or last modified where the file system does not record its
+   * creation.
+   */
+  auto created() const -> result<std::chrono::system_clock::time_point> {
+    using namespace std::chrono;
+#if defined(_WIN32) || defined(_WIN64)
+    struct ::_stat64 st {};
+    if (::_fstat64(_fd, &st) != 0) {
+      return std::make_error_code(static_cast<std::errc>(errno));
+    }
+    // st_ctime is the creation time on Windows
+    return system_clock::from_time_t(st.st_ctime);
+#elif defined(__linux__) && defined(STATX_BTIME)
+    struct ::statx st {};
+    if (::statx(_fd, "", AT_EMPTY_PATH, STATX_BTIME | STATX_MTIME, &st) != 0) {
+      return std::make_error_code(static_cast<std::errc>(errno));
+    }
+    auto time = (st.stx_mask & STATX_BTIME) != 0 ? st.stx_btime : st.stx_mtime;
+    return system_clock::time_point(
+        duration_cast<system_clock::duration>(seconds(time.tv_sec) + nanoseconds(time.tv_nsec)));
+#else
+    struct ::stat st {};
+    if (::fstat(_fd, &st) != 0) {
+      return std::make_error_code(static_cast<std::errc>(errno));
+    }
+#if defined(__APPLE__)
+    auto time = st.st_birthtimespec;
+#else
+    auto time = st.st_mtim;
+#endif
+    return system_clock::time_point(
+        duration_cast<system_clock::duration>(seconds(time.tv_sec) + nanoseconds(time.tv_nsec)));
+#endif
+  }
+
+  /**
+   * @brief Take the ownership of an opened file descriptor.
+   */
+  static auto from_fd(int fd) -> log_file {
+    auto file = log_file();
+    file._fd = fd;
+    return file;
+  }
+
+  auto close() -> void {
+    if (_fd >= 0) {
+#if defined(_WIN32) || defined(_WIN64)
+      ::_close(_fd);
+#else
+      ::close(_fd);
+#endif
+      _fd = -1;
+    }
+  }
+
+ private:
+  static constexpr auto max_iov = 64UZ;
+
+  int _fd = -1;
+};
+
+/**
+ * @brief Open the file for appending, create it if not exists.
+ */
+inline auto open_log_file(const std::filesystem::path& path) -> result<log_file> {
+#if defined(_WIN32) || defined(_WIN64)
+  auto fd = ::_wopen(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY,
+                     _S_IREAD | _S_IWRITE);
+#else
+  auto fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+  if (fd < 0) {
+    return std::make_error_code(static_cast<std::errc>(errno));
+  }
+  return log_file::from_fd(fd);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Write log lines to files rotated by size and age.
+ *
+ * The active file is `<dir>/<app_name>.log`, rotated files are renamed to `<app_name>.1.log`,
+ * `<app_name>.2.log`, ... from the newest to the oldest. Each batch from the background thread of
+ * logger is written by one writev(), and the data is synced to the storage device at most once
+ * per sync_interval instead of once per record.
+ *
+ * In binary format the records are not formatted in process, the files use the extension ".alog"
+ * and are decoded by ascpp-logcat.
+ */
+class rotating_file_sink : public log_sink {
+ public:
+  enum file_format { text, binary };
+
+  struct options {
+    std::filesystem::path dir;  ///< Directory of the files, empty for get_log_dir()
+    file_format format = text;
+    std::uint64_t max_file_size = 64ULL << 20;
+    std::chrono::seconds max_file_age = std::chrono::hours(24);  ///< Zero to rotate only by size
+    std::size_t max_files = 8;  ///< Rotated files kept besides the active one
+    /// Minimum interval between two syncs, zero to sync after every batch
+    std::chrono::milliseconds sync_interval = std::chrono::seconds(1);
+  };
+
+  rotating_file_sink(rotating_file_sink&&) = delete;
+  rotating_file_sink(const rotating_file_sink&) = delete;
+  auto operator=(rotating_file_sink&&) -> rotating_file_sink& = delete;
+  auto operator=(const rotating_file_sink&) -> rotating_file_sink& = delete;
+
+  ~rotating_file_sink() override {
+    if (_unsynced) {
+      (void)_file.sync();
+    }
+  }
+
+  /**
+   * @brief Get the default directory of the log files: `get_cache_dir()/<org>/<app>/log`.
+   */
+  static auto get_log_dir(const app_info& info) -> result<std::filesystem::path> {
+    TRY_ASSIGN(auto cache_dir, get_cache_dir());
+    return cache_dir / info.org_name() / info.app_name() / "log";
+  }
+
+  static auto create(const app_info& info) -> result<std::shared_ptr<rotating_file_sink>> {
+    return create(info, options());
+  }
+
+  /**
+   * @brief Create the directory and open the active file for appending.
+   */
+  static auto create(const app_info& info, options opts)
+      -> result<std::shared_ptr<rotating_file_sink>> {
+    if (opts.dir.empty()) {
+      TRY_ASSIGN(opts.dir, get_log_dir(info));
+    }
+    TRY_CHECK(create_file_path(opts.dir / ""));
+    auto base = opts.dir / info.app_name();
+    auto sink = std::shared_ptr<rotating_file_sink>(
+        new rotating_file_sink(std::move(base), std::move(opts)));
+    TRY_CHECK(sink->_open());
+    return sink;
+  }
+
+  auto write(std::span<const log_entry> entries) -> void override {
+    if (_options.format == binary) {
+      _write_binary(entries);
+      return;
+    }
+    _chunks.clear();
+    for (const auto& entry : entries) {
+      if (_should_rotate(entry.time, entry.line.size())) {
+        _write_chunks();
+        _rotate();
+      }
+      // lines formatted in the same batch are usually contiguous, merge them into one chunk
+      if (!_chunks.empty() && _chunks.back().data() + _chunks.back().size() == entry.line.data()) {
+        _chunks.back() = std::string_view(_chunks.back().data(),
+                                          _chunks.back().size() + entry.line.size());
+      } else {
+        _chunks.push_back(entry.line);
+      }
+      _size += entry.line.size();
+    }
+    _write_chunks();
+  }
+
+  /**
+   * @brief Sync the file if sync_interval elapsed since the last sync.
+   */
+  auto flush() -> void override {
+    if (_unsynced && std::chrono::steady_clock::now() - _last_sync >= _options.sync_interval) {
+      (void)sync();
+    }
+  }
+
+  /**
+   * @brief Sync the file regardless of sync_interval.
+   */
+  auto sync() -> result<void> {
+    _last_sync = std::chrono::steady_clock::now();
+    _unsynced = false;
+    auto res = _file.sync();
+    if (!res) {
+      _error = res.error();
+    }
+    return res;
+  }
+
+  auto needs_text() const -> bool override { return _options.format == text; }
+
+  /**
+   * @brief Path of the active file.
+   */
+  auto path() const -> std::filesystem::path { return _rotated_path(0); }
+
+  /**
+   * @brief The last error met by the background thread while writing, rotating or syncing.
+   */
+  auto last_error() const -> std::error_code { return _error; }
+
+ private:
+  rotating_file_sink(std::filesystem::path base, options opts)
+      : _base(std::move(base)), _options(std::move(opts)) {}
+
+  auto _rotated_path(std::size_t index) const -> std::filesystem::path {
+    auto extension = _options.format == text ? std::string_view("log") : std::string_view("alog");
+    auto path = _base;
+    path += index == 0 ? std::format(".{}", extension) : std::format(".{}.{}", index, extension);
+    return path;
+  }
+
+  auto _open() -> result<void> {
+    TRY_ASSIGN(_file, detail::open_log_file(_rotated_path(0)));
+    TRY_ASSIGN(_size, _file.size());
+    // a file left by a previous run is as old as it was created, not reopened
+    if (_size == 0) {
+      _opened = std::chrono::system_clock::now();
+    } else {
+      TRY_ASSIGN(_opened, _file.created());
+    }
+    _encoder = detail::log_encoder();
+    return {};
+  }
+
+  /**
+   * @brief Whether the file must be rotated before writing a record of size bytes logged at time.
+   */
+  auto _should_rotate(std::chrono::system_clock::time_point time, std::uint64_t size) const
+      -> bool {
+    if (_size == 0) {
+      return false;
+    }
+    if (_size + size > _options.max_file_size) {
+      return true;
+    }
+    return _options.max_file_age.count() > 0 && time - _opened >= _options.max_file_age;
+  }
+
+  auto _write_binary(std::span<const log_entry> entries) -> void {
+    _chunks.clear();
+    _buffer.clear();
+    auto encode = [this](const log_entry& entry) {
+      if (!_encoder.started()) {
+        _encoder.start(_buffer, entry.record->timestamp);
+      }
+      _encoder.encode(_buffer, entry);
+    };
+    for (const auto& entry : entries) {
+      // the size of a record is only known once encoded, and it is encoded again after rotating
+      // since the new file starts with a new header and format table
+      auto begin = _buffer.size();
+      encode(entry);
+      if (_should_rotate(entry.time, _buffer.size() - begin)) {
+        _buffer.resize(begin);
+        _write_chunks();
+        _rotate();
+        begin = _buffer.size();
+        encode(entry);
+      }
+      _size += _buffer.size() - begin;
+    }
+    _write_chunks();
+  }
+
+  auto _write_chunks() -> void {
+    if (!_buffer.empty()) {
+      _chunks.assign({_buffer});
+    }
+    if (_chunks.empty() || !_file.is_open()) {
+      _chunks.clear();
+      _buffer.clear();
+      return;
+    }
+    auto res = _file.write(_chunks);
+    if (!res) {
+      _error = res.error();
+    }
+    _chunks.clear();
+    _buffer.clear();
+    _unsynced = true;
+    if (_options.sync_interval.count() == 0) {
+      (void)sync();
+    }
+  }
+
+  auto _rotate() -> void {
+    if (_unsynced) {
+      (void)sync();
+    }
+    _file.close();
+    auto err = std::error_code();
+    if (_options.max_files == 0) {
+      std::filesystem::remove(_rotated_path(0), err);
+    } else {
+      for (auto i = _options.max_files - 1; i > 0; --i) {
+        std::filesystem::rename(_rotated_path(i), _rotated_path(i + 1), err);
+      }
+      std::filesystem::rename(_rotated_path(0), _rotated_path(1), err);
+      if (err) {
+        _error = err;
+      }
+    }
+    auto res = _open();
+    if (!res) {
+      _error = res.error();
+      _size = 0;
+    }
+  }
+
+  std::filesystem::path _base;  ///< Path of the active file without the extension
+  options _options;
+  detail::log_file _file;
+  std::uint64_t _size = 0;
+  std::chrono::system_clock::time_point _opened;
+  std::chrono::steady_clock::time_point _last_sync = std::chrono::steady_clock::now();
+  bool _unsynced = false;
+  std::error_code _error;
+  std::vector<std::string_view> _chunks;
+  std::string _buffer;  ///< Encoded records in binary format
+  detail::log_encoder _encoder;
+};
+
+}  // namespace ascpp
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32) || defined(_WIN64)
+// keep the macros ERROR, min and max of windows.h out of the users of this header
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef NOGDI
+#define NOGDI
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/error.hpp"
+
+namespace ascpp {
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * The pages are shared with the page cache, so the processes mapping the same file share the
+ * physical memory, and nothing is read until it is accessed.
+ */
+class mapped_file {
+ public:
+  mapped_file() = default;
+
+  mapped_file(mapped_file&& other) noexcept
+      : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)) {}
+
+  mapped_file(const mapped_file&) = delete;
+
+  auto operator=(mapped_file&& other) noexcept -> mapped_file& {
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    return *this;
+  }
+
+  auto operator=(const mapped_file&) -> mapped_file& = delete;
+
+  ~mapped_file() { unmap(); }
+
+  auto data() const -> const char* { return _data; }
+
+  auto size() const -> std::size_t { return _size; }
+
+  auto view() const -> std::string_view { return {_data, _size}; }
+
+  /**
+   * @brief Take the ownership of a mapping.
+   */
+  static auto from_mapping(const char* data, std::size_t size) -> mapped_file {
+    auto file = mapped_file();
+    file._data = data;
+    file._size = size;
+    return file;
+  }
+
+  auto unmap() -> void {
+    if (_data != nullptr) {
+#if defined(_WIN32) || defined(_WIN64)
+      ::UnmapViewOfFile(_data);
+#else
+      ::munmap(const_cast<char*>(_data), _size);
+#endif
+      _data = nullptr;
+      _size = 0;
+    }
+  }
+
+ private:
+  const char* _data = nullptr;
+  std::size_t _size = 0;
+};
+
+/**
+ * @brief Map the whole file for reading, an empty file is mapped to an empty view.
+ */
+inline auto map_file(const std::filesystem::path& path) -> result<mapped_file> {
+#if defined(_WIN32) || defined(_WIN64)
+  auto file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return std::error_code(static_cast<int>(::GetLastError()), std::system_category());
+  }
+  auto size = LARGE_INTEGER();
+  if (!::GetFileSizeEx(file, &size)) {
+    auto err = ::GetLastError();
+    ::CloseHandle(file);
+    return std::error_code(static_cast<int>(err), std::system_category());
+  }
+  if (size.QuadPart == 0) {
+    ::CloseHandle(file);
+    return mapped_file();
+  }
+  auto mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  ::CloseHandle(file);
+  if (mapping == nullptr) {
+    return std::error_code(static_cast<int>(::GetLastError()), std::system_category());
+  }
+  auto* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  ::CloseHandle(mapping);
+  if (data == nullptr) {
+    return std::error_code(static_cast<int>(::GetLastError()), std::system_category());
+  }
+  return mapped_file::from_mapping(static_cast<const char*>(data),
+                                   static_cast<std::size_t>(size.QuadPart));
+#else
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::make_error_code(static_cast<std::errc>(errno));
+  }
+  struct ::stat st {};
+  if (::fstat(fd, &st) != 0) {
+    auto err = errno;
+    ::close(fd);
+    return std::make_error_code(static_cast<std::errc>(err));
+  }
+  if (st.st_size == 0) {
+    ::close(fd);
+    return mapped_file();
+  }
+  auto size = static_cast<std::size_t>(st.st_size);
+  auto* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return std::make_error_code(static_cast<std::errc>(errno));
+  }
+  return mapped_file::from_mapping(static_cast<const char*>(data), size);
+#endif
+}
+
+}  // namespace ascpp
@@ -36,10 +36,10 @@ inline auto get_env(const std::string& name) -> result<std::string> {
 #else
   auto* value = std::getenv(name.c_str());
   if (value == nullptr) {
-    return make_error_code(error::GET_ENV_ERROR);
+    return make_error_code(error::get_env_failed);
   }
   if (std::strlen(value) == 0) {
-    return make_error_code(error::GET_EMPTY_ENV);
+    return make_error_code(error::get_empty_env);
   }
   return value;
 #endif
@@ -56,7 +56,7 @@ inline auto set_env(const std::string& name, const std::string& value) -> result
   return {};
 #else
   if (::setenv(name.c_str(), value.c_str(), 1)) {
-    return make_error_code(error::SET_ENV_ERROR);
+    return make_error_code(error::set_env_failed);
   }
   return {};
 #endif
@@ -86,13 +86,13 @@ inline auto get_config_dir() -> result<std::filesystem::path> {
   }
   dir = get_env("HOME");
   if (dir) {
-    return std::filesystem::path(dir.Unwrap()) / ".config";
+    return std::filesystem::path(dir.value()) / ".config";
   }
   return dir;
 #elif defined(TARGET_OS_MAC)
   auto dir = get_env("HOME");
   if (dir) {
-    return std::filesystem::path(dir.Unwrap()) / "Library/Application Support";
+    return std::filesystem::path(dir.value()) / "Library/Application Support";
   }
   return dir;
 #endif
@@ -111,13 +111,13 @@ inline auto get_cache_dir() -> result<std::filesystem::path> {
   }
   dir = get_env("HOME");
   if (dir) {
-    return std::filesystem::path(dir.Unwrap()) / ".cache";
+    return std::filesystem::path(dir.value()) / ".cache";
   }
   return dir;
 #elif defined(TARGET_OS_MAC)
   auto dir = get_env("HOME");
   if (dir) {
-    return std::filesystem::path(dir.Unwrap()) / "Library/Caches";
+    return std::filesystem::path(dir.value()) / "Library/Caches";
   }
   return dir;
 #endif
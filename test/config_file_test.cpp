@@ -0,0 +1,192 @@
+#include "storage/config_file.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "app_info.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+auto write_file(const std::filesystem::path& path, const std::string& content) -> void {
+  auto out = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  out << content;
+}
+
+}  // namespace
+
+TEST(TestConfigFile, ConfigPath) {
+  auto path = ascpp::get_config_path(info, ascpp::config_scope::user).value();
+  EXPECT_EQ(path, ascpp::get_config_dir().value() / "mrbeardad" / "ascpp_user.json");
+}
+
+TEST(TestConfigFile, ReadFile) {
+  auto path = std::filesystem::temp_directory_path() / "ascpp_config_read_test.json";
+  write_file(path, "");
+  EXPECT_EQ(ascpp::read_config_file(path).value(), nlohmann::json::object());
+  write_file(path, R"({"port": 80})");
+  EXPECT_EQ(ascpp::read_config_file(path).value()["port"], 80);
+  write_file(path, R"({"port": )");
+  EXPECT_EQ(ascpp::read_config_file(path).error(), ascpp::error::invalid_config_file);
+  std::filesystem::remove(path);
+  EXPECT_FALSE(ascpp::read_config_file(path).has_value());
+}
+
+TEST(TestConfigFile, WriteFile) {
+  auto dir = std::filesystem::temp_directory_path() / "ascpp_config_write_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto path = dir / "ascpp_user.json";
+  write_file(path, R"({"port": 80})");
+
+  auto file_count = [&] {
+    return std::distance(std::filesystem::directory_iterator(dir),
+                         std::filesystem::directory_iterator());
+  };
+  ascpp::write_config_file(path, {{"port", 8080}}).value();
+  EXPECT_EQ(ascpp::read_config_file(path).value()["port"], 8080);
+  EXPECT_EQ(file_count(), 1);
+
+  // concurrent writers each write their own temporary file, the file is one of their contents
+  auto writers = std::vector<std::thread>();
+  for (auto i = 0; i < 8; ++i) {
+    writers.emplace_back([&, i] {
+      auto data = nlohmann::json{{"port", i}, {"pad", std::string(64 * 1024, 'x')}};
+      EXPECT_TRUE(ascpp::write_config_file(path, data));
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  auto data = ascpp::read_config_file(path).value();
+  EXPECT_LT(data["port"].get<int>(), 8);
+  EXPECT_EQ(data["pad"].get_ref<const std::string&>().size(), 64 * 1024);
+  EXPECT_EQ(file_count(), 1);
+
+  // no temporary file is left if the file can not be replaced
+  auto sub_dir = dir / "sub.json";
+  std::filesystem::create_directories(sub_dir / "child");
+  EXPECT_FALSE(ascpp::write_config_file(sub_dir, {{"port", 0}}).has_value());
+  EXPECT_EQ(file_count(), 2);
+  std::filesystem::remove_all(dir);
+}
+
+TEST(TestConfigFile, BinaryCache) {
+  auto dir = std::filesystem::temp_directory_path() / "ascpp_config_cache_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto path = dir / "ascpp_user.json";
+  auto cache_path = dir / "cache" / "ascpp_user.msgpack";
+  write_file(path, R"({"port": 80, "hosts": ["a", "b"]})");
+
+  // the first read builds the cache, the second one decodes it
+  EXPECT_EQ(ascpp::read_config_file(path, cache_path).value()["port"], 80);
+  ASSERT_TRUE(std::filesystem::exists(cache_path));
+  auto cache_time = std::filesystem::last_write_time(cache_path);
+  EXPECT_EQ(ascpp::read_config_file(path, cache_path).value()["hosts"][1], "b");
+  EXPECT_EQ(std::filesystem::last_write_time(cache_path), cache_time);
+
+  // a changed file makes the cache stale, even if the modification time is restored
+  auto mtime = std::filesystem::last_write_time(path);
+  auto text = std::string(R"({"port": 81, "hosts": ["a", "b"]})");
+  write_file(path, text);
+  std::filesystem::last_write_time(path, mtime);
+  EXPECT_EQ(ascpp::read_config_file(path, cache_path).value()["port"], 81);
+
+  // a corrupted cache is rebuilt
+  write_file(cache_path, "garbage");
+  EXPECT_EQ(ascpp::read_config_file(path, cache_path).value()["port"], 81);
+  auto mtime_ticks = ascpp::detail::get_config_mtime(path).value();
+  auto cached = ascpp::detail::read_config_cache(cache_path, mtime_ticks,
+                                                 ascpp::detail::hash_config_text(text));
+  EXPECT_EQ(cached.value()["port"], 81);
+  std::filesystem::remove_all(dir);
+}
+
+TEST(TestConfigFile, WatchReload) {
+  auto dir = std::filesystem::temp_directory_path() / "ascpp_config_watch_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto path = dir / "ascpp_user.json";
+  write_file(path, R"({"port": 80})");
+
+  auto ctx = asio::io_context();
+  auto cfg = ascpp::config();
+  auto opts = ascpp::config_file::options();
+  opts.debounce = std::chrono::milliseconds(50);
+  opts.writable = false;
+  auto file = ascpp::config_file::create(ctx, cfg, path, opts).value();
+  EXPECT_EQ((*cfg.get())["port"], 80);
+  EXPECT_EQ(cfg.version(), 1);
+
+  auto published = std::promise<int>();
+  cfg.subscribe([&](const ascpp::config::snapshot& data) {
+    published.set_value((*data)["port"].get<int>());
+  });
+  auto runner = std::jthread([&] { ctx.run(); });
+
+  // several writes in a row are debounced into one reload, an invalid file is skipped
+  write_file(path, R"({"port": )");
+  for (auto port = 81; port <= 85; ++port) {
+    write_file(path, std::format(R"({{"port": {}}})", port));
+  }
+  // replacing the file by a rename is detected as well
+  write_file(dir / "tmp.json", R"({"port": 86})");
+  std::filesystem::rename(dir / "tmp.json", path);
+  auto future = published.get_future();
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(future.get(), 86);
+  EXPECT_EQ(cfg.version(), 2);
+
+  file->stop();
+  runner.join();
+  std::filesystem::remove_all(dir);
+}
+
+TEST(TestConfigFile, Persist) {
+  auto dir = std::filesystem::temp_directory_path() / "ascpp_config_persist_test";
+  std::filesystem::remove_all(dir);
+  auto path = dir / "ascpp_user.json";
+
+  auto ctx = asio::io_context();
+  auto cfg = ascpp::config();
+  auto opts = ascpp::config_file::options();
+  opts.debounce = std::chrono::milliseconds(10);
+  opts.flush_window = std::chrono::milliseconds(100);
+  opts.view_path = dir / "ascpp_user.view";
+  auto file = ascpp::config_file::create(ctx, cfg, path, opts).value();
+  auto reloaded = std::atomic<int>(0);
+  cfg.subscribe([&](const auto&) { reloaded.fetch_add(1); });
+  auto runner = std::jthread([&] { ctx.run(); });
+
+  // updates within the window are coalesced into one write
+  for (auto i = 1; i <= 100; ++i) {
+    EXPECT_TRUE(cfg.update([i](nlohmann::json& data) { data["count"] = i; }));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+  EXPECT_EQ(ascpp::read_config_file(path).value()["count"], 100);
+  // the file written is not reloaded and published again
+  EXPECT_EQ(reloaded.load(), 100);
+
+  EXPECT_TRUE(cfg.update([](nlohmann::json& data) { data["count"] = 0; }));
+  file->stop();
+  runner.join();
+  EXPECT_EQ(ascpp::read_config_file(path).value()["count"], 0);
+  auto view = ascpp::open_config_view(dir / "ascpp_user.view").value();
+  EXPECT_EQ(view.find("/count").value().get<int>().value(), 0);
+  EXPECT_GT(file->last_sync_time(), file->last_modified_time());
+  std::filesystem::remove_all(dir);
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
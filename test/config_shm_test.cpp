@@ -0,0 +1,143 @@
+#include "storage/config_shm.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+TEST(TestConfigShm, LeaderFollower) {
+  auto info = ascpp::app_info("ascpp_test", "config/shm", "", 1, 0, 0);
+  auto name = ascpp::get_config_shm_name(info);
+  EXPECT_EQ(name, "/ascpp_test.config_shm.config");
+
+  auto cfg = ascpp::config(nlohmann::json{{"server", {{"port", 80}}}});
+  auto leader = ascpp::config_shm_leader::create(cfg, name, 4096).value();
+  auto follower = ascpp::config_shm_follower::open(name).value();
+  EXPECT_EQ(follower->get()->find("/server/port").value().get<int>().value(), 80);
+  EXPECT_EQ(follower->version(), 0);
+  EXPECT_FALSE(follower->poll().value());
+
+  auto old = follower->get();
+  EXPECT_TRUE(cfg.update([](nlohmann::json& data) { data["server"]["port"] = 8080; }));
+  EXPECT_TRUE(follower->poll().value());
+  EXPECT_EQ(follower->get()->find("/server/port").value().get<int>().value(), 8080);
+  EXPECT_EQ(follower->version(), 1);
+  EXPECT_EQ(old->find("/server/port").value().get<int>().value(), 80);
+
+  // a config exceeding the capacity is not shared, the followers keep the last one
+  EXPECT_TRUE(cfg.publish({{"blob", std::string(8192, 'x')}}));
+  EXPECT_EQ(leader->last_error(), ascpp::error::OUT_OF_RANGE);
+  EXPECT_FALSE(follower->poll().value());
+
+  leader.reset();
+  EXPECT_FALSE(ascpp::config_shm_follower::open(name));
+  EXPECT_EQ(follower->get()->find("/server/port").value().get<int>().value(), 8080);
+}
+
+TEST(TestConfigShm, ConcurrentPoll) {
+  auto name = std::string("/ascpp_test.concurrent.config");
+  auto cfg = ascpp::config(nlohmann::json{{"a", 0}, {"b", 0}});
+  auto leader = ascpp::config_shm_leader::create(cfg, name, 4096).value();
+  auto follower = ascpp::config_shm_follower::open(name).value();
+
+  auto stop = std::atomic<bool>(false);
+  auto torn = 0;
+  auto reader = std::jthread([&] {
+    while (!stop.load()) {
+      if (!follower->poll().value()) {
+        continue;
+      }
+      // a snapshot copied out while the leader writes is retried, never seen torn
+      auto view = follower->get();
+      if (view->find("/a").value().get<int>().value() !=
+          view->find("/b").value().get<int>().value()) {
+        ++torn;
+      }
+    }
+  });
+  for (auto i = 1; i <= 2000; ++i) {
+    EXPECT_TRUE(cfg.publish({{"a", i}, {"b", i}}));
+  }
+  stop.store(true);
+  reader.join();
+  EXPECT_EQ(torn, 0);
+  EXPECT_TRUE(follower->poll());
+  EXPECT_EQ(follower->version(), 2000);
+}
+
+TEST(TestConfigShm, SingleLeader) {
+  auto name = std::string("/ascpp_test.single.config");
+  auto cfg = ascpp::config(nlohmann::json{{"a", 1}});
+  auto leader = ascpp::config_shm_leader::create(cfg, name, 4096).value();
+  auto other_cfg = ascpp::config(nlohmann::json{{"a", 2}});
+  EXPECT_EQ(ascpp::config_shm_leader::create(other_cfg, name, 4096).error(),
+            std::errc::device_or_resource_busy);
+  auto follower = ascpp::config_shm_follower::open(name).value();
+  EXPECT_EQ(follower->get()->find("/a").value().get<int>().value(), 1);
+
+  leader.reset();
+  EXPECT_TRUE(ascpp::config_shm_leader::create(other_cfg, name, 4096));
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+namespace {
+
+// run a leader in a child process exiting without removing the segment, as if it crashed
+void run_crashing_leader(const std::string& name, const nlohmann::json& data,
+                         std::size_t capacity) {
+  auto pid = ::fork();
+  if (pid == 0) {
+    auto cfg = ascpp::config(data);
+    auto leader = ascpp::config_shm_leader::create(cfg, name, capacity);
+    ::_exit(leader ? 0 : 1);
+  }
+  auto status = 0;
+  ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+}  // namespace
+
+TEST(TestConfigShm, CrashedLeader) {
+  auto name = std::string("/ascpp_test.crashed.config");
+  run_crashing_leader(name, {{"a", 1}}, 8192);
+  auto follower = ascpp::config_shm_follower::open(name).value();
+  EXPECT_EQ(follower->get()->find("/a").value().get<int>().value(), 1);
+
+  // a leader crashing in the middle of a write leaves the sequence odd
+  auto segment = ascpp::detail::map_config_shm(name, 1).value();
+  auto* header = reinterpret_cast<ascpp::detail::config_shm_header*>(
+      const_cast<char*>(segment.data()));
+  header->sequence.fetch_add(1);
+  EXPECT_FALSE(follower->poll().value());
+  EXPECT_EQ(follower->get()->find("/a").value().get<int>().value(), 1);
+  EXPECT_FALSE(ascpp::config_shm_follower::open(name));
+
+  // the restarted leader keeps the size of the segment mapped by the followers
+  run_crashing_leader(name, {{"blob", std::string(4096, 'x')}}, 64);
+  EXPECT_EQ(header->capacity, 8192);
+  EXPECT_EQ(header->sequence.load() % 2, 0);
+  EXPECT_TRUE(follower->poll().value());
+  EXPECT_EQ(follower->get()->find("/blob").value().get<std::string_view>().value().size(), 4096);
+
+  // and the followers map it again when a leader grows it
+  auto grown_cfg = ascpp::config(nlohmann::json{{"blob", std::string(12000, 'x')}});
+  auto grown = ascpp::config_shm_leader::create(grown_cfg, name, 16384).value();
+  EXPECT_TRUE(follower->poll().value());
+  EXPECT_EQ(follower->get()->find("/blob").value().get<std::string_view>().value().size(), 12000);
+}
+
+#endif
+
+// NOLINTEND(modernize-use-trailing-return-type)
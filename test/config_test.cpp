@@ -0,0 +1,284 @@
+#include "storage/config.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+TEST(TestConfig, Snapshot) {
+  auto cfg = ascpp::config(nlohmann::json{{"server", {{"port", 80}}}});
+  EXPECT_EQ(cfg.version(), 0);
+
+  auto old = cfg.get();
+  EXPECT_EQ(cfg.update([](nlohmann::json& data) { data["server"]["port"] = 8080; }).value(), 1);
+  EXPECT_EQ((*old)["server"]["port"], 80);
+  EXPECT_EQ((*cfg.get())["server"]["port"], 8080);
+
+  EXPECT_EQ(cfg.publish({{"name", "ascpp"}}).value(), 2);
+  EXPECT_FALSE(cfg.get()->contains("server"));
+  EXPECT_EQ(cfg.version(), 2);
+}
+
+TEST(TestConfig, UpdateThrows) {
+  auto cfg = ascpp::config(nlohmann::json{{"retry", 3}});
+  EXPECT_THROW((void)cfg.update([](nlohmann::json& data) {
+    data["retry"] = 4;
+    throw std::runtime_error("rejected");
+  }),
+               std::runtime_error);
+  EXPECT_EQ((*cfg.get())["retry"], 3);
+  EXPECT_EQ(cfg.version(), 0);
+}
+
+TEST(TestConfig, Observer) {
+  auto cfg = ascpp::config();
+  auto seen = std::vector<int>();
+  auto id = cfg.subscribe(
+      [&](const ascpp::config::snapshot& data) { seen.push_back((*data)["n"].get<int>()); });
+  EXPECT_TRUE(cfg.publish({{"n", 1}}));
+  EXPECT_TRUE(cfg.update([](nlohmann::json& data) { data["n"] = 2; }));
+  cfg.unsubscribe(id);
+  EXPECT_TRUE(cfg.publish({{"n", 3}}));
+  EXPECT_EQ(seen, std::vector<int>({1, 2}));
+}
+
+TEST(TestConfig, ReentrantObserver) {
+  auto cfg = ascpp::config(nlohmann::json{{"n", 0}});
+  auto seen = std::vector<std::pair<int, std::uint64_t>>();
+  auto id = std::uint64_t(0);
+  id = cfg.subscribe([&](const ascpp::config::snapshot& data, ascpp::config::changes /*paths*/,
+                         std::uint64_t version) {
+    auto n = (*data)["n"].get<int>();
+    seen.emplace_back(n, version);
+    // no lock is held, the publication is delivered once this one is
+    if (n < 3) {
+      EXPECT_TRUE(cfg.validate({{"n", n + 1}}));
+      EXPECT_EQ(cfg.publish({{"n", n + 1}}).value(), version + 1);
+      EXPECT_EQ(seen.size(), static_cast<std::size_t>(n));
+    } else {
+      cfg.unsubscribe(id);
+    }
+  });
+  EXPECT_TRUE(cfg.publish({{"n", 1}}));
+  EXPECT_EQ(seen, (std::vector<std::pair<int, std::uint64_t>>({{1, 1}, {2, 2}, {3, 3}})));
+  EXPECT_TRUE(cfg.publish({{"n", 4}}));
+  EXPECT_EQ(seen.size(), 3);
+
+  // unsubscribe() returns once the call running on another thread is done
+  auto entered = std::atomic<bool>(false);
+  auto finished = std::atomic<bool>(false);
+  id = cfg.subscribe([&](const ascpp::config::snapshot& /*data*/) {
+    entered.store(true);
+    entered.notify_all();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    finished.store(true);
+  });
+  auto writer = std::jthread([&] { EXPECT_TRUE(cfg.publish({{"n", 5}})); });
+  entered.wait(false);
+  cfg.unsubscribe(id);
+  EXPECT_TRUE(finished.load());
+}
+
+TEST(TestConfig, ConcurrentReadWrite) {
+  auto cfg = ascpp::config(nlohmann::json{{"a", 0}, {"b", 0}});
+  auto stop = std::atomic<bool>(false);
+  auto readers = std::vector<std::jthread>();
+  auto torn = std::atomic<int>(0);
+  for (auto i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      while (!stop.load()) {
+        // a writer always changes both keys together, a snapshot never shows them apart
+        auto data = cfg.get();
+        if ((*data)["a"] != (*data)["b"]) {
+          torn.fetch_add(1);
+        }
+      }
+    });
+  }
+
+  auto writers = std::vector<std::jthread>();
+  for (auto i = 0; i < 2; ++i) {
+    writers.emplace_back([&] {
+      for (auto j = 0; j < 1000; ++j) {
+        (void)cfg.update([](nlohmann::json& data) {
+          data["a"] = data["a"].get<int>() + 1;
+          data["b"] = data["b"].get<int>() + 1;
+        });
+      }
+    });
+  }
+  writers.clear();
+  stop.store(true);
+  readers.clear();
+
+  EXPECT_EQ(torn.load(), 0);
+  EXPECT_EQ((*cfg.get())["a"], 2000);
+  EXPECT_EQ(cfg.version(), 2000);
+}
+
+TEST(TestConfig, BindKey) {
+  auto cfg = ascpp::config(nlohmann::json{{"server", {{"port", 80}, {"host", "localhost"}}}});
+  auto port = cfg.bind<int>("/server/port");
+  auto host = cfg.bind<std::string>("/server/host");
+  auto timeout = cfg.bind<int>("/server/timeout");
+  EXPECT_EQ(port.get().value(), 80);
+  EXPECT_EQ(host.get().value(), "localhost");
+  EXPECT_EQ(timeout.get().error(), ascpp::error::config_not_found);
+  EXPECT_EQ(timeout.get().value_or(30), 30);
+
+  EXPECT_TRUE(cfg.update([](nlohmann::json& data) {
+    data["server"]["port"] = "http";
+    data["server"]["timeout"] = 10;
+  }));
+  EXPECT_EQ(port.get().error(), ascpp::error::config_type_mismatch);
+  EXPECT_EQ(timeout.get().value(), 10);
+
+  EXPECT_TRUE(cfg.publish(nlohmann::json::array()));
+  EXPECT_EQ(port.get().error(), ascpp::error::config_not_found);
+  EXPECT_EQ(port.pointer().to_string(), "/server/port");
+
+  EXPECT_THROW((void)cfg.bind<int>("server/port"), std::logic_error);
+}
+
+TEST(TestConfig, Schema) {
+  auto schema = ascpp::config_schema();
+  schema.add<int>("/server/port").required().with_range(1, 65535);
+  schema.add<std::string>("/server/host").with_limits({"localhost", "0.0.0.0"});
+  schema.add<double>("/server/ratio").with_limits([](const double& ratio) { return ratio < 1; });
+  schema.add<std::uint8_t>("/retry");
+  schema.add<bool>("/debug");
+  schema.add<std::vector<int>>("/workers");
+  // the rules are sorted by path when compiled, a path shared by rules is entered once
+  EXPECT_EQ(schema.compile().size(), 24);
+
+  auto cfg = ascpp::config(nlohmann::json{{"server", {{"host", "localhost"}}}});
+  EXPECT_EQ(cfg.set_schema(schema).error(), ascpp::error::config_not_found);
+  EXPECT_TRUE(cfg.publish({{"server", {{"port", 80}}}, {"debug", true}, {"workers", {1, 2}}}));
+  EXPECT_TRUE(cfg.set_schema(schema));
+
+  auto expect_rejected = [&](const nlohmann::json& data, ascpp::error::errc ec) {
+    auto version = cfg.version();
+    EXPECT_EQ(cfg.publish(data).error(), ec) << data.dump();
+    EXPECT_EQ(cfg.version(), version);
+    EXPECT_EQ((*cfg.get())["server"]["port"], 80);
+  };
+  expect_rejected(nlohmann::json::object(), ascpp::error::config_not_found);
+  expect_rejected({{"server", 80}}, ascpp::error::config_not_found);
+  expect_rejected({{"server", {{"port", "80"}}}}, ascpp::error::config_type_mismatch);
+  expect_rejected({{"server", {{"port", 80.5}}}}, ascpp::error::config_type_mismatch);
+  expect_rejected({{"server", {{"port", 0}}}}, ascpp::error::config_out_of_limits);
+  expect_rejected({{"server", {{"port", 80}, {"host", "remote"}}}},
+                  ascpp::error::config_out_of_limits);
+  expect_rejected({{"server", {{"port", 80}, {"ratio", 1.5}}}},
+                  ascpp::error::config_out_of_limits);
+  expect_rejected({{"server", {{"port", 80}}}, {"retry", 256}}, ascpp::error::config_out_of_limits);
+  expect_rejected({{"server", {{"port", 80}}}, {"retry", -1}}, ascpp::error::config_out_of_limits);
+  expect_rejected({{"server", {{"port", 80}}}, {"debug", 1}}, ascpp::error::config_type_mismatch);
+  expect_rejected({{"server", {{"port", 80}}}, {"workers", {"a"}}},
+                  ascpp::error::config_type_mismatch);
+
+  auto res = cfg.update([](nlohmann::json& data) { data["server"]["port"] = 70000; });
+  EXPECT_EQ(res.error(), ascpp::error::config_out_of_limits);
+  EXPECT_NE(ascpp::format_error_context(res.error()).find("/server/port"), std::string::npos);
+  EXPECT_EQ(cfg.update([](nlohmann::json& data) { data["server"]["ratio"] = 0.5; }).value(), 2);
+
+  EXPECT_THROW(schema.add<int>("server"), std::logic_error);
+
+  // array elements are named by their indices
+  auto servers = ascpp::config_schema();
+  servers.add<int>("/servers/1/port").required().with_range(1, 65535);
+  auto validator = servers.compile();
+  EXPECT_TRUE(validator.validate({{"servers", {{{"port", 0}}, {{"port", 80}}}}}));
+  EXPECT_EQ(validator.validate({{"servers", {{{"port", 80}}, {{"port", 0}}}}}).error(),
+            ascpp::error::config_out_of_limits);
+  EXPECT_EQ(validator.validate({{"servers", {{{"port", 80}}}}}).error(),
+            ascpp::error::config_not_found);
+}
+
+TEST(TestConfig, Patch) {
+  auto cfg = ascpp::config(nlohmann::json{{"server", {{"port", 80}, {"hosts", {"a"}}}}, {"n", 1}});
+  auto seen = std::vector<std::string>();
+  cfg.subscribe([&](const ascpp::config::snapshot& /*data*/, ascpp::config::changes paths) {
+    for (const auto& path : paths) {
+      seen.push_back(path.to_string());
+    }
+  });
+
+  EXPECT_EQ(cfg.patch(nlohmann::json::parse(R"([
+    {"op": "test", "path": "/n", "value": 1},
+    {"op": "replace", "path": "/server/port", "value": 8080},
+    {"op": "add", "path": "/server/hosts/-", "value": "b"},
+    {"op": "move", "from": "/n", "path": "/m"}
+  ])")).value(), 1);
+  EXPECT_EQ(*cfg.get(), nlohmann::json::parse(
+                            R"({"server": {"port": 8080, "hosts": ["a", "b"]}, "m": 1})"));
+  EXPECT_EQ(seen, std::vector<std::string>({"/server/port", "/server/hosts/-", "/n", "/m"}));
+
+  // a failed operation rejects the whole patch
+  seen.clear();
+  auto res = cfg.patch(nlohmann::json::parse(R"([
+    {"op": "remove", "path": "/m"},
+    {"op": "test", "path": "/server/port", "value": 80}
+  ])"));
+  EXPECT_EQ(res.error(), ascpp::error::config_patch_failed);
+  EXPECT_TRUE(cfg.get()->contains("m"));
+  EXPECT_EQ(cfg.version(), 1);
+  EXPECT_TRUE(seen.empty());
+
+  auto before = cfg.get();
+  EXPECT_EQ(cfg.merge_patch(nlohmann::json::parse(
+                                R"({"server": {"port": 9090, "tls": {"on": true}}, "m": null})"))
+                .value(),
+            2);
+  // the subtrees not in the patch are shared with the previous snapshot
+  EXPECT_EQ(&(*cfg.get())["server"]["hosts"], &(*before)["server"]["hosts"]);
+  EXPECT_EQ(*cfg.get(),
+            nlohmann::json::parse(
+                R"({"server": {"port": 9090, "hosts": ["a", "b"], "tls": {"on": true}}})"));
+  EXPECT_EQ(seen, std::vector<std::string>({"/m", "/server/port", "/server/tls"}));
+
+  // removing a missing key or setting the current values changes nothing and publishes nothing
+  EXPECT_EQ(cfg.merge_patch({{"x", nullptr}}).value(), 2);
+  EXPECT_EQ(cfg.merge_patch({{"server", {{"port", 9090}, {"tls", {{"on", true}}}}}}).value(), 2);
+  EXPECT_EQ(seen.size(), 3);
+
+  // only the rules on the changed paths are checked
+  auto checks = std::vector<std::string>();
+  auto schema = ascpp::config_schema();
+  schema.add<int>("/server/port").with_limits([&](const int& /*port*/) {
+    checks.emplace_back("port");
+    return true;
+  });
+  schema.add<bool>("/server/tls/on").with_limits([&](const bool& /*on*/) {
+    checks.emplace_back("tls");
+    return true;
+  });
+  EXPECT_TRUE(cfg.set_schema(schema));
+  checks.clear();
+  EXPECT_TRUE(cfg.merge_patch({{"server", {{"port", 443}}}}));
+  EXPECT_EQ(checks, std::vector<std::string>({"port"}));
+  checks.clear();
+  EXPECT_TRUE(cfg.patch(nlohmann::json::parse(R"([{"op": "remove", "path": "/server/tls"}])")));
+  EXPECT_EQ(checks, std::vector<std::string>());
+  checks.clear();
+  auto add_server = nlohmann::json::parse(R"([{"op": "add", "path": "/server", "value": {}}])");
+  EXPECT_TRUE(cfg.patch(add_server));
+  EXPECT_EQ(checks, std::vector<std::string>());
+  EXPECT_TRUE(cfg.merge_patch({{"server", {{"port", 80}, {"tls", {{"on", false}}}}}}));
+  EXPECT_EQ(checks, std::vector<std::string>({"port", "tls"}));
+
+  seen.clear();
+  EXPECT_TRUE(cfg.publish({{"n", 1}}));
+  EXPECT_EQ(seen, std::vector<std::string>({""}));
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,137 @@
+#include "storage/config_tree.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "storage/config_view.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+auto sample_config() -> nlohmann::json {
+  return nlohmann::json::parse(R"({
+    "server": {"port": 8080, "hosts": ["a", "b", "c"]},
+    "limits": {"max": 18446744073709551615, "min": -5, "ratio": 0.5},
+    "empty": {},
+    "none": null,
+    "a/b~c": 1
+  })");
+}
+
+}  // namespace
+
+TEST(TestConfigTree, Lookup) {
+  auto data = sample_config();
+  auto tree = ascpp::config_node::make(data);
+  EXPECT_TRUE(*tree == data);
+  EXPECT_EQ(tree->to_json(), data);
+  EXPECT_EQ(tree->size(), 5);
+
+  EXPECT_EQ((*tree)["server"]["port"].get<int>(), 8080);
+  EXPECT_EQ((*tree)["server"]["hosts"][1].get<std::string>(), "b");
+  EXPECT_EQ((*tree)["limits"]["max"].get<std::uint64_t>(), 18446744073709551615ULL);
+  EXPECT_TRUE((*tree)["missing"]["key"].is_null());
+  EXPECT_EQ(tree->find_pointer("/a~1b~0c")->get<int>(), 1);
+  EXPECT_EQ(tree->find_pointer("/server/hosts/2")->get<std::string>(), "c");
+  EXPECT_EQ(tree->find_pointer("/server/hosts/3"), nullptr);
+  EXPECT_EQ(tree->find_pointer("server"), nullptr);
+  EXPECT_EQ((*tree)["server"]["hosts"].get<std::vector<std::string>>(),
+            std::vector<std::string>({"a", "b", "c"}));
+
+  // the flat layout built from a tree is the same as from the DOM
+  EXPECT_EQ(ascpp::build_config_view(*tree), ascpp::build_config_view(data));
+}
+
+TEST(TestConfigTree, PatchSharesUnchangedSubtrees) {
+  auto tree = ascpp::config_node::make(sample_config());
+  auto patched = ascpp::config_node::patch(tree, nlohmann::json::parse(R"([
+    {"op": "replace", "path": "/server/port", "value": 443},
+    {"op": "copy", "from": "/limits", "path": "/defaults"}
+  ])")).value();
+
+  EXPECT_EQ((*tree)["server"]["port"].get<int>(), 8080);
+  EXPECT_EQ((*patched)["server"]["port"].get<int>(), 443);
+  // only the root and /server are copied, the copied value is shared as well
+  EXPECT_NE(&(*patched)["server"], &(*tree)["server"]);
+  EXPECT_EQ(&(*patched)["server"]["hosts"], &(*tree)["server"]["hosts"]);
+  EXPECT_EQ(&(*patched)["limits"], &(*tree)["limits"]);
+  EXPECT_EQ(&(*patched)["defaults"], &(*tree)["limits"]);
+  EXPECT_EQ(&(*patched)["empty"], &(*tree)["empty"]);
+
+  auto merged = ascpp::config_node::merge_patch(patched, {{"limits", {{"min", 0}}}});
+  EXPECT_EQ((*merged)["limits"]["min"].get<int>(), 0);
+  EXPECT_EQ(&(*merged)["limits"]["max"], &(*tree)["limits"]["max"]);
+  EXPECT_EQ(&(*merged)["server"], &(*patched)["server"]);
+}
+
+TEST(TestConfigTree, SameAsDom) {
+  auto patches = std::vector<std::string>({
+      R"([{"op": "add", "path": "/server/hosts/1", "value": "x"}])",
+      R"([{"op": "add", "path": "/server/hosts/-", "value": {"y": [1]}}])",
+      R"([{"op": "add", "path": "/server/port", "value": 1}])",
+      R"([{"op": "add", "path": "", "value": [1, 2]}])",
+      R"([{"op": "remove", "path": "/server/hosts/0"}])",
+      R"([{"op": "remove", "path": "/a~1b~0c"}])",
+      R"([{"op": "replace", "path": "", "value": 3}])",
+      R"([{"op": "move", "from": "/server/hosts", "path": "/hosts"}])",
+      R"([{"op": "move", "from": "/server/hosts/0", "path": "/server/hosts/-"}])",
+      R"([{"op": "copy", "from": "/server", "path": "/server/copy"}])",
+      R"([{"op": "test", "path": "/limits", "value": {"ratio": 0.5, "min": -5,
+                                                     "max": 18446744073709551615}}])",
+  });
+  for (const auto& text : patches) {
+    auto ops = nlohmann::json::parse(text);
+    auto tree = ascpp::config_node::patch(ascpp::config_node::make(sample_config()), ops);
+    ASSERT_TRUE(tree) << text;
+    EXPECT_EQ((*tree)->to_json(), sample_config().patch(ops)) << text;
+  }
+
+  auto merges = std::vector<std::string>({
+      R"({"server": {"port": null, "tls": {"on": true}}, "none": 1})",
+      R"({"empty": {"a": {"b": null}}, "x": null})",
+      R"({"server": [1]})",
+      R"([1])",
+  });
+  for (const auto& text : merges) {
+    auto patch = nlohmann::json::parse(text);
+    auto tree = ascpp::config_node::merge_patch(ascpp::config_node::make(sample_config()), patch);
+    auto dom = sample_config();
+    dom.merge_patch(patch);
+    EXPECT_EQ(tree->to_json(), dom) << text;
+  }
+}
+
+TEST(TestConfigTree, PatchFailed) {
+  auto failures = std::vector<std::string>({
+      R"({"op": "add", "path": "/server/hosts/4", "value": 1})",
+      R"({"op": "add", "path": "/missing/key", "value": 1})",
+      R"({"op": "add", "path": "/server/port/key", "value": 1})",
+      R"({"op": "add", "path": "/server/hosts/01", "value": 1})",
+      R"({"op": "add", "path": "/server"})",
+      R"({"op": "remove", "path": "/server/missing"})",
+      R"({"op": "remove", "path": ""})",
+      R"({"op": "replace", "path": "/server/hosts/3", "value": 1})",
+      R"({"op": "move", "from": "/server", "path": "/server/moved"})",
+      R"({"op": "copy", "from": "/missing", "path": "/copy"})",
+      R"({"op": "test", "path": "/server/port", "value": "8080"})",
+      R"({"op": "test", "path": "/missing", "value": null})",
+      R"({"op": "unknown", "path": "/server"})",
+      R"({"op": "remove", "path": "server"})",
+      R"({"op": "remove", "path": "/~2"})",
+      R"({"path": "/server"})",
+  });
+  auto tree = ascpp::config_node::make(sample_config());
+  for (const auto& text : failures) {
+    auto ops = nlohmann::json::array({nlohmann::json::parse(text)});
+    EXPECT_EQ(ascpp::config_node::patch(tree, ops).error(), ascpp::error::config_patch_failed)
+        << text;
+  }
+  EXPECT_EQ(ascpp::config_node::patch(tree, nlohmann::json::object()).error(),
+            ascpp::error::config_patch_failed);
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,84 @@
+#include "storage/config_view.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+
+#include "storage/config_file.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+auto sample_config() -> nlohmann::json {
+  return nlohmann::json::parse(R"({
+    "server": {"port": 8080, "host": "localhost", "tls": false, "ratio": 0.75},
+    "hosts": ["a", "b", "c"],
+    "limits": {"max": 18446744073709551615, "min": -5},
+    "empty": {},
+    "none": null,
+    "a/b~c": 1,
+    "zeta": [[1, 2], {"x": "y"}]
+  })");
+}
+
+}  // namespace
+
+TEST(TestConfigView, Lookup) {
+  auto dir = std::filesystem::temp_directory_path() / "ascpp_config_view_test";
+  std::filesystem::remove_all(dir);
+  auto path = dir / "ascpp_user.view";
+  ascpp::write_config_view(path, sample_config()).value();
+
+  auto view = ascpp::open_config_view(path).value();
+  EXPECT_EQ(view.find("/server/port").value().get<int>().value(), 8080);
+  EXPECT_EQ(view.find("/server/host").value().get<std::string_view>().value(), "localhost");
+  EXPECT_FALSE(view.find("/server/tls").value().get<bool>().value());
+  EXPECT_DOUBLE_EQ(view.find("/server/ratio").value().get<double>().value(), 0.75);
+  EXPECT_EQ(view.find("/hosts/2").value().get<std::string_view>().value(), "c");
+  EXPECT_EQ(view.find("/limits/max").value().get<std::uint64_t>().value(), UINT64_MAX);
+  EXPECT_EQ(view.find("/limits/min").value().get<int>().value(), -5);
+  EXPECT_EQ(view.find("/zeta/1/x").value().get<std::string_view>().value(), "y");
+  EXPECT_TRUE(view.find("/none").value().is_null());
+  EXPECT_EQ(view.find("/empty").value().size(), 0);
+  EXPECT_EQ(view.find("/a~1b~0c").value().get<int>().value(), 1);
+  EXPECT_EQ(view.root().size(), 7);
+
+  EXPECT_EQ(view.find("/server/missing").error(), ascpp::error::config_not_found);
+  EXPECT_EQ(view.find("/hosts/3").error(), ascpp::error::config_not_found);
+  EXPECT_EQ(view.find("/hosts/x").error(), ascpp::error::config_not_found);
+  EXPECT_EQ(view.find("/server/port/x").error(), ascpp::error::config_type_mismatch);
+  EXPECT_EQ(view.find("server").error(), ascpp::error::INVALID_ARGUMENT);
+  EXPECT_EQ(view.find("/a~2b").error(), ascpp::error::INVALID_ARGUMENT);
+  EXPECT_EQ(view.find("/server/host").value().get<int>().error(),
+            ascpp::error::config_type_mismatch);
+
+  EXPECT_EQ(view.root().to_json(), sample_config());
+  std::filesystem::remove_all(dir);
+}
+
+TEST(TestConfigView, InvalidFile) {
+  auto path = std::filesystem::temp_directory_path() / "ascpp_config_view_invalid.view";
+  std::ofstream(path) << "not a view";
+  EXPECT_EQ(ascpp::open_config_view(path).error(), ascpp::error::invalid_config_file);
+
+  // a truncated file is rejected by the size in the header
+  auto data = ascpp::build_config_view(sample_config());
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << data.substr(0, data.size() - 1);
+  EXPECT_EQ(ascpp::open_config_view(path).error(), ascpp::error::invalid_config_file);
+  std::filesystem::remove(path);
+}
+
+TEST(TestConfigView, Empty) {
+  auto view = ascpp::config_view();
+  EXPECT_TRUE(view.root().is_null());
+  EXPECT_EQ(view.root().size(), 0);
+  EXPECT_TRUE(view.find("").value().is_null());
+  EXPECT_EQ(view.find("/server").error(), ascpp::error::config_type_mismatch);
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
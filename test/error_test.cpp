@@ -95,6 +95,15 @@ TEST(TestError, ResultConstructorAndAssignment) {
   r5 = r6;
   EXPECT_EQ(r5.has_value(), false);
   EXPECT_EQ(r5.error(), r6.error());
+
+  // bool is explicitly constructible from std::error_code, but an error code is still an error
+  auto r7 = ascpp::result<bool>(make_error_code(myerror::BAD_ERR));
+  EXPECT_EQ(r7.has_value(), false);
+  r7 = true;
+  r7 = make_error_code(myerror::BAD_ERR);
+  EXPECT_EQ(r7.has_value(), false);
+  auto r8 = ascpp::compact_result<bool>(make_error_code(myerror::BAD_ERR));
+  EXPECT_EQ(r8.has_value(), false);
 }
 
 TEST(TestError, ResultComparsion) {
@@ -127,6 +136,163 @@ TEST(TestError, ResultComparsion) {
             ascpp::result<void>(make_error_code(myerror::BAD_ERR)));
 }
 
+TEST(TestError, ErrorId) {
+  auto id = ascpp::error_id(make_error_code(myerror::BAD_ERR));
+  EXPECT_EQ(id.value(), myerror::BAD_ERR);
+  EXPECT_STREQ(id.category().name(), "myerror");
+  EXPECT_EQ(id.code(), make_error_code(myerror::BAD_ERR));
+  EXPECT_EQ(id, myerror::BAD_ERR);
+  EXPECT_EQ(id, ascpp::error_id(myerror::BAD_ERR));
+  EXPECT_NE(id, ascpp::error_id(myerror::NO_ERR));
+  EXPECT_EQ(id.message(), "bad error");
+
+  auto sys = ascpp::error_id(std::make_error_code(std::errc::invalid_argument));
+  EXPECT_EQ(sys.code(), std::make_error_code(std::errc::invalid_argument));
+  auto neg = ascpp::error_id(-1, std::system_category());
+  EXPECT_EQ(neg.value(), -1);
+  EXPECT_FALSE(ascpp::error_id());
+  EXPECT_ANY_THROW(ascpp::error_id(1 << 24, std::system_category()));
+}
+
+TEST(TestError, CompactResult) {
+  static_assert(sizeof(ascpp::compact_result<int>) <= 2 * sizeof(int));
+  static_assert(sizeof(ascpp::compact_result<int>) < sizeof(ascpp::result<int>));
+
+  auto res = ascpp::compact_result<debug>(1);
+  EXPECT_TRUE(res);
+  EXPECT_EQ(res.value().val, 1);
+
+  res = make_error_code(myerror::BAD_ERR);
+  EXPECT_FALSE(res);
+  EXPECT_EQ(res.error(), myerror::BAD_ERR);
+  EXPECT_EQ(res, make_error_code(myerror::BAD_ERR));
+  try {
+    (void)res.value();
+    ADD_FAILURE();
+  } catch (const ascpp::result_error& ex) {
+    EXPECT_EQ(ex.code(), make_error_code(myerror::BAD_ERR));
+    EXPECT_STREQ(ex.what(), "bad error");
+  }
+
+  auto wide = ascpp::result<debug>(res);
+  EXPECT_EQ(wide.error(), make_error_code(myerror::BAD_ERR));
+  auto narrow = ascpp::compact_result<void>(ascpp::error_id(myerror::NO_ERR));
+  EXPECT_EQ(narrow, make_error_code(myerror::NO_ERR));
+}
+
+TEST(TestError, ResultMonadic) {
+  EXPECT_EQ(get_value_result().map([](const debug& d) { return d.val + 1; }), 2);
+  EXPECT_EQ(get_error_result().map([](const debug& d) { return d.val + 1; }),
+            make_error_code(myerror::BAD_ERR));
+  EXPECT_TRUE(get_value_result().map([](debug) {}).has_value());
+  EXPECT_EQ(get_void_result().map([] { return 1; }), 1);
+
+  auto to_void = [](const debug&) { return get_void_result(); };
+  EXPECT_TRUE(get_value_result().and_then(to_void).has_value());
+  EXPECT_EQ(get_error_result().and_then(to_void), make_error_code(myerror::BAD_ERR));
+  EXPECT_EQ(get_void_result().and_then(get_value_result), debug{1});
+
+  auto compact = ascpp::compact_result<int>(1).map([](int i) { return i * 2; });
+  static_assert(std::is_same_v<decltype(compact), ascpp::compact_result<int>>);
+  EXPECT_EQ(compact, 2);
+}
+
+TEST(TestError, TryInvoke) {
+  auto add = [](const debug& lhs, const debug& rhs) { return lhs.val + rhs.val; };
+  EXPECT_EQ(ascpp::try_invoke(add, get_value_result(), get_value_result()), 2);
+  EXPECT_EQ(ascpp::try_invoke(add, get_value_result(), get_error_result()),
+            make_error_code(myerror::BAD_ERR));
+  EXPECT_EQ(ascpp::try_invoke(add, ascpp::result<debug>(make_error_code(myerror::NO_ERR)),
+                              get_error_result()),
+            make_error_code(myerror::NO_ERR));
+  EXPECT_EQ(ascpp::try_invoke([](const debug&) { return get_error_result(); }, get_value_result()),
+            make_error_code(myerror::BAD_ERR));
+}
+
+auto try_assign() -> ascpp::result<debug> {
+  TRY_CHECK(get_void_result());
+  TRY_ASSIGN(auto val, get_value_result());
+  EXPECT_EQ(val.val, 1);
+  TRY_ASSIGN(val.val2, get_value_result().map([](const debug& d) { return d.val; }));
+  EXPECT_EQ(val.val2, 1);
+  TRY_ASSIGN(auto err, get_error_result());  // return
+  val.val2 = err.val2;
+  return val;
+}
+
+TEST(TestError, TryAssign) {
+  auto err = try_assign();
+  EXPECT_EQ(err, get_error_result());
+}
+
+auto load_with_context(const std::string& path) -> ascpp::result<debug> {
+  return get_error_result().context("loading {}", path);
+}
+
+TEST(TestError, ErrorContext) {
+  ascpp::clear_error_context();
+  auto ok = get_value_result().context("never recorded {}", 1);
+  EXPECT_TRUE(ok);
+  EXPECT_TRUE(ascpp::error_context(make_error_code(myerror::BAD_ERR)).empty());
+
+  auto res = load_with_context("app.json");
+  res.context("starting {}", "app");
+  auto frames = ascpp::error_context(res.error());
+  ASSERT_EQ(frames.size(), 2);
+  EXPECT_EQ(frames[0].message, "loading app.json");
+  EXPECT_EQ(frames[1].message, "starting app");
+  EXPECT_NE(std::string_view(frames[0].location.function_name()).find("load_with_context"),
+            std::string_view::npos);
+  EXPECT_NE(ascpp::format_error_context(res.error()).find("error_test.cpp"), std::string::npos);
+
+  // context of another error starts a new trace
+  auto other = ascpp::result<void>(make_error_code(myerror::NO_ERR)).context("other");
+  EXPECT_TRUE(ascpp::error_context(res.error()).empty());
+  EXPECT_EQ(ascpp::error_context(other.error()).size(), 1);
+
+  ascpp::clear_error_context();
+  EXPECT_TRUE(ascpp::error_context(other.error()).empty());
+
+  // failures of the same code path with the same code do not pile up in one trace
+  for (auto i = 0; i < 1000; ++i) {
+    (void)load_with_context(std::to_string(i));
+  }
+  frames = ascpp::error_context(res.error());
+  ASSERT_EQ(frames.size(), 1);
+  EXPECT_EQ(frames[0].message, "loading 999");
+}
+
+// A member function returns a result of its own class, which is incomplete at the declaration
+struct node {
+  auto child() const -> ascpp::result<node> {
+    if (depth == 0) {
+      return make_error_code(ascpp::error::OUT_OF_RANGE);
+    }
+    return node{depth - 1};
+  }
+
+  int depth = 0;
+};
+
+TEST(TestError, IncompleteValueType) {
+  EXPECT_EQ(node{1}.child().value().depth, 0);
+  EXPECT_EQ(node{0}.child().error(), ascpp::error::OUT_OF_RANGE);
+}
+
+TEST(TestError, StaticErrorCategory) {
+  auto ec = make_error_code(ascpp::error::OUT_OF_RANGE);
+  EXPECT_EQ(&ec.category(), &ascpp::error_category_instance<ascpp::error>);
+  EXPECT_EQ(ascpp::message_view(ec), "out of range");
+  EXPECT_EQ(ec.message(), "out of range");
+  EXPECT_EQ(ascpp::message_view(make_error_code(static_cast<ascpp::error::errc>(-1))),
+            "unkown error");
+  EXPECT_EQ(ascpp::result_error(ec).what(), ascpp::message_view(ec).data());
+
+  // fall back to error_category::message() for the other categories
+  EXPECT_TRUE(ascpp::message_view(make_error_code(myerror::BAD_ERR)).empty());
+  EXPECT_STREQ(ascpp::result_error(make_error_code(myerror::BAD_ERR)).what(), "bad error");
+}
+
 #include <type_traits>
 #if defined(__GNUC__) || defined(__clang__)
 auto try_unwrap() -> ascpp::result<debug> {
@@ -0,0 +1,163 @@
+#include "utils/log_binary.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "app_info.hpp"
+#include "utils/log_file.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+struct point {
+  int x;
+  int y;
+};
+
+class binary_sink : public ascpp::log_sink {
+ public:
+  auto write(std::span<const ascpp::log_entry> entries) -> void override {
+    auto lock = std::lock_guard(mutex);
+    for (const auto& entry : entries) {
+      if (!encoder.started()) {
+        encoder.start(data, entry.record->timestamp);
+      }
+      encoder.encode(data, entry);
+    }
+  }
+
+  auto needs_text() const -> bool override { return false; }
+
+  std::mutex mutex;
+  std::string data;
+  ascpp::detail::log_encoder encoder;
+};
+
+class text_sink : public ascpp::log_sink {
+ public:
+  auto write(std::span<const ascpp::log_entry> entries) -> void override {
+    auto lock = std::lock_guard(mutex);
+    for (const auto& entry : entries) {
+      data += entry.line;
+    }
+  }
+
+  std::mutex mutex;
+  std::string data;
+};
+
+auto decode_messages(std::string_view data) -> std::vector<std::string> {
+  auto decoder = ascpp::log_decoder(data);
+  auto event = ascpp::log_event();
+  auto messages = std::vector<std::string>();
+  while (decoder.next(event).value()) {
+    ascpp::format_log_event(messages.emplace_back(), event);
+  }
+  return messages;
+}
+
+}  // namespace
+
+template <>
+struct std::formatter<point> : std::formatter<std::string> {
+  auto format(const point& p, std::format_context& ctx) const {
+    return std::format_to(ctx.out(), "({}, {})", p.x, p.y);
+  }
+};
+
+TEST(TestLogBinary, RoundTrip) {
+  auto log = ascpp::logger(&info);
+  auto sink = std::make_shared<binary_sink>();
+  log.set_sinks({sink});
+
+  auto str = std::string("string");
+  log.info("int {} {} {} double {:.2f} float {}", -42, std::uint64_t(1) << 40, short(-3), 3.14159,
+           0.5F);
+  log.warn("{} {} {} {} {}", str, std::string_view("view"), "literal", 'c', true);
+  log.error("{1} {0} {{escaped}} {0:>4}|", "a", "b");
+  log.debug("other type {}", point{1, 2});
+  log.flush();
+
+  auto decoder = ascpp::log_decoder(sink->data);
+  auto event = ascpp::log_event();
+  ASSERT_TRUE(decoder.next(event).value());
+  EXPECT_EQ(event.lvl, ascpp::logger::INFO);
+  EXPECT_EQ(event.thread_index, 1);
+  EXPECT_EQ(event.format, "int {} {} {} double {:.2f} float {}");
+  ASSERT_EQ(event.args.size(), 5);
+  EXPECT_EQ(std::get<std::int64_t>(event.args[0]), -42);
+
+  auto messages = decode_messages(sink->data);
+  ASSERT_EQ(messages.size(), 4);
+  EXPECT_EQ(messages[0], "int -42 1099511627776 -3 double 3.14 float 0.5");
+  EXPECT_EQ(messages[1], "string view literal c true");
+  EXPECT_EQ(messages[2], "b a {escaped}    a|");
+  EXPECT_EQ(messages[3], "other type (1, 2)");
+}
+
+TEST(TestLogBinary, SmallerThanText) {
+  auto log = ascpp::logger(&info, {.ring_capacity = 4096});
+  auto binary = std::make_shared<binary_sink>();
+  auto text = std::make_shared<text_sink>();
+  log.set_sinks({binary, text});
+
+  for (auto i = 0; i < 1000; ++i) {
+    log.info("GET /api/v1/users/{}/profile -> {} ({} us)", i, 200, i * 3);
+  }
+  log.flush();
+
+  EXPECT_EQ(decode_messages(binary->data).size(), 1000 - log.dropped());
+  EXPECT_LT(binary->data.size() * 4, text->data.size());
+}
+
+TEST(TestLogBinary, CorruptedData) {
+  auto event = ascpp::log_event();
+  EXPECT_EQ(ascpp::log_decoder("not a log").next(event).error(), ascpp::error::corrupted_log);
+  auto truncated = std::string("\xA5LOG\x01\x00\x02\x05", 8);
+  EXPECT_EQ(ascpp::log_decoder(truncated).next(event).error(), ascpp::error::corrupted_log);
+  EXPECT_FALSE(ascpp::log_decoder("").next(event).value());
+}
+
+TEST(TestLogBinary, RotatingFileSink) {
+  auto dir = std::filesystem::temp_directory_path() / "ascpp_log_binary_test";
+  std::filesystem::remove_all(dir);
+  {
+    auto sink = ascpp::rotating_file_sink::create(
+                    info, {.dir = dir, .format = ascpp::rotating_file_sink::binary})
+                    .value();
+    auto log = ascpp::logger(&info);
+    log.set_sinks({sink});
+    log.info("first run {}", 1);
+  }
+  {
+    // a second run appends a new stream to the same file
+    auto sink = ascpp::rotating_file_sink::create(
+                    info, {.dir = dir, .format = ascpp::rotating_file_sink::binary})
+                    .value();
+    EXPECT_EQ(sink->path(), dir / "ascpp.alog");
+    auto log = ascpp::logger(&info);
+    log.set_sinks({sink});
+    log.info("second run {}", 2);
+  }
+
+  auto in = std::ifstream(dir / "ascpp.alog", std::ios::binary);
+  auto data = std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  auto messages = decode_messages(data);
+  ASSERT_EQ(messages.size(), 2);
+  EXPECT_EQ(messages[0], "first run 1");
+  EXPECT_EQ(messages[1], "second run 2");
+  std::filesystem::remove_all(dir);
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,135 @@
+#include "utils/log_file.hpp"
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "app_info.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+auto read_file(const std::filesystem::path& path) -> std::string {
+  auto in = std::ifstream(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+}  // namespace
+
+TEST(TestLogFile, DefaultDir) {
+  auto dir = ascpp::rotating_file_sink::get_log_dir(info).value();
+  EXPECT_EQ(dir, ascpp::get_cache_dir().value() / "mrbeardad" / "ascpp" / "log");
+}
+
+TEST(TestLogFile, WriteChunks) {
+  auto path = std::filesystem::temp_directory_path() / "ascpp_log_file_test.log";
+  std::filesystem::remove(path);
+  {
+    auto file = ascpp::detail::open_log_file(path).value();
+    auto chunks = std::array<std::string_view, 3>{"hello", "", " world\n"};
+    file.write(chunks).value();
+    file.sync().value();
+    EXPECT_EQ(file.size().value(), 12U);
+  }
+  EXPECT_EQ(read_file(path), "hello world\n");
+  std::filesystem::remove(path);
+}
+
+TEST(TestLogFile, RotateBySize) {
+  auto dir = std::filesystem::temp_directory_path() / "ascpp_log_rotate_test";
+  std::filesystem::remove_all(dir);
+
+  auto sink = ascpp::rotating_file_sink::create(
+                  info, {.dir = dir, .max_file_size = 64, .max_files = 2})
+                  .value();
+  EXPECT_EQ(sink->path(), dir / "ascpp.log");
+  {
+    auto log = ascpp::logger(&info);
+    log.set_sinks({sink});
+    for (auto i = 0; i < 20; ++i) {
+      log.info("record {:02}", i);
+      log.flush();
+    }
+  }
+  EXPECT_FALSE(sink->last_error());
+
+  // each line is longer than half of max_file_size, so every file holds a single line
+  EXPECT_TRUE(read_file(dir / "ascpp.log").ends_with(" [1] record 19\n"));
+  EXPECT_TRUE(read_file(dir / "ascpp.1.log").ends_with(" [1] record 18\n"));
+  EXPECT_TRUE(read_file(dir / "ascpp.2.log").ends_with(" [1] record 17\n"));
+  EXPECT_FALSE(std::filesystem::exists(dir / "ascpp.3.log"));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(TestLogFile, RotateBinaryBySize) {
+  auto dir = std::filesystem::temp_directory_path() / "ascpp_log_rotate_binary_test";
+  std::filesystem::remove_all(dir);
+
+  auto sink = ascpp::rotating_file_sink::create(
+                  info, {.dir = dir,
+                         .format = ascpp::rotating_file_sink::binary,
+                         .max_file_size = 64,
+                         .max_files = 4})
+                  .value();
+  EXPECT_EQ(sink->path(), dir / "ascpp.alog");
+  {
+    auto log = ascpp::logger(&info);
+    log.set_sinks({sink});
+    for (auto i = 0; i < 40; ++i) {
+      log.info("record {}", i);
+      log.flush();
+    }
+  }
+  EXPECT_FALSE(sink->last_error());
+
+  // the encoded records count, not the formatted lines left empty in binary format
+  auto paths = std::array{dir / "ascpp.alog", dir / "ascpp.1.alog", dir / "ascpp.2.alog"};
+  for (const auto& path : paths) {
+    auto data = read_file(path);
+    EXPECT_LE(data.size(), 64U) << path;
+    auto decoder = ascpp::log_decoder(data);
+    auto event = ascpp::log_event();
+    auto count = 0;
+    while (decoder.next(event).value()) {
+      ++count;
+    }
+    EXPECT_GT(count, 0) << path;
+  }
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(TestLogFile, RotateByAgeAfterReopen) {
+  auto dir = std::filesystem::temp_directory_path() / "ascpp_log_rotate_age_test";
+  std::filesystem::remove_all(dir);
+  auto opts =
+      ascpp::rotating_file_sink::options{.dir = dir, .max_file_age = std::chrono::seconds(1)};
+
+  auto write = [&](std::string_view text) {
+    auto sink = ascpp::rotating_file_sink::create(info, opts).value();
+    auto log = ascpp::logger(&info);
+    log.set_sinks({sink});
+    log.info("{}", text);
+    log.flush();
+  };
+  write("first");
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  // the file left by the first sink is older than max_file_age, though just reopened
+  write("second");
+  EXPECT_TRUE(read_file(dir / "ascpp.1.log").ends_with(" [1] first\n"));
+  EXPECT_TRUE(read_file(dir / "ascpp.log").ends_with(" [1] second\n"));
+
+  std::filesystem::remove_all(dir);
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,291 @@
+#include "utils/log.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "app_info.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+class memory_sink : public ascpp::log_sink {
+ public:
+  auto write(std::span<const ascpp::log_entry> entries) -> void override {
+    auto lock = std::lock_guard(mutex);
+    for (const auto& entry : entries) {
+      messages.emplace_back(entry.message);
+      lines.emplace_back(entry.line);
+      levels.emplace_back(entry.lvl);
+    }
+  }
+
+  std::mutex mutex;
+  std::vector<std::string> messages;
+  std::vector<std::string> lines;
+  std::vector<ascpp::logger::level> levels;
+};
+
+// Block the background thread in write() until opened, to fill the rings deterministically
+class gate_sink : public memory_sink {
+ public:
+  auto write(std::span<const ascpp::log_entry> entries) -> void override {
+    entered.store(true);
+    entered.notify_all();
+    opened.wait(false);
+    memory_sink::write(entries);
+  }
+
+  auto open() -> void {
+    opened.store(true);
+    opened.notify_all();
+  }
+
+  std::atomic<bool> entered = false;
+  std::atomic<bool> opened = false;
+};
+
+// Log the first record to block the background thread, then a burst of records into the ring
+auto log_burst(ascpp::log_overflow_policy policy, int burst)
+    -> std::pair<std::shared_ptr<gate_sink>, ascpp::logger::stats> {
+  auto log = ascpp::logger(&info, {.ring_capacity = 64, .overflow = policy, .sample_rate = 4});
+  auto sink = std::make_shared<gate_sink>();
+  log.set_sinks({sink});
+  log.info("first");
+  sink->entered.wait(false);
+  for (auto i = 0; i < burst; ++i) {
+    log.info("{}", i);
+  }
+  sink->open();
+  log.flush();
+  return {sink, log.get_stats()};
+}
+
+}  // namespace
+
+TEST(TestLog, FormatOnBackgroundThread) {
+  auto log = ascpp::logger(&info);
+  auto sink = std::make_shared<memory_sink>();
+  log.set_sinks({sink});
+
+  auto str = std::string("string");
+  log.info("int {} double {:.2f} char {} bool {}", 42, 3.14159, 'c', true);
+  log.warn("{} {} {}", str, std::string_view("view"), "literal");
+  str = "modified";  // arguments are captured by value
+  log.error("no argument");
+  log.flush();
+
+  ASSERT_EQ(sink->messages.size(), 3);
+  EXPECT_EQ(sink->messages[0], "int 42 double 3.14 char c bool true");
+  EXPECT_EQ(sink->messages[1], "string view literal");
+  EXPECT_EQ(sink->messages[2], "no argument");
+  EXPECT_EQ(sink->levels[1], ascpp::logger::WARN);
+  EXPECT_TRUE(sink->lines[2].ends_with(" ERROR [1] no argument\n"));
+}
+
+TEST(TestLog, TruncateLongString) {
+  auto log = ascpp::logger(&info);
+  auto sink = std::make_shared<memory_sink>();
+  log.set_sinks({sink});
+
+  auto long_str = std::string(1024, 'x');
+  log.info("{} {}", long_str, 7);
+  log.flush();
+
+  ASSERT_EQ(sink->messages.size(), 1);
+  EXPECT_LT(sink->messages[0].size(), ascpp::detail::log_record::size);
+  EXPECT_TRUE(sink->messages[0].ends_with("x\u2026 7"));
+}
+
+TEST(TestLog, TruncateMultibyteString) {
+  auto log = ascpp::logger(&info);
+  auto sink = std::make_shared<memory_sink>();
+  log.set_sinks({sink});
+
+  auto long_str = std::string();
+  for (auto i = 0; i < 200; ++i) {
+    long_str += "\u4E2D";
+  }
+  // shift the cut by one byte each time so that it falls at every offset of a code point
+  log.info("{}", long_str);
+  log.info("{}{}", 'a', long_str);
+  log.info("{}{}{}", 'a', 'b', long_str);
+  log.flush();
+
+  ASSERT_EQ(sink->messages.size(), 3);
+  for (const auto& message : sink->messages) {
+    ASSERT_TRUE(message.ends_with("\u4E2D\u2026"));
+    auto chars = std::string_view(message).substr(0, message.size() - 3);
+    chars.remove_prefix(chars.find('\xE4'));
+    EXPECT_EQ(chars.size() % 3, 0);
+  }
+}
+
+TEST(TestLog, MultiThread) {
+  constexpr auto threads = 4;
+  constexpr auto records = 1000;
+
+  for (auto policy :
+       {ascpp::log_overflow_policy::drop_newest, ascpp::log_overflow_policy::drop_oldest}) {
+    auto log = ascpp::logger(&info, {.ring_capacity = 64, .overflow = policy});
+    auto sink = std::make_shared<memory_sink>();
+    log.set_sinks({sink});
+
+    auto workers = std::vector<std::thread>();
+    for (auto t = 0; t < threads; ++t) {
+      workers.emplace_back([log, t]() mutable {
+        for (auto i = 0; i < records; ++i) {
+          log.debug("thread {} record {}", t, i);
+        }
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    log.flush();
+
+    auto stats = log.get_stats();
+    EXPECT_EQ(sink->messages.size(), stats.written);
+    EXPECT_EQ(stats.written + stats.dropped, threads * records);
+  }
+}
+
+TEST(TestLog, RuntimeLevel) {
+  auto log = ascpp::logger(&info);
+  auto sink = std::make_shared<memory_sink>();
+  log.set_sinks({sink});
+
+  auto evaluated = 0;
+  auto count = [&] { return ++evaluated; };
+  log.set_level(ascpp::logger::WARN);
+  EXPECT_EQ(log.get_level(), ascpp::logger::WARN);
+  EXPECT_FALSE(log.enabled(ascpp::logger::INFO));
+  EXPECT_TRUE(log.enabled(ascpp::logger::ERROR));
+
+  log.info("dropped by log()");
+  ASCPP_LOG_INFO(log, "dropped by the macro {}", count());
+  ASCPP_LOG_WARN(log, "logged {}", count());
+  log.flush();
+
+  EXPECT_EQ(evaluated, 1);  // the arguments of filtered statements are not evaluated
+  ASSERT_EQ(sink->messages.size(), 1);
+  EXPECT_EQ(sink->messages[0], "logged 1");
+}
+
+TEST(TestLog, RateLimit) {
+  auto log = ascpp::logger(&info);
+  auto sink = std::make_shared<memory_sink>();
+  log.set_sinks({sink});
+
+  // a single call site, its limit is shared by the calls of the lambda
+  auto fail = [&](int i) {
+    ASCPP_LOG_EVERY(log, WARN, std::chrono::milliseconds(50), "failure {}", i);
+  };
+  for (auto i = 0; i < 100; ++i) {
+    fail(i);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  fail(100);
+
+  for (auto i = 0; i < 100; ++i) {
+    ASCPP_LOG_LIMIT(log, INFO, 3, std::chrono::hours(1), "burst {}", i);
+  }
+  log.flush();
+
+  ASSERT_EQ(sink->messages.size(), 6);
+  EXPECT_EQ(sink->messages[0], "failure 0");
+  EXPECT_EQ(sink->messages[1], "last message repeated 99 times");
+  EXPECT_EQ(sink->levels[1], ascpp::logger::WARN);
+  EXPECT_EQ(sink->messages[2], "failure 100");
+  EXPECT_EQ(sink->messages[3], "burst 0");
+  EXPECT_EQ(sink->messages[5], "burst 2");
+}
+
+// Only the ASCPP_LOG macros expanded after this point see the new minimum level
+#undef ASCPP_LOG_MIN_LEVEL
+#define ASCPP_LOG_MIN_LEVEL 1
+
+TEST(TestLog, CompileTimeLevel) {
+  auto log = ascpp::logger(&info);
+  auto sink = std::make_shared<memory_sink>();
+  log.set_sinks({sink});
+
+  auto evaluated = 0;
+  auto count = [&] { return ++evaluated; };
+  ASSERT_TRUE(log.enabled(ascpp::logger::TRACE));
+  ASCPP_LOG_TRACE(log, "compiled out {}", count());
+  ASCPP_LOG_DEBUG(log, "logged {}", count());
+  log.flush();
+
+  EXPECT_EQ(evaluated, 1);
+  ASSERT_EQ(sink->messages.size(), 1);
+  EXPECT_EQ(sink->messages[0], "logged 1");
+}
+
+TEST(TestLog, DropNewest) {
+  auto [sink, stats] = log_burst(ascpp::log_overflow_policy::drop_newest, 200);
+  ASSERT_EQ(sink->messages.size(), 65);
+  EXPECT_EQ(sink->messages[1], "0");
+  EXPECT_EQ(sink->messages[64], "63");
+  EXPECT_EQ(stats.enqueued, 65);
+  EXPECT_EQ(stats.dropped, 136);
+  EXPECT_EQ(stats.written, 65);
+  EXPECT_EQ(stats.high_water, 64);
+}
+
+TEST(TestLog, DropOldest) {
+  auto [sink, stats] = log_burst(ascpp::log_overflow_policy::drop_oldest, 200);
+  ASSERT_EQ(sink->messages.size(), 65);
+  EXPECT_EQ(sink->messages[1], "136");
+  EXPECT_EQ(sink->messages[64], "199");
+  EXPECT_EQ(stats.enqueued, 201);
+  EXPECT_EQ(stats.dropped, 136);
+  EXPECT_EQ(stats.written, 65);
+}
+
+TEST(TestLog, Sample) {
+  auto [sink, stats] = log_burst(ascpp::log_overflow_policy::sample, 200);
+  // the first half of the ring is filled, then one record out of 4 until the ring is full
+  ASSERT_EQ(sink->messages.size(), 65);
+  EXPECT_EQ(sink->messages[32], "31");
+  EXPECT_EQ(sink->messages[33], "35");
+  EXPECT_EQ(sink->messages[34], "39");
+  EXPECT_EQ(stats.enqueued + stats.dropped, 201);
+}
+
+TEST(TestLog, Block) {
+  auto log =
+      ascpp::logger(&info, {.ring_capacity = 64, .overflow = ascpp::log_overflow_policy::block});
+  auto sink = std::make_shared<gate_sink>();
+  log.set_sinks({sink});
+  log.info("first");
+  sink->entered.wait(false);
+
+  auto done = std::atomic<bool>(false);
+  auto producer = std::thread([&] {
+    for (auto i = 0; i < 200; ++i) {
+      log.info("{}", i);
+    }
+    done.store(true);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(done.load());
+  sink->open();
+  producer.join();
+  log.flush();
+
+  EXPECT_EQ(sink->messages.size(), 201);
+  EXPECT_EQ(log.get_stats().dropped, 0);
+  EXPECT_EQ(log.get_stats().written, 201);
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
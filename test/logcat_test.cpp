@@ -0,0 +1,37 @@
+#include "logcat.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+
+#include "utils/log.hpp"
+#include "utils/log_binary.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+TEST(TestLogcat, Json) {
+  auto event = ascpp::log_event{ascpp::logger::level::INFO, {}, 3, "{} = {}", {std::string_view("port"), std::int64_t(8080)}};
+  auto line = std::string();
+  ascpp::logcat::format_record(line, event, true);
+  ASSERT_TRUE(line.ends_with('\n'));
+  auto json = nlohmann::json::parse(line);
+  EXPECT_EQ(json["message"], "port = 8080");
+  EXPECT_EQ(json["thread"], 3);
+  EXPECT_EQ(json["args"], nlohmann::json({"port", 8080}));
+}
+
+TEST(TestLogcat, TruncatedMultibyteString) {
+  // "中中" cut in the middle of the second character, as written by an older logger
+  auto arg = std::string_view("\xE4\xB8\xAD\xE4\xB8");
+  auto event = ascpp::log_event{ascpp::logger::level::INFO, {}, 0, "{}", {arg}};
+  auto line = std::string();
+  ASSERT_NO_THROW(ascpp::logcat::format_record(line, event, true));
+  auto json = nlohmann::json::parse(line);
+  EXPECT_EQ(json["message"], "中�");
+  EXPECT_EQ(json["args"][0], "中�");
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
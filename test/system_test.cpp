@@ -9,7 +9,7 @@
 // NOLINTBEGIN(modernize-use-trailing-return-type)
 
 TEST(TestMisc, GetAndSetEnv) {
-  EXPECT_EQ(ascpp::get_env("null").error(), ascpp::error::get_empty_env);
+  EXPECT_EQ(ascpp::get_env("null").error(), ascpp::error::get_env_failed);
 
   ascpp::set_env("empty", "").value();
   EXPECT_EQ(ascpp::get_env("empty").error(), ascpp::error::get_empty_env);
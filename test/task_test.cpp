@@ -0,0 +1,199 @@
+#include "async/task.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "asio/buffer.hpp"
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/random_access_file.hpp"
+#include "async/io_executor.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+auto add_one(int n) -> ascpp::task<int> {
+  co_return n + 1;
+}
+
+auto sum_chain(int depth) -> ascpp::task<int> {
+  auto sum = 0;
+  for (auto i = 0; i < depth; ++i) {
+    sum += co_await add_one(0);
+  }
+  co_return sum;
+}
+
+auto parse_port(std::string_view text) -> ascpp::result<int> {
+  if (text.empty()) {
+    return make_error_code(ascpp::error::INVALID_ARGUMENT);
+  }
+  return std::stoi(std::string(text));
+}
+
+auto next_port(std::string_view text, bool* resumed) -> ascpp::task<ascpp::result<int>> {
+  auto port = co_await parse_port(text);
+  *resumed = true;
+  co_return port + 1;
+}
+
+auto throw_later() -> ascpp::task<> {
+  co_await std::suspend_never();
+  throw std::runtime_error("task");
+}
+
+}  // namespace
+
+TEST(TestTask, Chain) {
+  auto ctx = asio::io_context();
+  auto ex = ascpp::io_executor(ctx);
+  EXPECT_EQ(ex.block_on(add_one(1)), 2);
+  // awaiting a task transfers to it and back
+  EXPECT_EQ(ex.block_on(sum_chain(1000)), 1000);
+  EXPECT_THROW(ex.block_on(throw_later()), std::runtime_error);
+}
+
+TEST(TestTask, AwaitResult) {
+  auto ctx = asio::io_context();
+  auto ex = ascpp::io_executor(ctx);
+  auto resumed = false;
+  EXPECT_EQ(ex.block_on(next_port("8080", &resumed)).value(), 8081);
+  EXPECT_TRUE(resumed);
+
+  resumed = false;
+  EXPECT_EQ(ex.block_on(next_port("", &resumed)).error(), ascpp::error::INVALID_ARGUMENT);
+  EXPECT_FALSE(resumed);
+
+  // the error of a child task is returned from the awaiting task
+  auto outer = [&](std::string_view text) -> ascpp::task<ascpp::result<int>> {
+    co_return co_await next_port(text, &resumed) * 10;
+  };
+  EXPECT_EQ(ex.block_on(outer("1")).value(), 20);
+  EXPECT_EQ(ex.block_on(outer("")).error(), ascpp::error::INVALID_ARGUMENT);
+
+  auto inspect = [&](std::string_view text) -> ascpp::task<ascpp::result<bool>> {
+    auto res = co_await ascpp::as_result(next_port(text, &resumed));
+    co_return res.has_value();
+  };
+  EXPECT_FALSE(ex.block_on(inspect("")).value());
+}
+
+TEST(TestTask, Sleep) {
+  auto ctx = asio::io_context();
+  auto ex = ascpp::io_executor(ctx);
+  auto order = std::string();
+  auto sleeper = [&](char name, int ms) -> ascpp::task<> {
+    co_await ex.sleep_for(std::chrono::milliseconds(ms));
+    order.push_back(name);
+  };
+  ex.spawn(sleeper('b', 20));
+  ex.spawn(sleeper('a', 10));
+  auto start = std::chrono::steady_clock::now();
+  ex.block_on(sleeper('c', 30));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(30));
+  EXPECT_EQ(order, "abc");
+
+  auto on_context = [&]() -> ascpp::task<bool> {
+    co_await ex.schedule();
+    co_return true;
+  };
+  EXPECT_TRUE(ex.block_on(on_context()));
+}
+
+TEST(TestTask, Socket) {
+  using asio::ip::tcp;
+  auto ctx = asio::io_context();
+  auto ex = ascpp::io_executor(ctx);
+  auto acceptor = tcp::acceptor(ctx, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+  auto server = [&]() -> ascpp::task<ascpp::result<void>> {
+    auto socket = co_await ascpp::async_accept(acceptor);
+    auto buf = std::array<char, 64>();
+    auto size = co_await ascpp::async_read_some(socket, asio::buffer(buf));
+    co_await ascpp::async_write(socket, asio::buffer(buf.data(), size));
+    co_return ascpp::result<void>();
+  };
+  auto client = [&]() -> ascpp::task<ascpp::result<std::string>> {
+    auto socket = tcp::socket(ctx);
+    co_await ascpp::async_connect(socket, acceptor.local_endpoint());
+    co_await ascpp::async_write(socket, asio::buffer(std::string_view("ping")));
+    auto buf = std::array<char, 4>();
+    co_await ascpp::async_read(socket, asio::buffer(buf));
+    co_return std::string(buf.data(), buf.size());
+  };
+  ex.spawn(server());
+  EXPECT_EQ(ex.block_on(client()).value(), "ping");
+
+  // nobody connects, the error is returned from the task
+  acceptor.close();
+  EXPECT_FALSE(ex.block_on(server()));
+}
+
+#if defined(ASIO_HAS_FILE)
+
+TEST(TestTask, RandomAccessFile) {
+  auto ctx = asio::io_context();
+  auto ex = ascpp::io_executor(ctx);
+  auto path = std::filesystem::temp_directory_path() / "ascpp_task_file_test.bin";
+  std::filesystem::remove(path);
+  auto file = asio::random_access_file(
+      ctx, path.string(), asio::file_base::read_write | asio::file_base::create);
+
+  auto round_trip = [&]() -> ascpp::task<ascpp::result<std::string>> {
+    auto data = std::string_view("hello io_uring");
+    auto written = co_await ascpp::async_write_some_at(file, 4, asio::buffer(data));
+    auto buf = std::array<char, 32>();
+    auto size = co_await ascpp::async_read_some_at(file, 4, asio::buffer(buf.data(), written));
+    co_return std::string(buf.data(), size);
+  };
+  EXPECT_EQ(ex.block_on(round_trip()).value(), "hello io_uring");
+  EXPECT_EQ(std::filesystem::file_size(path), 18U);
+
+  auto read_past_end = [&]() -> ascpp::task<ascpp::result<std::size_t>> {
+    auto buf = std::array<char, 8>();
+    co_return co_await ascpp::async_read_some_at(file, 64, asio::buffer(buf));
+  };
+  EXPECT_EQ(ex.block_on(read_past_end()).error(), asio::error::eof);
+
+  file.close();
+  std::filesystem::remove(path);
+}
+
+#endif
+
+TEST(TestTask, FramePool) {
+  auto ctx = asio::io_context();
+  auto ex = ascpp::io_executor(ctx);
+  auto before = ascpp::frame_pool::stats();
+  EXPECT_EQ(ex.block_on(sum_chain(100)), 100);
+  auto after = ascpp::frame_pool::stats();
+  // the frames of the chain reuse each other's
+  EXPECT_EQ(after.allocated - before.allocated, 101);
+  EXPECT_GE(after.reused - before.reused, 99);
+  EXPECT_GT(after.cached, 0);
+
+  // a frame freed on another thread goes to the pool of that thread
+  auto t = add_one(1);
+  std::thread([&] {
+    EXPECT_EQ(ascpp::frame_pool::stats().cached, 0);
+    t = {};
+    EXPECT_EQ(ascpp::frame_pool::stats().cached, 1);
+  }).join();
+
+  ascpp::frame_pool::set_enabled(false);
+  EXPECT_EQ(ascpp::frame_pool::stats().cached, 0);
+  EXPECT_EQ(ex.block_on(add_one(1)), 2);
+  EXPECT_EQ(ascpp::frame_pool::stats().cached, 0);
+  ascpp::frame_pool::set_enabled(true);
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,154 @@
+#include "async/timer_wheel.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "asio/io_context.hpp"
+#include "async/io_executor.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+using namespace std::chrono_literals;
+
+TEST(TestTimerWheel, Callbacks) {
+  auto ctx = asio::io_context();
+  auto wheel = ascpp::timer_wheel(ctx, 100us);
+  auto rng = std::mt19937(42);
+  // up to 2000 ticks, so that most timers are cascaded from the second level
+  auto delay = std::uniform_int_distribution<int>(0, 200);
+
+  struct entry {
+    explicit entry(ascpp::timer_wheel& wheel) : timer(wheel) {}
+
+    ascpp::wheel_timer timer;
+    ascpp::wheel_timer::clock::time_point deadline;
+    bool fired = false;
+    bool early = false;
+  };
+  auto entries = std::vector<std::unique_ptr<entry>>();
+  for (auto i = 0; i < 10000; ++i) {
+    auto& e = *entries.emplace_back(std::make_unique<entry>(wheel));
+    e.deadline = ascpp::wheel_timer::clock::now() + delay(rng) * 1ms;
+    e.timer.start(e.deadline, [&e] {
+      e.fired = true;
+      e.early = ascpp::wheel_timer::clock::now() < e.deadline;
+    });
+  }
+  EXPECT_EQ(wheel.size(), 10000);
+  for (auto i = 0UZ; i < entries.size(); i += 2) {
+    EXPECT_TRUE(entries[i]->timer.cancel());
+  }
+  EXPECT_FALSE(entries[0]->timer.cancel());
+  EXPECT_EQ(wheel.size(), 5000);
+
+  // the io_context runs out of work once the last timer has fired
+  ctx.run();
+  EXPECT_EQ(wheel.size(), 0);
+  for (auto i = 0UZ; i < entries.size(); ++i) {
+    EXPECT_EQ(entries[i]->fired, i % 2 == 1) << i;
+    EXPECT_FALSE(entries[i]->early) << i;
+  }
+}
+
+TEST(TestTimerWheel, CancelLast) {
+  auto ctx = asio::io_context();
+  // the lowest level wraps around after 2.56 s, the wheel would wake up then if left armed
+  auto wheel = ascpp::timer_wheel(ctx, 10ms);
+  auto timer = ascpp::wheel_timer(wheel);
+  auto fired = false;
+  timer.start(ascpp::wheel_timer::clock::now() + 10s, [&fired] { fired = true; });
+  EXPECT_TRUE(timer.cancel());
+
+  // the steady_timer is disarmed with the last timer, the io_context has no work left
+  auto begin = ascpp::wheel_timer::clock::now();
+  ctx.run();
+  EXPECT_LT(ascpp::wheel_timer::clock::now() - begin, 1s);
+  EXPECT_FALSE(fired);
+
+  // and armed again by the next one
+  ctx.restart();
+  timer.start(ascpp::wheel_timer::clock::now() + 5ms, [&fired] { fired = true; });
+  ctx.run();
+  EXPECT_TRUE(fired);
+}
+
+TEST(TestTimerWheel, Cascade) {
+  auto ctx = asio::io_context();
+  // 1 us ticks, so that 100 ms reach the third level
+  auto wheel = ascpp::timer_wheel(ctx, 1us);
+  auto fired = std::vector<int>();
+  auto timers = std::vector<std::unique_ptr<ascpp::wheel_timer>>();
+  for (auto ms : {100, 1, 70, 30}) {
+    auto deadline = ascpp::wheel_timer::clock::now() + ms * 1ms;
+    timers.push_back(std::make_unique<ascpp::wheel_timer>(wheel));
+    timers.back()->start(deadline, [&fired, ms, deadline] {
+      EXPECT_GE(ascpp::wheel_timer::clock::now(), deadline);
+      fired.push_back(ms);
+    });
+  }
+  ctx.run();
+  EXPECT_EQ(fired, std::vector<int>({1, 30, 70, 100}));
+}
+
+TEST(TestTimerWheel, Sleep) {
+  auto ctx = asio::io_context();
+  auto ex = ascpp::io_executor(ctx);
+  auto wheel = ascpp::timer_wheel(ctx);
+  auto order = std::string();
+  auto sleeper = [&](char name, std::chrono::milliseconds delay) -> ascpp::task<> {
+    auto start = ascpp::timer_wheel::clock::now();
+    co_await wheel.sleep_for(delay);
+    EXPECT_GE(ascpp::timer_wheel::clock::now() - start, delay);
+    order.push_back(name);
+  };
+  ex.spawn(sleeper('c', 300ms));
+  ex.spawn(sleeper('a', 5ms));
+  ex.spawn(sleeper('b', 20ms));
+  ctx.run();
+  EXPECT_EQ(order, "abc");
+}
+
+TEST(TestTimerWheel, Timeout) {
+  auto ctx = asio::io_context();
+  auto ex = ascpp::io_executor(ctx);
+  auto wheel = ascpp::timer_wheel(ctx);
+  auto slow = [&](std::chrono::milliseconds delay) -> ascpp::task<int> {
+    co_await wheel.sleep_for(delay);
+    co_return 42;
+  };
+  EXPECT_EQ(ex.block_on(wheel.with_timeout(50ms, slow(1ms))).value(), 42);
+  EXPECT_EQ(ex.block_on(wheel.with_timeout(5ms, slow(50ms))).error(),
+            std::make_error_code(std::errc::timed_out));
+  // the task timed out goes on to its end
+  ctx.restart();
+  ctx.run();
+  EXPECT_EQ(wheel.size(), 0);
+
+  // the error of a task returning a result is given as is
+  auto failing = []() -> ascpp::task<ascpp::result<int>> {
+    co_return make_error_code(ascpp::error::INVALID_ARGUMENT);
+  };
+  EXPECT_EQ(ex.block_on(wheel.with_timeout(50ms, failing())).error(),
+            ascpp::error::INVALID_ARGUMENT);
+
+  // destroyed while waiting, the task is resumed neither by the timer nor by the task it awaits
+  for (auto delay : {5ms, 50ms}) {
+    auto waiting = wheel.with_timeout(20ms, slow(delay));
+    auto awaiter = std::move(waiting).operator co_await();
+    awaiter.await_suspend(std::noop_coroutine()).resume();
+    EXPECT_FALSE(waiting.done());
+    waiting = {};
+    ctx.restart();
+    ctx.run();
+    EXPECT_EQ(wheel.size(), 0);
+  }
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,172 @@
+#include "async/worker.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <latch>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ascpp.hpp"
+
+// NOLINTBEGIN(modernize-use-trailing-return-type)
+
+namespace {
+
+auto fib(ascpp::thread_pool& pool, int n) -> long {
+  if (n < 16) {
+    return n < 2 ? n : fib(pool, n - 1) + fib(pool, n - 2);
+  }
+  auto [a, b] = pool.when_all([&] { return fib(pool, n - 1); }, [&] { return fib(pool, n - 2); });
+  return a + b;
+}
+
+}  // namespace
+
+TEST(TestWorker, Submit) {
+  auto pool = ascpp::thread_pool(4);
+  EXPECT_EQ(pool.size(), 4);
+  EXPECT_FALSE(pool.in_pool());
+
+  auto count = std::atomic<int>(0);
+  auto done = std::latch(1000);
+  for (auto i = 0; i < 1000; ++i) {
+    pool.submit([&] {
+      // jobs submitted by a worker go to its own deque
+      EXPECT_TRUE(pool.in_pool());
+      pool.submit([&] {
+        count.fetch_add(1);
+        done.count_down();
+      });
+    });
+  }
+  done.wait();
+  EXPECT_EQ(count.load(), 1000);
+}
+
+TEST(TestWorker, DrainOnDestroy) {
+  auto count = std::atomic<int>(0);
+  {
+    auto pool = ascpp::thread_pool(2);
+    for (auto i = 0; i < 100; ++i) {
+      pool.submit([&] {
+        std::this_thread::yield();
+        count.fetch_add(1);
+      });
+    }
+  }
+  EXPECT_EQ(count.load(), 100);
+}
+
+TEST(TestWorker, BulkSubmit) {
+  auto pool = ascpp::thread_pool(4);
+  auto hits = std::vector<std::atomic<int>>(10000);
+  auto done = std::latch(static_cast<std::ptrdiff_t>(hits.size()));
+  pool.bulk_submit(hits.size(), [&](std::size_t i) {
+    hits[i].fetch_add(1);
+    done.count_down();
+  });
+  done.wait();
+  EXPECT_TRUE(std::ranges::all_of(hits, [](const auto& hit) { return hit.load() == 1; }));
+}
+
+TEST(TestWorker, WhenAll) {
+  auto pool = ascpp::thread_pool(4);
+  auto [a, b, c] = pool.when_all([] { return 1; }, [] { return std::string("two"); }, [] {});
+  EXPECT_EQ(a, 1);
+  EXPECT_EQ(b, "two");
+  EXPECT_EQ(c, std::monostate());
+
+  // nested fork-join on the workers, whose waits run other jobs
+  auto [n] = pool.when_all([&] { return fib(pool, 27); });
+  EXPECT_EQ(n, 196418);
+
+  auto finished = std::atomic<int>(0);
+  EXPECT_THROW(pool.when_all([&] { finished.fetch_add(1); },
+                             [&] {
+                               finished.fetch_add(1);
+                               throw std::runtime_error("branch");
+                             },
+                             [&] { finished.fetch_add(1); }),
+               std::runtime_error);
+  EXPECT_EQ(finished.load(), 3);
+}
+
+TEST(TestWorker, SingleThread) {
+  // a single worker waiting in when_all() runs the branches itself
+  auto pool = ascpp::thread_pool(1);
+  auto [n] = pool.when_all([&] { return fib(pool, 20); });
+  EXPECT_EQ(n, 6765);
+}
+
+TEST(TestWorker, AppPool) {
+  auto app = ascpp::App({"mrbeardad", "ascpp", "awesome cpp framework", 0, 0, 1, 2});
+  auto copy = app;
+  EXPECT_EQ(&app.pool(), &copy.pool());
+  EXPECT_EQ(app.pool().size(), 2);
+  auto [n] = app.pool().when_all([] { return 42; });
+  EXPECT_EQ(n, 42);
+}
+
+TEST(TestWorker, ThreadPerCore) {
+  auto cores = ascpp::thread_per_core(3, 1024);
+  EXPECT_EQ(cores.size(), 3);
+  EXPECT_FALSE(cores.current_core());
+
+  // core 0 sends to core 1 through their queue, the jobs run on core 1 in order
+  auto seen = std::vector<int>();  // only touched by core 1
+  auto send = [&](int count) {
+    auto done = std::latch(1);
+    cores.post(0, [&] {
+      for (auto i = 0; i < count; ++i) {
+        cores.post(1, [&, i] {
+          EXPECT_EQ(cores.current_core(), 1);
+          seen.push_back(i);
+          if (seen.size() == static_cast<std::size_t>(count)) {
+            done.count_down();
+          }
+        });
+      }
+    });
+    done.wait();
+  };
+  send(1000);
+  auto expected = std::vector<int>(1000);
+  std::iota(expected.begin(), expected.end(), 0);
+  EXPECT_EQ(seen, expected);
+
+  // more than the queue holds, the overflow goes through the io_context
+  seen.clear();
+  send(10000);
+  EXPECT_EQ(seen.size(), 10000);
+
+  // the jobs on a key all run on the core owning it
+  auto wrong = std::atomic<int>(0);
+  auto pending = std::latch(100);
+  for (auto i = 0; i < 100; ++i) {
+    auto key = std::to_string(i);
+    cores.route(key, [&, key] {
+      if (cores.current_core() != cores.core_of(key)) {
+        wrong.fetch_add(1);
+      }
+      pending.count_down();
+    });
+  }
+  pending.wait();
+  EXPECT_EQ(wrong.load(), 0);
+}
+
+TEST(TestWorker, AppRuntime) {
+  auto config = ascpp::AppConfig{"mrbeardad", "ascpp", "awesome cpp framework", 0, 0, 1, 2};
+  config.runtime = ascpp::runtime_mode::thread_per_core;
+  auto app = ascpp::App(config);
+  EXPECT_EQ(app.cores().size(), 2);
+  EXPECT_THROW(app.pool(), std::logic_error);
+}
+
+// NOLINTEND(modernize-use-trailing-return-type)
@@ -0,0 +1,65 @@
+/**
+ * @file
+ * @brief Decode the binary log files written by rotating_file_sink into text or JSON lines.
+ */
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "ascpp.hpp"
+#include "utils/error.hpp"
+#include "utils/log_binary.hpp"
+
+#include "logcat.hpp"
+
+namespace {
+
+auto read_file(const std::filesystem::path& path) -> ascpp::result<std::string> {
+  auto in = std::ifstream(path, std::ios::binary);
+  if (!in) {
+    return std::make_error_code(std::errc::no_such_file_or_directory);
+  }
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+auto print_file(const std::filesystem::path& path, bool json) -> ascpp::result<void> {
+  TRY_ASSIGN(auto data, read_file(path));
+  auto decoder = ascpp::log_decoder(data);
+  auto event = ascpp::log_event();
+  auto line = std::string();
+  while (true) {
+    TRY_ASSIGN(auto more, decoder.next(event));
+    if (!more) {
+      break;
+    }
+    line.clear();
+    ascpp::logcat::format_record(line, event, json);
+    std::cout << line;
+  }
+  return {};
+}
+
+}  // namespace
+
+auto main(int argc, char* argv[]) -> int {
+  auto app = ascpp::App({"mrbeardad", "ascpp-logcat",
+                         "Decode binary log files (.alog) into text or JSON lines", 0, 1, 0});
+  app.add_option<bool>('j', "json", "print one JSON object per record");
+  app.allow_nonoptions("files", true);
+  app.parse_args(argc, argv, true);
+
+  auto json = app.get_value<bool>("json");
+  auto status = 0;
+  for (const auto& file : app.get_nonoptions()) {
+    auto res = print_file(file, json);
+    if (!res) {
+      std::cerr << std::format("ascpp-logcat: {}: {}\n", file, res.error().message());
+      status = 1;
+    }
+  }
+  return status;
+}
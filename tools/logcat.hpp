@@ -0,0 +1,72 @@
+#pragma once
+
+/**
+ * @file
+ * @brief Formatting of the decoded records by ascpp-logcat.
+ */
+
+#include <chrono>
+#include <format>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+#include "nlohmann/json.hpp"
+
+#include "utils/log.hpp"
+#include "utils/log_binary.hpp"
+
+namespace ascpp::logcat {
+
+inline auto to_json(const log_event& event, const std::string& message) -> nlohmann::json {
+  auto args = nlohmann::json::array();
+  for (const auto& arg : event.args) {
+    std::visit(
+        [&](const auto& value) {
+          if constexpr (std::is_same_v<std::remove_cvref_t<decltype(value)>, char>) {
+            args.emplace_back(std::string(1, value));
+          } else {
+            args.emplace_back(value);
+          }
+        },
+        arg);
+  }
+  return {
+      {"time", std::format("{:%FT%TZ}", event.time)},
+      {"level", logger::level_name(event.lvl)},
+      {"thread", event.thread_index},
+      {"message", message},
+      {"format", event.format},
+      {"args", std::move(args)},
+  };
+}
+
+/**
+ * @brief Append event to out as a line of text, or as a line of JSON if json is true.
+ *
+ * A record that cannot be formatted is still printed, with the error in place of its message.
+ * Invalid UTF-8 in the strings, e.g. an argument cut by the logger, is replaced by U+FFFD.
+ */
+inline auto format_record(std::string& out, const log_event& event, bool json) -> void {
+  auto message = std::string();
+  try {
+    format_log_event(message, event);
+  } catch (const std::format_error& e) {
+    message = std::format("<{}: {}>", e.what(), event.format);
+  }
+  if (json) {
+    try {
+      out += to_json(event, message).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    } catch (const nlohmann::json::exception& e) {
+      out += nlohmann::json({{"error", e.what()}}).dump();
+    }
+    out += '\n';
+  } else {
+    std::format_to(std::back_inserter(out), "{:%F %T} {:<5} [{}] {}\n",
+                   std::chrono::floor<std::chrono::microseconds>(event.time),
+                   logger::level_name(event.lvl), event.thread_index, message);
+  }
+}
+
+}  // namespace ascpp::logcat